@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Shared-AP scheduler sweep: worst-user on-time ratio vs. number of headsets
+OUT="results_ap.csv"
+echo "scheduler,users,total,onTime,late,incomplete,ratio,worstUser,worstRatio,apDrops" > $OUT
+
+SCENARIO="scratch/scenarios/ap-shared.toml"
+USERS=("1" "2" "4" "8" "12" "16")
+SCHEDULERS=("fifo" "rr" "airtime" "edf")
+
+for n in ${USERS[@]}; do
+    for s in ${SCHEDULERS[@]}; do
+        cmd="./ns3 run \"scratch/arvr-sim --scenario=$SCENARIO --users=$n \
+             --set=access.scheduler=$s --outDir=xml\""
+
+        LOG=$(eval $cmd 2>&1)
+
+        vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+        worstline=$(echo "$LOG" | grep -F "[VR-WORST]")
+        apline=$(echo "$LOG" | grep -F "[AP]")
+
+        total=$(echo $vrline | awk '{print $2}' | cut -d= -f2)
+        onTime=$(echo $vrline | awk '{print $3}' | cut -d= -f2)
+        late=$(echo $vrline | awk '{print $4}' | cut -d= -f2)
+        incomplete=$(echo $vrline | awk '{print $5}' | cut -d= -f2)
+        ratio=$(echo $vrline | awk '{print $6}' | cut -d= -f2)
+
+        # 只有一个用户时没有 [VR-WORST]，worst 就是它自己
+        if [ -n "$worstline" ]; then
+            worstUser=$(echo $worstline | awk '{print $2}' | cut -d= -f2)
+            worstRatio=$(echo $worstline | awk '{print $3}' | cut -d= -f2)
+        else
+            worstUser=0
+            worstRatio=$ratio
+        fi
+        apDrops=$(echo $apline | awk '{print $4}' | cut -d= -f2)
+
+        echo "$s,$n,$total,$onTime,$late,$incomplete,$ratio,$worstUser,$worstRatio,$apDrops" >> $OUT
+    done
+done
+
+echo "AP scheduler sweep done. Results saved to $OUT"
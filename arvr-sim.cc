@@ -14,6 +14,26 @@
 #include <cstdint>
 #include <map>          // for std::map
 #include <vector>
+#include <deque>
+#include <type_traits>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>      // open, O_* (atomic XML write, manifest)
+#include <linux/if_tun.h> // emulation: attach to a persistent tap
+#include <net/if.h>
+#include <sys/file.h>   // flock
+#include <sys/ioctl.h>
+#include <poll.h>       // live reporter: bounded flush at exit
+#include <sys/socket.h> // live reporter: unix socket sink
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>   // fork-from-warm-state workers
+#include <unistd.h>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -21,6 +41,11 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/flow-monitor-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/fd-net-device-module.h"
 
 using namespace ns3;
 
@@ -134,6 +159,471 @@ private:
   uint32_t m_sendTsMs;
 };
 
+//
+// VrHeader + session ID, for nodes that host several sessions on one port
+// (sessions.perHeadset > 1). The first 12 bytes are a plain VrHeader, so
+// PeekVrHeader (EDF, AP scheduling, pcap) reads it unchanged; single-session
+// runs keep the 12 B header
+//
+class VrSessionHeader : public VrHeader
+{
+public:
+  VrSessionHeader ()
+    : m_session (0)
+  {}
+
+  VrSessionHeader (uint32_t frameId, uint16_t pktId, uint16_t pktCount, uint32_t sendTsMs,
+                   uint32_t session = 0)
+    : VrHeader (frameId, pktId, pktCount, sendTsMs),
+      m_session (session)
+  {}
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::VrSessionHeader")
+      .SetParent<VrHeader> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<VrSessionHeader> ();
+    return tid;
+  }
+
+  virtual TypeId GetInstanceTypeId () const override
+  {
+    return GetTypeId ();
+  }
+
+  virtual void Serialize (Buffer::Iterator start) const override
+  {
+    VrHeader::Serialize (start);
+    start.Next (VrHeader::GetSerializedSize ());
+    start.WriteHtonU32 (m_session);
+  }
+
+  virtual uint32_t Deserialize (Buffer::Iterator start) override
+  {
+    VrHeader::Deserialize (start);
+    start.Next (VrHeader::GetSerializedSize ());
+    m_session = start.ReadNtohU32 ();
+    return GetSerializedSize ();
+  }
+
+  virtual uint32_t GetSerializedSize () const override
+  {
+    return VrHeader::GetSerializedSize () + 4;  // 16 bytes
+  }
+
+  virtual void Print (std::ostream &os) const override
+  {
+    VrHeader::Print (os);
+    os << " session=" << m_session;
+  }
+
+  uint32_t GetSession () const { return m_session; }
+  void SetSession (uint32_t v) { m_session = v; }
+
+private:
+  uint32_t m_session;
+};
+
+//
+// Delay sketch: fixed 1 ms bins, O(1) insert, bounded memory
+//   - lets the live reporter read quantiles mid-run without sorting m_delays
+//   - same rank rule as GetP99Delay(): sorted[floor(n * q)]
+//
+class DelaySketch
+{
+public:
+  explicit DelaySketch (uint32_t maxMs = 2000)
+    : m_bins (maxMs + 1, 0),
+      m_count (0),
+      m_sum (0),
+      m_max (0)
+  {}
+
+  // n > 1: a whole histogram bin at once (FlowMonitor delay histograms)
+  void Add (uint32_t ms, uint64_t n = 1)
+  {
+    if (n == 0) return;
+    m_bins[std::min<uint32_t> (ms, m_bins.size () - 1)] += n;   // 超出范围的落到最后一格
+    m_count += n;
+    m_sum   += (uint64_t) ms * n;
+    m_max    = std::max (m_max, ms);
+  }
+
+  void Merge (const DelaySketch &o)
+  {
+    for (size_t i = 0; i < m_bins.size () && i < o.m_bins.size (); ++i)
+      m_bins[i] += o.m_bins[i];
+    m_count += o.m_count;
+    m_sum   += o.m_sum;
+    m_max    = std::max (m_max, o.m_max);
+  }
+
+  uint64_t GetCount () const { return m_count; }
+  uint32_t GetMax ()   const { return m_max; }
+  double   GetMean ()  const { return m_count ? double (m_sum) / m_count : 0.0; }
+
+  uint32_t GetQuantile (double q) const
+  {
+    if (m_count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t> (m_count * q);
+    if (rank >= m_count) rank = m_count - 1;
+
+    uint64_t cum = 0;
+    for (uint32_t i = 0; i < m_bins.size (); ++i)
+    {
+      cum += m_bins[i];
+      if (cum > rank) return i;
+    }
+    return m_max;
+  }
+
+private:
+  std::vector<uint64_t> m_bins;
+  uint64_t m_count;
+  uint64_t m_sum;
+  uint32_t m_max;
+};
+
+//
+// Random duration of a sender-side processing step (encode, render, ...)
+//   fixed:   mean
+//   uniform: mean +- jitter
+//   normal:  mean, stddev = jitter, truncated at 0
+//   the random streams are only created for non-fixed distributions
+//
+class TimeDist
+{
+public:
+  TimeDist ()
+    : m_dist ("fixed")
+  {}
+
+  static bool IsValid (const std::string &dist)
+  {
+    return dist == "fixed" || dist == "uniform" || dist == "normal";
+  }
+
+  void Setup (const std::string &dist, Time mean, Time jitter)
+  {
+    m_dist   = dist;
+    m_mean   = mean;
+    m_jitter = jitter;
+    if (m_dist == "uniform" && !m_uni)   m_uni  = CreateObject<UniformRandomVariable> ();
+    if (m_dist == "normal"  && !m_norm)  m_norm = CreateObject<NormalRandomVariable> ();
+  }
+
+  Time Sample ()
+  {
+    double mean = m_mean.GetSeconds ();
+    double j    = m_jitter.GetSeconds ();
+    double v    = mean;
+    if      (m_dist == "uniform") v = m_uni->GetValue (mean - j, mean + j);
+    else if (m_dist == "normal")  v = m_norm->GetValue (mean, j * j);
+    return Seconds (std::max (v, 0.0));
+  }
+
+private:
+  std::string m_dist;
+  Time        m_mean;
+  Time        m_jitter;
+  Ptr<UniformRandomVariable> m_uni;
+  Ptr<NormalRandomVariable>  m_norm;
+};
+
+//
+// Batched VR send path (--batch), in the spirit of sendmmsg/GSO
+//   - a whole frame (or burst) of VrHeader fragments goes down in one call
+//     and is handed straight to the traffic-control layer of the egress
+//     device; route, source address and IPv4/UDP header templates are
+//     resolved once in Setup
+//   - per fragment only the UDP/IPv4 headers are stamped; the socket,
+//     UdpL4Protocol and Ipv4L3Protocol (route lookup, trace hooks) are
+//     skipped. Queue discs and the device get the same packets at the same
+//     times, so timing on the wire is unchanged
+//   - the headset receives through its normal UDP socket
+//   - FlowMonitor hooks Ipv4L3Protocol, so batched video packets are not
+//     traced: the video flow is missing from the XML. Each packet carries a
+//     BatchTxTag with its send time instead; BatchDelayProbe reads it at
+//     local delivery on the headset and [CLASS] video comes from there
+//   - needs an egress device without ARP (the p2p bottleneck)
+//
+class BatchTxTag : public Tag
+{
+public:
+  BatchTxTag (Time sent = Time (0)) : m_sent (sent) {}
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::BatchTxTag")
+      .SetParent<Tag> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<BatchTxTag> ();
+    return tid;
+  }
+
+  virtual TypeId GetInstanceTypeId () const override { return GetTypeId (); }
+  virtual uint32_t GetSerializedSize () const override { return 8; }
+  virtual void Serialize (TagBuffer i) const override { i.WriteU64 (m_sent.GetTimeStep ()); }
+  virtual void Deserialize (TagBuffer i) override { m_sent = TimeStep (i.ReadU64 ()); }
+  virtual void Print (std::ostream &os) const override { os << "batchTx=" << m_sent; }
+
+  Time GetSent () const { return m_sent; }
+
+private:
+  Time m_sent;   // handed to the traffic-control layer
+};
+
+// --batch / --gso: one-way delay of every video packet (FlowMonitor misses or
+// under-counts them), 1 ms bins like the FlowMonitor histograms
+class BatchDelayProbe
+{
+public:
+  void Attach (Ptr<Node> headset)
+  {
+    headset->GetObject<Ipv4> ()->TraceConnectWithoutContext (
+        "LocalDeliver", MakeCallback (&BatchDelayProbe::OnDeliver, this));
+  }
+
+  const DelaySketch &GetDelays () const { return m_delays; }
+
+private:
+  void OnDeliver (const Ipv4Header &, Ptr<const Packet> p, uint32_t)
+  {
+    BatchTxTag tag;
+    if (p->PeekPacketTag (tag))
+    {
+      m_delays.Add ((Simulator::Now () - tag.GetSent ()).GetMilliSeconds ());
+    }
+  }
+
+  DelaySketch m_delays;
+};
+
+class VrBatchSender : public SimpleRefCount<VrBatchSender>
+{
+public:
+  VrBatchSender ()
+    : m_srcPort (0),
+      m_dstPort (0),
+      m_ipId (0)
+  {}
+
+  bool Setup (Ptr<Node> node, Ipv4Address dst, uint16_t srcPort, uint16_t dstPort, uint8_t tos)
+  {
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    Ipv4Header probe;
+    probe.SetDestination (dst);
+    Socket::SocketErrno err;
+    Ptr<Ipv4Route> route = ipv4->GetRoutingProtocol ()->RouteOutput (nullptr, probe, nullptr, err);
+    if (!route || route->GetOutputDevice ()->NeedsArp ()) return false;
+
+    m_dev     = route->GetOutputDevice ();
+    m_tc      = node->GetObject<TrafficControlLayer> ();
+    m_src     = route->GetSource ();
+    m_dst     = dst;
+    m_srcPort = srcPort;
+    m_dstPort = dstPort;
+
+    m_ip.SetSource (m_src);
+    m_ip.SetDestination (m_dst);
+    m_ip.SetProtocol (UdpL4Protocol::PROT_NUMBER);
+    m_ip.SetTtl (64);
+    m_ip.SetTos (tos);
+    if (Node::ChecksumEnabled ()) m_ip.EnableChecksum ();
+    return true;
+  }
+
+  void Send (const std::vector<Ptr<Packet>> &batch)
+  {
+    for (const Ptr<Packet> &p : batch)
+    {
+      UdpHeader udp;
+      udp.SetSourcePort (m_srcPort);
+      udp.SetDestinationPort (m_dstPort);
+      if (Node::ChecksumEnabled ())
+      {
+        udp.EnableChecksums ();
+        udp.InitializeChecksum (m_src, m_dst, UdpL4Protocol::PROT_NUMBER);
+      }
+      p->AddHeader (udp);
+      p->AddPacketTag (BatchTxTag (Simulator::Now ()));
+
+      // Ipv4 header 在出队时由 queue disc item 加上
+      Ipv4Header ip = m_ip;
+      ip.SetPayloadSize (p->GetSize ());
+      ip.SetIdentification (m_ipId++);
+      m_tc->Send (m_dev, Create<Ipv4QueueDiscItem> (p, m_dev->GetBroadcast (),
+                                                   Ipv4L3Protocol::PROT_NUMBER, ip));
+    }
+  }
+
+private:
+  Ptr<NetDevice>           m_dev;
+  Ptr<TrafficControlLayer> m_tc;
+  Ipv4Address              m_src;
+  Ipv4Address              m_dst;
+  uint16_t                 m_srcPort;
+  uint16_t                 m_dstPort;
+  uint16_t                 m_ipId;
+  Ipv4Header               m_ip;
+};
+
+//
+// UDP GSO emulation (--gso=N)
+//   - the sender hands up to N VrHeader fragments to the socket as one
+//     super-packet (one UDP datagram, one pass through UdpL4Protocol /
+//     Ipv4L3Protocol / the queue disc) tagged with its segment size
+//   - GsoNetDevice, the server end of the bottleneck, splits it back into
+//     wire-size UDP/IPv4 packets right before its device queue, like a NIC
+//     doing UDP segmentation offload; untagged packets pass unchanged
+//   - the device advertises a 64 KB MTU so Ipv4L3Protocol never fragments a
+//     super-packet, and stops its tx queue until a whole super-packet fits
+//     (BQL-like), so a burst is never cut short by the device queue
+//   - queue discs see one item per super-packet, as with Linux GSO; the
+//     bursts land back to back in the device queue (peak reported in [GSO])
+//   - FlowMonitor tags survive the split: it counts super-packets at the
+//     sender and the first segment of each at the receiver, so the XML video
+//     flow is biased. The super-packet also carries a BatchTxTag, which every
+//     segment inherits; [CLASS] video comes from BatchDelayProbe as with --batch
+//
+class GsoTag : public Tag
+{
+public:
+  GsoTag (uint32_t segSize = 0) : m_segSize (segSize) {}
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::GsoTag")
+      .SetParent<Tag> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<GsoTag> ();
+    return tid;
+  }
+
+  virtual TypeId GetInstanceTypeId () const override { return GetTypeId (); }
+  virtual uint32_t GetSerializedSize () const override { return 4; }
+  virtual void Serialize (TagBuffer i) const override { i.WriteU32 (m_segSize); }
+  virtual void Deserialize (TagBuffer i) override { m_segSize = i.ReadU32 (); }
+  virtual void Print (std::ostream &os) const override { os << "gsoSegSize=" << m_segSize; }
+
+  uint32_t GetSegSize () const { return m_segSize; }
+
+private:
+  uint32_t m_segSize;   // UDP payload per segment
+};
+
+class GsoNetDevice : public PointToPointNetDevice
+{
+public:
+  static constexpr uint16_t GSO_MTU = 65535;
+
+  GsoNetDevice ()
+    : m_reserve (1),
+      m_reserveBytes (0),
+      m_superPkts (0),
+      m_segments (0),
+      m_queuePeak (0)
+  {}
+
+  // reserve = segments of the largest super-packet, segBytes = one segment as
+  // queued (with PPP header); call after SetQueue and after the
+  // NetDeviceQueueInterface is aggregated
+  void SetupGso (uint32_t reserve, uint32_t segBytes)
+  {
+    m_reserve      = std::max<uint32_t> (reserve, 1);
+    m_reserveBytes = m_reserve * segBytes;
+    m_txq = GetObject<NetDeviceQueueInterface> ()->GetTxQueue (0);
+    GetQueue ()->TraceConnectWithoutContext ("Dequeue", MakeCallback (&GsoNetDevice::OnDequeue, this));
+  }
+
+  virtual bool Send (Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber) override
+  {
+    GsoTag tag;
+    bool ok = false;
+    if (protocolNumber != Ipv4L3Protocol::PROT_NUMBER || !packet->PeekPacketTag (tag))
+    {
+      ok = PointToPointNetDevice::Send (packet, dest, protocolNumber);
+    }
+    else
+    {
+      packet->RemovePacketTag (tag);
+      Ipv4Header ip;
+      UdpHeader  udp;
+      packet->RemoveHeader (ip);
+      packet->RemoveHeader (udp);
+
+      uint32_t seg  = tag.GetSegSize ();
+      uint32_t size = packet->GetSize ();
+      uint16_t id   = ip.GetIdentification ();
+      for (uint32_t off = 0; off < size; off += seg)
+      {
+        Ptr<Packet> s = packet->CreateFragment (off, std::min (seg, size - off));
+        UdpHeader u;
+        u.SetSourcePort (udp.GetSourcePort ());
+        u.SetDestinationPort (udp.GetDestinationPort ());
+        if (Node::ChecksumEnabled ())
+        {
+          u.EnableChecksums ();
+          u.InitializeChecksum (ip.GetSource (), ip.GetDestination (), UdpL4Protocol::PROT_NUMBER);
+        }
+        s->AddHeader (u);
+
+        Ipv4Header h = ip;
+        h.SetPayloadSize (s->GetSize ());
+        h.SetIdentification (id++);   // 和 Linux 一样每个 segment 递增 IP ID
+        s->AddHeader (h);
+        m_segments += 1;
+        ok = PointToPointNetDevice::Send (s, dest, protocolNumber) || ok;
+      }
+      m_superPkts += 1;
+    }
+
+    m_queuePeak = std::max (m_queuePeak, GetQueue ()->GetNPackets ());
+    if (m_txq && !HasRoom ()) m_txq->Stop ();
+    return ok;
+  }
+
+  virtual uint16_t GetMtu () const override { return GSO_MTU; }
+
+  uint64_t GetSuperPackets () const { return m_superPkts; }
+  uint64_t GetSegments () const { return m_segments; }
+  uint32_t GetQueuePeak () const { return m_queuePeak; }
+
+private:
+  bool HasRoom () const
+  {
+    Ptr<Queue<Packet>> q = GetQueue ();
+    QueueSize max = q->GetMaxSize ();
+    if (max.GetUnit () == QueueSizeUnit::BYTES)
+    {
+      return q->GetNBytes () + m_reserveBytes <= max.GetValue ();
+    }
+    return q->GetNPackets () + m_reserve <= max.GetValue ();
+  }
+
+  void OnDequeue (Ptr<const Packet>)
+  {
+    // 不能在设备自己 Dequeue 的调用栈里直接 Wake（会重入 Send）
+    if (m_txq && m_txq->IsStopped () && HasRoom ())
+    {
+      Simulator::ScheduleNow (&GsoNetDevice::Wake, this);
+    }
+  }
+
+  void Wake ()
+  {
+    if (m_txq->IsStopped () && HasRoom ()) m_txq->Wake ();
+  }
+
+  Ptr<NetDeviceQueue> m_txq;
+  uint32_t m_reserve;      // device-queue slots a super-packet needs
+  uint32_t m_reserveBytes; // same in bytes, for a byte-limited queue
+  uint64_t m_superPkts;
+  uint64_t m_segments;
+  uint32_t m_queuePeak;    // device queue, packets, after each Send
+};
+
 //
 // 2. Downlink app: send one VR frame every frameInterval
 //    A frame is split into multiple packets, each with VrHeader
@@ -147,7 +637,29 @@ public:
       m_pktSize(1200),
       m_frameCounter(0),
       m_usePacing(false),
-      m_pacingInterval(MicroSeconds(200))   // 默认 200us 一包
+      m_pacingInterval(MicroSeconds(200)),  // 默认 200us 一包
+      m_useEncoder(false),
+      m_slices(1),
+      m_usePipeline(false),
+      m_renderDepth(2),
+      m_sendDepth(2),
+      m_dropOnFull(false),
+      m_renderBusy(false),
+      m_encodeBusy(false),
+      m_sendBusy(false),
+      m_renderHeld(false),
+      m_encodeHeld(false),
+      m_sendWaiting(false),
+      m_sendIdx(0),
+      m_skippedTicks(0),
+      m_queueDrops(0),
+      m_useBatch(false),
+      m_batchTos(0),
+      m_gsoSegs(0),
+      m_useSession(false),
+      m_session(0),
+      m_hdrSize(12),
+      m_sendFragments(&VrDownlinkApp::SendFragmentsT<PATH_SOCKET, VrHeader>)
   {}
 
   // 新的 Setup：多了 usePacing 和 pacingInterval 两个参数（有默认值）
@@ -166,64 +678,293 @@ public:
     m_pacingInterval= pacingInterval;
   }
 
+  // encoder model: every frame takes an encode time drawn from `encode`
+  // before its fragments are released; slices > 1 releases the fragments
+  // slice by slice as each slice finishes (slice-based encoder). The
+  // VrHeader timestamp stays at the frame tick (render start), so encode
+  // time counts against the deadline
+  void SetEncoder (const TimeDist &encode, uint32_t slices)
+  {
+    m_useEncoder = true;
+    m_encode     = encode;
+    m_slices     = std::max<uint32_t> (slices, 1);
+  }
+
+  //
+  // render -> encode -> send pipeline (replaces the fixed frame tick)
+  //   - the renderer starts a frame on each tick if it is idle; otherwise
+  //     the tick is lost (skippedTicks). Render time ~ `render`, encode
+  //     time ~ the SetEncoder distribution (0 if unset)
+  //   - bounded frame queues: render -> encode (renderDepth frames, the GPU
+  //     frame queue) and encode -> send (sendDepth frames)
+  //   - full queue: block (the stage holds its finished frame and stays
+  //     busy, so pressure propagates upstream to the renderer) or, with
+  //     dropOnFull, drop the oldest queued frame
+  //   - send stage: hands fragments to the socket only while it reports tx
+  //     space (TCP send buffer) and resumes from the socket's send
+  //     callback: network back-pressure. UDP sockets always report space, so
+  //     udp/quic watch the egress backlog instead (SetEgress). quic paces
+  //     inside the stage
+  //   - per-stage time and queue wait go to DelaySketches (ms)
+  //
+  void SetPipeline (const TimeDist &render, uint32_t renderDepth, uint32_t sendDepth,
+                    bool dropOnFull)
+  {
+    m_usePipeline = true;
+    m_render      = render;
+    m_renderDepth = std::max<uint32_t> (renderDepth, 1);
+    m_sendDepth   = std::max<uint32_t> (sendDepth, 1);
+    m_dropOnFull  = dropOnFull;
+  }
+
+  // udp/quic pipeline: the send stage waits while one more fragment would
+  // push the egress backlog (root queue disc + device queue) past `limit`,
+  // and resumes when the device queue dequeues
+  void SetEgress (Ptr<PointToPointNetDevice> dev, QueueSize limit)
+  {
+    m_egress      = dev;
+    m_egressLimit = limit;
+  }
+
+  struct PipelineStats
+  {
+    DelaySketch render, renderWait, encode, sendWait, send;   // ms
+    uint32_t    frames = 0, skippedTicks = 0, queueDrops = 0;
+  };
+
+  void AddPipelineStats (PipelineStats &st) const
+  {
+    st.render.Merge (m_renderMs);
+    st.renderWait.Merge (m_renderWaitMs);
+    st.encode.Merge (m_encodeMs);
+    st.sendWait.Merge (m_sendWaitMs);
+    st.send.Merge (m_sendStageMs);
+    st.frames       += m_frameCounter;
+    st.skippedTicks += m_skippedTicks;
+    st.queueDrops   += m_queueDrops;
+  }
+
+  // several sessions per headset: fragments carry VrSessionHeader with this
+  // ID, the headset's receiver demultiplexes on it (call before SetGso)
+  void SetSession (uint32_t session)
+  {
+    m_useSession = true;
+    m_session    = session;
+    m_hdrSize    = VrSessionHeader ().GetSerializedSize ();
+  }
+
+  // UDP/quic only: fragments bypass the socket, see VrBatchSender
+  void SetBatch (uint8_t tos)
+  {
+    m_useBatch = true;
+    m_batchTos = tos;
+  }
+
+  // UDP/quic only: back-to-back fragments go to the socket as super-packets
+  // of up to `segs` fragments, split by GsoNetDevice. Paced sends (quic) and
+  // the pipeline's send stage go one fragment at a time, i.e. 1-segment
+  // super-packets
+  void SetGso (uint32_t segs)
+  {
+    // 一个 UDP datagram 最多 65507 字节
+    m_gsoSegs = std::min<uint32_t> (segs, 65507 / (m_pktSize + m_hdrSize));
+  }
+
+  // 每帧的发送时间（ms），下标 = frameId；frame trace 用它找出整帧丢失的帧
+  const std::vector<uint32_t> &GetFrameSendMs () const { return m_frameSendMs; }
+  const DelaySketch &GetEncodeTime () const { return m_encodeMs; }
+
 private:
   virtual void StartApplication () override
   {
     m_socket->Connect (m_peer);
-    SendFrame ();
+    if (m_useBatch)
+    {
+      // 源端口沿用 socket 的 ephemeral port，flow 还是同一个 5-tuple
+      Address local;
+      m_socket->GetSockName (local);
+      InetSocketAddress peer = InetSocketAddress::ConvertFrom (m_peer);
+      m_batch = Create<VrBatchSender> ();
+      if (!m_batch->Setup (GetNode (), peer.GetIpv4 (), InetSocketAddress::ConvertFrom (local).GetPort (),
+                           peer.GetPort (), m_batchTos))
+      {
+        NS_FATAL_ERROR ("--batch: no ARP-free route to " << peer.GetIpv4 ());
+      }
+    }
+
+    // 只在这里选一次路径，之后每帧/每个 fragment 都走特化好的实例
+    FramePath f = m_useEncoder ? FRAME_ENCODED : m_usePacing ? FRAME_PACED : FRAME_BURST;
+    SendPath  p = m_gsoSegs ? PATH_GSO : m_batch ? PATH_BATCH : PATH_SOCKET;
+    FrameFn start = m_useSession ? SelectPaths<VrSessionHeader> (f, p) : SelectPaths<VrHeader> (f, p);
+    if (m_usePipeline)
+    {
+      m_socket->SetSendCallback (MakeCallback (&VrDownlinkApp::OnTxSpace, this));
+      if (m_egress)
+      {
+        m_egressQdisc = m_egress->GetNode ()->GetObject<TrafficControlLayer> ()->GetRootQueueDiscOnDevice (m_egress);
+        m_egress->GetQueue ()->TraceConnectWithoutContext (
+            "Dequeue", MakeCallback (&VrDownlinkApp::OnEgressDequeue, this));
+      }
+      PipeTick ();
+      return;
+    }
+    (this->*start) ();
+  }
+
+  //
+  // Hot path specialization: frame path (burst = udp, paced = quic, encoder)
+  // x send path (socket, batch, GSO) x header format are template
+  // parameters, so the per-frame and per-fragment code has no run-time
+  // branches on them. SelectPaths is the dispatch table, used once at start;
+  // encoder slices and the pipeline's send stage go through m_sendFragments
+  //
+  enum FramePath { FRAME_BURST, FRAME_PACED, FRAME_ENCODED };
+  enum SendPath  { PATH_SOCKET, PATH_BATCH, PATH_GSO };
+  typedef void (VrDownlinkApp::*FrameFn) ();
+  typedef void (VrDownlinkApp::*FragmentsFn) (uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+
+  template <class Hdr>
+  FrameFn SelectPaths (FramePath f, SendPath p)
+  {
+    static const FrameFn frames[3][3] = {
+      {&VrDownlinkApp::SendFrameT<FRAME_BURST,   PATH_SOCKET, Hdr>,
+       &VrDownlinkApp::SendFrameT<FRAME_BURST,   PATH_BATCH,  Hdr>,
+       &VrDownlinkApp::SendFrameT<FRAME_BURST,   PATH_GSO,    Hdr>},
+      {&VrDownlinkApp::SendFrameT<FRAME_PACED,   PATH_SOCKET, Hdr>,
+       &VrDownlinkApp::SendFrameT<FRAME_PACED,   PATH_BATCH,  Hdr>,
+       &VrDownlinkApp::SendFrameT<FRAME_PACED,   PATH_GSO,    Hdr>},
+      {&VrDownlinkApp::SendFrameT<FRAME_ENCODED, PATH_SOCKET, Hdr>,
+       &VrDownlinkApp::SendFrameT<FRAME_ENCODED, PATH_BATCH,  Hdr>,
+       &VrDownlinkApp::SendFrameT<FRAME_ENCODED, PATH_GSO,    Hdr>}};
+    static const FragmentsFn fragments[3] = {
+      &VrDownlinkApp::SendFragmentsT<PATH_SOCKET, Hdr>,
+      &VrDownlinkApp::SendFragmentsT<PATH_BATCH,  Hdr>,
+      &VrDownlinkApp::SendFragmentsT<PATH_GSO,    Hdr>};
+    m_sendFragments = fragments[p];
+    return frames[f][p];
   }
 
-  // 发送整个一帧（按是否启用 pacing 走不同路径）
-  void SendFrame ()
+  // 发送整个一帧（路径由模板参数决定）
+  template <FramePath F, SendPath P, class Hdr>
+  void SendFrameT ()
   {
     // #pkts = ceil(frameSize / pktSize)
     uint32_t pkts    = (m_frameSize + m_pktSize - 1) / m_pktSize;
     uint32_t frameId = m_frameCounter++;
+    uint32_t tickMs  = (uint32_t) Simulator::Now ().GetMilliSeconds ();
+    m_frameSendMs.push_back (tickMs);
 
-    if (!m_usePacing)
+    if constexpr (F == FRAME_ENCODED)
     {
-      // 原来的“一口气发完所有 fragment”的版本
-      for (uint32_t i = 0; i < pkts; ++i)
+      // 编码时间内帧间隔照常走（编码器流水线化），第 k 个 slice 在 E*(k+1)/S 时放出
+      Time encode = m_encode.Sample ();
+      m_encodeMs.Add (encode.GetMilliSeconds ());
+      for (uint32_t k = 0; k < m_slices; ++k)
       {
-        Ptr<Packet> p = Create<Packet> (m_pktSize);
-
-        VrHeader hdr (frameId,
-                      (uint16_t)i,
-                      (uint16_t)pkts,
-                      (uint32_t) Simulator::Now ().GetMilliSeconds ());
-        p->AddHeader (hdr);
-
-        m_socket->Send (p);
+        uint32_t first = k * pkts / m_slices;
+        uint32_t last  = (k + 1) * pkts / m_slices;
+        if (first == last) continue;
+        Simulator::Schedule (encode * (int64_t) (k + 1) / (int64_t) m_slices,
+                             &VrDownlinkApp::SendSlice, this, frameId, pkts, first, last, tickMs);
       }
+      Simulator::Schedule (m_frameInterval, &VrDownlinkApp::SendFrameT<F, P, Hdr>, this);
+    }
+    else if constexpr (F == FRAME_BURST)
+    {
+      // 原来的“一口气发完所有 fragment”的版本
+      SendFragmentsT<P, Hdr> (frameId, 0, pkts, pkts, tickMs);
 
       // 原来的：直接 schedule 下一帧
-      Simulator::Schedule (m_frameInterval, &VrDownlinkApp::SendFrame, this);
+      Simulator::Schedule (m_frameInterval, &VrDownlinkApp::SendFrameT<F, P, Hdr>, this);
     }
     else
     {
       // QUIC-lite：启动“按间隔发 fragment”的流程
-      SendOneFragment (frameId, pkts, 0);
+      SendOneFragmentT<P, Hdr> (frameId, pkts, 0);
     }
   }
 
-  // QUIC-lite：一帧里的第 idx 个 fragment
-  void SendOneFragment (uint32_t frameId, uint32_t pkts, uint32_t idx)
+  template <class Hdr>
+  Ptr<Packet> MakeFragment (uint32_t frameId, uint32_t idx, uint32_t pkts, uint32_t tsMs)
   {
     Ptr<Packet> p = Create<Packet> (m_pktSize);
 
-    VrHeader hdr (frameId,
-                  (uint16_t)idx,
-                  (uint16_t)pkts,
-                  (uint32_t) Simulator::Now ().GetMilliSeconds ());
+    Hdr hdr (frameId, (uint16_t)idx, (uint16_t)pkts, tsMs);
+    if constexpr (std::is_same<Hdr, VrSessionHeader>::value) hdr.SetSession (m_session);
     p->AddHeader (hdr);
+    return p;
+  }
 
-    m_socket->Send (p);
+  void SendFragment (uint32_t frameId, uint32_t idx, uint32_t pkts, uint32_t tsMs)
+  {
+    (this->*m_sendFragments) (frameId, idx, idx + 1, pkts, tsMs);
+  }
+
+  void SendFragments (uint32_t frameId, uint32_t first, uint32_t last, uint32_t pkts, uint32_t tsMs)
+  {
+    (this->*m_sendFragments) (frameId, first, last, pkts, tsMs);
+  }
+
+  // fragments [first, last) back to back: GSO super-packets, one batch call,
+  // or one socket call each
+  template <SendPath P, class Hdr>
+  void SendFragmentsT (uint32_t frameId, uint32_t first, uint32_t last, uint32_t pkts, uint32_t tsMs)
+  {
+    if constexpr (P == PATH_GSO)
+    {
+      for (uint32_t i = first; i < last; i += m_gsoSegs)
+      {
+        Ptr<Packet> super = MakeFragment<Hdr> (frameId, i, pkts, tsMs);
+        for (uint32_t k = i + 1; k < std::min (last, i + m_gsoSegs); ++k)
+        {
+          super->AddAtEnd (MakeFragment<Hdr> (frameId, k, pkts, tsMs));
+        }
+        super->AddPacketTag (GsoTag (m_pktSize + m_hdrSize));
+        super->AddPacketTag (BatchTxTag (Simulator::Now ()));   // 每个 segment 都带上
+        m_socket->Send (super);
+      }
+    }
+    else if constexpr (P == PATH_BATCH)
+    {
+      std::vector<Ptr<Packet>> batch;
+      batch.reserve (last - first);
+      for (uint32_t i = first; i < last; ++i) batch.push_back (MakeFragment<Hdr> (frameId, i, pkts, tsMs));
+      m_batch->Send (batch);
+    }
+    else
+    {
+      for (uint32_t i = first; i < last; ++i) m_socket->Send (MakeFragment<Hdr> (frameId, i, pkts, tsMs));
+    }
+  }
+
+  // encoder: fragments [first, last) of a frame are ready; quic 时 slice 内照样 pacing
+  void SendSlice (uint32_t frameId, uint32_t pkts, uint32_t first, uint32_t last, uint32_t tsMs)
+  {
+    if (!m_usePacing)
+    {
+      SendFragments (frameId, first, last, pkts, tsMs);
+      return;
+    }
+    SendFragment (frameId, first, pkts, tsMs);
+    if (first + 1 < last)
+    {
+      Simulator::Schedule (m_pacingInterval, &VrDownlinkApp::SendSlice,
+                           this, frameId, pkts, first + 1, last, tsMs);
+    }
+  }
+
+  // QUIC-lite：一帧里的第 idx 个 fragment
+  template <SendPath P, class Hdr>
+  void SendOneFragmentT (uint32_t frameId, uint32_t pkts, uint32_t idx)
+  {
+    uint32_t tsMs = (uint32_t) Simulator::Now ().GetMilliSeconds ();
+    SendFragmentsT<P, Hdr> (frameId, idx, idx + 1, pkts, tsMs);
 
     if (idx + 1 < pkts)
     {
       // 还没发完这一帧 → 过一个 pacingInterval 再发下一片
       Simulator::Schedule (m_pacingInterval,
-                           &VrDownlinkApp::SendOneFragment,
+                           &VrDownlinkApp::SendOneFragmentT<P, Hdr>,
                            this, frameId, pkts, idx + 1);
     }
     else
@@ -231,418 +972,5314 @@ private:
       Time remaining = m_frameInterval - (pkts * m_pacingInterval);
       if (remaining.IsPositive())
       {
-          Simulator::Schedule (remaining, &VrDownlinkApp::SendFrame, this);
+          Simulator::Schedule (remaining, &VrDownlinkApp::SendFrameT<FRAME_PACED, P, Hdr>, this);
       }
       else
       {
-          Simulator::Schedule (MicroSeconds(1), &VrDownlinkApp::SendFrame, this);
+          Simulator::Schedule (MicroSeconds(1), &VrDownlinkApp::SendFrameT<FRAME_PACED, P, Hdr>, this);
       }
     }
   }
 
-  Ptr<Socket> m_socket;
-  Address     m_peer;
+  // ===== render -> encode -> send pipeline =====
+  struct PipeFrame
+  {
+    uint32_t id     = 0;
+    uint32_t tickMs = 0;   // render start = VrHeader timestamp
+    Time     readyAt;      // finished by the previous stage
+  };
+
+  void PipeTick ()
+  {
+    Simulator::Schedule (m_frameInterval, &VrDownlinkApp::PipeTick, this);
+    if (m_renderBusy)
+    {
+      m_skippedTicks += 1;   // renderer 还在画或被下游堵住
+      return;
+    }
+
+    PipeFrame f;
+    f.id     = m_frameCounter++;
+    f.tickMs = (uint32_t) Simulator::Now ().GetMilliSeconds ();
+    m_frameSendMs.push_back (f.tickMs);
+
+    m_renderBusy = true;
+    Time r = m_render.Sample ();
+    m_renderMs.Add (r.GetMilliSeconds ());
+    Simulator::Schedule (r, &VrDownlinkApp::RenderDone, this, f);
+  }
+
+  // false = the queue is full and the stage must hold the frame
+  bool PushFrame (std::deque<PipeFrame> &q, uint32_t depth, const PipeFrame &f)
+  {
+    if (q.size () >= depth)
+    {
+      if (!m_dropOnFull) return false;
+      q.pop_front ();
+      m_queueDrops += 1;
+    }
+    q.push_back (f);
+    return true;
+  }
+
+  void RenderDone (PipeFrame f)
+  {
+    f.readyAt = Simulator::Now ();
+    if (!PushFrame (m_renderQueue, m_renderDepth, f))
+    {
+      m_renderHeld = true;
+      m_renderOut  = f;
+      return;
+    }
+    m_renderBusy = false;
+    PumpEncode ();
+  }
+
+  void PumpEncode ()
+  {
+    if (m_encodeBusy || m_renderQueue.empty ()) return;
+
+    PipeFrame f = m_renderQueue.front ();
+    m_renderQueue.pop_front ();
+    m_renderWaitMs.Add ((Simulator::Now () - f.readyAt).GetMilliSeconds ());
+    if (m_renderHeld)
+    {
+      m_renderQueue.push_back (m_renderOut);
+      m_renderHeld = false;
+      m_renderBusy = false;
+    }
+
+    m_encodeBusy = true;
+    Time e = m_encode.Sample ();
+    m_encodeMs.Add (e.GetMilliSeconds ());
+    Simulator::Schedule (e, &VrDownlinkApp::EncodeDone, this, f);
+  }
+
+  void EncodeDone (PipeFrame f)
+  {
+    f.readyAt = Simulator::Now ();
+    if (!PushFrame (m_sendQueue, m_sendDepth, f))
+    {
+      m_encodeHeld = true;
+      m_encodeOut  = f;
+      return;
+    }
+    m_encodeBusy = false;
+    PumpEncode ();
+    PumpSend ();
+  }
+
+  void PumpSend ()
+  {
+    if (m_sendBusy || m_sendQueue.empty ()) return;
+
+    m_sending = m_sendQueue.front ();
+    m_sendQueue.pop_front ();
+    m_sendWaitMs.Add ((Simulator::Now () - m_sending.readyAt).GetMilliSeconds ());
+    if (m_encodeHeld)
+    {
+      m_sendQueue.push_back (m_encodeOut);
+      m_encodeHeld = false;
+      m_encodeBusy = false;
+      PumpEncode ();
+    }
+
+    m_sendBusy  = true;
+    m_sendIdx   = 0;
+    m_sendStart = Simulator::Now ();
+    SendNext ();
+  }
+
+  void SendNext ()
+  {
+    uint32_t pkts = (m_frameSize + m_pktSize - 1) / m_pktSize;
+    while (m_sendIdx < pkts)
+    {
+      if (m_egress ? EgressFull () : m_socket->GetTxAvailable () < m_pktSize + m_hdrSize)
+      {
+        m_sendWaiting = true;   // 等 socket 的 send callback / egress 出队
+        return;
+      }
+      SendFragment (m_sending.id, m_sendIdx++, pkts, m_sending.tickMs);
+      if (m_usePacing && m_sendIdx < pkts)
+      {
+        Simulator::Schedule (m_pacingInterval, &VrDownlinkApp::SendNext, this);
+        return;
+      }
+    }
+
+    m_sendStageMs.Add ((Simulator::Now () - m_sendStart).GetMilliSeconds ());
+    m_sendBusy = false;
+    PumpSend ();
+  }
+
+  void OnTxSpace (Ptr<Socket>, uint32_t)
+  {
+    if (!m_sendWaiting) return;
+    m_sendWaiting = false;
+    SendNext ();
+  }
+
+  bool EgressFull () const
+  {
+    Ptr<Queue<Packet>> q = m_egress->GetQueue ();
+    if (m_egressLimit.GetUnit () == QueueSizeUnit::BYTES)
+    {
+      uint32_t bytes = q->GetNBytes () + (m_egressQdisc ? m_egressQdisc->GetNBytes () : 0);
+      return bytes + m_pktSize + m_hdrSize > m_egressLimit.GetValue ();
+    }
+    uint32_t pkts = q->GetNPackets () + (m_egressQdisc ? m_egressQdisc->GetNPackets () : 0);
+    return pkts + 1 > m_egressLimit.GetValue ();
+  }
+
+  void OnEgressDequeue (Ptr<const Packet>)
+  {
+    if (!m_sendWaiting) return;
+    m_sendWaiting = false;
+    // 不在设备 Dequeue 的调用栈里直接发（会重入 queue disc）
+    Simulator::ScheduleNow (&VrDownlinkApp::SendNext, this);
+  }
+
+  Ptr<Socket> m_socket;
+  Address     m_peer;
   uint32_t    m_frameSize;
   Time        m_frameInterval;
   uint32_t    m_pktSize;
   uint32_t    m_frameCounter;
+  std::vector<uint32_t> m_frameSendMs;
 
   bool        m_usePacing;       // true = QUIC-lite 模式
   Time        m_pacingInterval;  // 每个 fragment 之间的发送间隔
+
+  bool        m_useEncoder;
+  TimeDist    m_encode;
+  uint32_t    m_slices;
+  DelaySketch m_encodeMs;
+
+  bool        m_usePipeline;
+  TimeDist    m_render;
+  uint32_t    m_renderDepth;
+  uint32_t    m_sendDepth;
+  bool        m_dropOnFull;
+  std::deque<PipeFrame> m_renderQueue;   // render -> encode
+  std::deque<PipeFrame> m_sendQueue;     // encode -> send
+  bool        m_renderBusy;
+  bool        m_encodeBusy;
+  bool        m_sendBusy;
+  bool        m_renderHeld;              // finished, blocked by a full queue
+  bool        m_encodeHeld;
+  PipeFrame   m_renderOut;
+  PipeFrame   m_encodeOut;
+  PipeFrame   m_sending;
+  bool        m_sendWaiting;             // blocked on socket tx space / egress backlog
+  Ptr<PointToPointNetDevice> m_egress;   // udp/quic: back-pressure source, see SetEgress
+  Ptr<QueueDisc> m_egressQdisc;
+  QueueSize   m_egressLimit;
+  uint32_t    m_sendIdx;
+  Time        m_sendStart;
+  DelaySketch m_renderMs;
+  DelaySketch m_renderWaitMs;
+  DelaySketch m_sendWaitMs;
+  DelaySketch m_sendStageMs;
+  uint32_t    m_skippedTicks;
+  uint32_t    m_queueDrops;
+
+  bool        m_useBatch;
+  uint8_t     m_batchTos;
+  Ptr<VrBatchSender> m_batch;
+  uint32_t    m_gsoSegs;         // 0 = no GSO
+  bool        m_useSession;      // VrSessionHeader instead of VrHeader
+  uint32_t    m_session;
+  uint32_t    m_hdrSize;         // 12 or 16 B on the wire
+  FragmentsFn m_sendFragments;   // SelectPaths: slices and the pipeline's send stage
 };
 
 
 //
-// 3. Receiver app: collect packets by frameId and check deadline
+// Playout buffer: completed frames wait for their display slot
+//   - the player shows one frame per frame interval, in frameId order; the
+//     first completed frame starts playback after the target delay
+//   - target delay (send -> display):
+//       fixed:      playout.target
+//       percentile: playout.percentile of the last playout.window frame delays
+//       kalman:     scalar Kalman estimate of the frame delay + k * stddev
+//     clamped to [playout.min, playout.max]; the playout offset moves toward
+//     the target by at most playout.step per displayed frame (time stretch)
+//   - a frame that is not complete at its slot:
+//       skip:  it is dropped, the previous frame stays on screen (VR style)
+//       stall: playback pauses until it completes (rebuffer); a later frame
+//              completing first ends the stall and the missing ones are skipped
+//   - e2e latency = display time - send time of every displayed frame
 //
-// ===================== Receiver App Supporting UDP + TCP =====================
-
-// 修复后的 VrReceiverApp - 正确处理TCP流
-class VrReceiverApp : public Application
+class PlayoutBuffer
 {
 public:
-  VrReceiverApp ()
-    : m_deadlineMs (33),
-      m_totalFrames (0),
-      m_onTimeFrames (0),
-      m_lateFrames (0),
-      m_incompleteFrames (0),
-      m_useTcp(false),
-      m_tcpBufferSize(200000),
-      m_packetSize(12 + 1200)   // header(12B) + payload(1200B)
+  enum Mode { OFF, FIXED, PERCENTILE, KALMAN };
+
+  PlayoutBuffer ()
+    : m_mode (OFF),
+      m_stall (false),
+      m_targetMs (50),
+      m_percentile (0.95),
+      m_window (64),
+      m_k (3.0),
+      m_minMs (0),
+      m_maxMs (500),
+      m_stepMs (1),
+      m_started (false),
+      m_waiting (false),
+      m_next (0),
+      m_stallStartMs (0),
+      m_kx (0),
+      m_kP (100),
+      m_kVar (0),
+      m_displayed (0),
+      m_skipped (0),
+      m_stalls (0),
+      m_stallMs (0),
+      m_targetSum (0)
+  {}
+
+  static bool ParseMode (const std::string &s, Mode &m)
   {
-    m_tcpBuffer.reserve(m_tcpBufferSize);
+    if      (s == "off")        m = OFF;
+    else if (s == "fixed")      m = FIXED;
+    else if (s == "percentile") m = PERCENTILE;
+    else if (s == "kalman")     m = KALMAN;
+    else return false;
+    return true;
   }
 
-  void SetDeadlineMs (uint32_t d) { m_deadlineMs = d; }
-  void SetUseTcp(bool useTcp) { m_useTcp = useTcp; }
-  void SetPacketSize(uint32_t p) { m_packetSize = p; }
+  void Setup (Mode mode, bool stall, Time interval, double targetMs, double percentile,
+              uint32_t window, double k, double minMs, double maxMs, double stepMs)
+  {
+    m_mode       = mode;
+    m_stall      = stall;
+    m_interval   = interval;
+    m_targetMs   = targetMs;
+    m_percentile = percentile;
+    m_window     = std::max<uint32_t> (window, 1);
+    m_k          = k;
+    m_minMs      = minMs;
+    m_maxMs      = maxMs;
+    m_stepMs     = stepMs;
+    m_kx         = targetMs;
+  }
 
-  uint32_t GetTotalFrames () const { return m_totalFrames; }
-  uint32_t GetOnTimeFrames () const { return m_onTimeFrames; }
-  uint32_t GetLateFrames () const { return m_lateFrames; }
-  uint32_t GetIncompleteFrames () const { return m_incompleteFrames; }
+  bool IsOn () const { return m_mode != OFF; }
 
-  // 下行 per-frame delay 统计
-  std::vector<uint32_t> m_delays;
+  // called by the receiver when all fragments of a frame are in
+  void OnFrameComplete (uint32_t fid, uint32_t sendMs, uint32_t nowMs)
+  {
+    if (m_mode == OFF) return;
+    Estimate (nowMs - sendMs);
+    if (m_started && fid < m_next) return;   // 到得太晚，它的 slot 已经过了（算在 skipped 里）
+    m_ready[fid] = sendMs;
 
-  double GetAvgDelay() const {
-    if (m_delays.empty()) return 0.0;
-    uint64_t sum = 0;
-    for (uint32_t d : m_delays) sum += d;
-    return double(sum) / m_delays.size();
-  }
+    if (!m_started)
+    {
+      m_started = true;
+      m_next    = fid;
+      int64_t at = std::max<int64_t> ((int64_t) sendMs + std::lround (Target ()), nowMs);
+      m_event = Simulator::Schedule (MilliSeconds (at - nowMs), &PlayoutBuffer::Display, this);
+      return;
+    }
 
-  uint32_t GetP99Delay() const {
-    if (m_delays.empty()) return 0;
-    std::vector<uint32_t> sorted = m_delays;
-    std::sort(sorted.begin(), sorted.end());
-    size_t idx = static_cast<size_t>(sorted.size() * 0.99);
-    if (idx >= sorted.size()) idx = sorted.size() - 1;
-    return sorted[idx];
+    if (m_waiting)
+    {
+      m_waiting  = false;
+      m_stallMs += nowMs - m_stallStartMs;
+      m_skipped += fid - m_next;
+      Show (fid, nowMs);
+    }
   }
 
-  uint32_t GetMaxDelay() const {
-    if (m_delays.empty()) return 0;
-    return *std::max_element(m_delays.begin(), m_delays.end());
+  void Stop ()
+  {
+    m_event.Cancel ();
+    if (m_waiting)
+    {
+      m_waiting  = false;
+      m_stallMs += Simulator::Now ().GetMilliSeconds () - m_stallStartMs;
+    }
   }
 
+  uint32_t GetDisplayed () const { return m_displayed; }
+  uint32_t GetSkipped ()   const { return m_skipped; }
+  uint32_t GetStalls ()    const { return m_stalls; }
+  uint64_t GetStallMs ()   const { return m_stallMs; }
+  double   GetTargetSum () const { return m_targetSum; }   // / GetDisplayed () = mean target
+  const DelaySketch &GetE2e () const { return m_e2e; }   // ms
+
 private:
-  struct FrameState {
-    uint16_t pktCount = 0;   // 这一帧一共有多少 fragment
-    uint16_t arrived  = 0;   // 到了多少个 fragment
-    uint32_t sendTsMs = 0;   // 这一帧的发送时间戳（ms）
-    bool     counted  = false; // 是否已经统计过 totalFrames
-    bool     done     = false; // 是否已经完成（onTime 或 late）
-  };
+  void Estimate (double delayMs)
+  {
+    if (m_mode == PERCENTILE)
+    {
+      m_recent.push_back (delayMs);
+      if (m_recent.size () > m_window) m_recent.pop_front ();
+    }
+    else if (m_mode == KALMAN)
+    {
+      // 随机游走状态，观测噪声用 innovation 的滑动方差
+      const double q = 1.0;   // ms^2 per frame
+      double innov = delayMs - m_kx;
+      m_kVar = 0.95 * m_kVar + 0.05 * innov * innov;
+      double r = std::max (m_kVar, 1.0);
+      m_kP += q;
+      double gain = m_kP / (m_kP + r);
+      m_kx += gain * innov;
+      m_kP *= 1 - gain;
+    }
+  }
 
-  // ===== Application 生命周期 =====
-  virtual void StartApplication () override
+  double Target () const
   {
-    if (m_useTcp)
+    double t = m_targetMs;
+    if (m_mode == PERCENTILE && !m_recent.empty ())
     {
-      // TCP: 监听 5000 端口，等待下行连接
-      m_socket = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
-      InetSocketAddress local = InetSocketAddress(Ipv4Address::GetAny(), 5000);
-      m_socket->Bind(local);
-      m_socket->Listen();
-      m_socket->SetAcceptCallback(
-        MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
-        MakeCallback(&VrReceiverApp::HandleTcpAccept, this)
-      );
-      // 这里不再把 m_tcpBufferSize 设成 0！
-      m_tcpBuffer.clear();
+      std::vector<double> v (m_recent.begin (), m_recent.end ());
+      size_t idx = std::min<size_t> (v.size () * m_percentile, v.size () - 1);
+      std::nth_element (v.begin (), v.begin () + idx, v.end ());
+      t = v[idx];
     }
-    else
+    else if (m_mode == KALMAN)
     {
-      // UDP: 直接 Bind+RecvCallback
-      m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
-      m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), 5000));
-      m_socket->SetRecvCallback (MakeCallback (&VrReceiverApp::HandleRead, this));
+      t = m_kx + m_k * std::sqrt (m_kVar);
     }
+    return std::min (std::max (t, m_minMs), m_maxMs);
   }
 
-  virtual void StopApplication () override
+  void Display ()
   {
-    if (m_socket)
+    uint32_t nowMs = Simulator::Now ().GetMilliSeconds ();
+    if (m_ready.count (m_next))
     {
-      m_socket->Close ();
-      m_socket = nullptr;
+      Show (m_next, nowMs);
+      return;
+    }
+    if (m_stall && !m_ready.empty ())
+    {
+      // 后面的帧已经到了：m_next 多半丢了，不为它停
+      m_skipped += m_ready.begin ()->first - m_next;
+      Show (m_ready.begin ()->first, nowMs);
+      return;
+    }
+    if (m_stall)
+    {
+      m_waiting      = true;
+      m_stalls      += 1;
+      m_stallStartMs = nowMs;
+      return;
     }
 
-    // 对所有已经“计入 totalFrames 但没完成”的帧，视作 incomplete
-    for (auto &kv : m_frames)
+    // skip: 冻结上一帧，下一个 slot 放下一帧
+    m_skipped += 1;
+    m_next    += 1;
+    m_event = Simulator::Schedule (m_interval, &PlayoutBuffer::Display, this);
+  }
+
+  void Show (uint32_t fid, uint32_t nowMs)
+  {
+    uint32_t sendMs = m_ready[fid];
+    m_ready.erase (m_ready.begin (), m_ready.upper_bound (fid));
+    m_next       = fid + 1;
+    m_displayed += 1;
+    m_e2e.Add (nowMs - sendMs);
+
+    // 当前 offset 向 target 靠拢，每帧最多 step
+    double target = Target ();
+    double delta  = std::min (std::max (target - (nowMs - sendMs), -m_stepMs), m_stepMs);
+    m_targetSum  += target;
+    Time next = m_interval + MicroSeconds (std::lround (delta * 1000));
+    m_event = Simulator::Schedule (next.IsPositive () ? next : Seconds (0), &PlayoutBuffer::Display, this);
+  }
+
+  Mode     m_mode;
+  bool     m_stall;
+  Time     m_interval;
+  double   m_targetMs;
+  double   m_percentile;
+  uint32_t m_window;
+  double   m_k;
+  double   m_minMs;
+  double   m_maxMs;
+  double   m_stepMs;
+
+  bool     m_started;
+  bool     m_waiting;
+  uint32_t m_next;                         // next frameId to display
+  uint32_t m_stallStartMs;
+  std::map<uint32_t, uint32_t> m_ready;    // completed, not yet shown: frameId -> sendMs
+  EventId  m_event;
+
+  std::deque<double> m_recent;             // percentile
+  double   m_kx;                           // kalman: delay estimate, its variance,
+  double   m_kP;                           //         innovation variance
+  double   m_kVar;
+
+  uint32_t m_displayed;
+  uint32_t m_skipped;
+  uint32_t m_stalls;
+  uint64_t m_stallMs;
+  double   m_targetSum;
+  DelaySketch m_e2e;
+};
+
+
+//
+// Quality proxy: per-frame score from what was decodable at the deadline
+//   - a frame is split into quality.layers layers (fragments in order, base
+//     layer first); layer k is decodable if it and all layers below it are
+//     complete by sendTs + deadline
+//   - score = rate-quality curve at (decodable bytes * 8 / frame interval);
+//     the curve is "Mbps:score,..." points, linear in log(rate), clamped
+//   - no decodable layer (late, incomplete or missing frame) = a frozen
+//     slot, scored quality.freeze
+//   - session QoE: mean and p5 score, freeze ratio, freeze events and layer
+//     switches between consecutive decoded frames
+//   - all incremental: one event per frame at its deadline, state is only
+//     kept for frames still in flight
+//
+class QualityModel
+{
+public:
+  QualityModel ()
+    : m_enabled (false),
+      m_layers (1),
+      m_payload (1200),
+      m_deadlineMs (50),
+      m_freezeScore (20),
+      m_started (false),
+      m_stopped (false),
+      m_next (0),
+      m_lastLayers (0),
+      m_frozen (false),
+      m_frames (0),
+      m_frozenFrames (0),
+      m_freezes (0),
+      m_switches (0),
+      m_scoreSum (0)
+  {}
+
+  // "5:40,10:60,20:75"; false = malformed
+  static bool ParseCurve (const std::string &s, std::vector<std::pair<double, double>> &curve)
+  {
+    curve.clear ();
+    std::stringstream ss (s);
+    std::string pt;
+    while (std::getline (ss, pt, ','))
     {
-      auto &st = kv.second;
-      if (st.counted && !st.done)
+      size_t colon = pt.find (':');
+      if (colon == std::string::npos) return false;
+      double mbps = 0, q = 0;
+      try
       {
-        m_incompleteFrames += 1;
+        mbps = std::stod (pt.substr (0, colon));
+        q    = std::stod (pt.substr (colon + 1));
+      }
+      catch (const std::exception &)
+      {
+        return false;
       }
+      if (mbps <= 0 || (!curve.empty () && mbps <= curve.back ().first)) return false;
+      curve.push_back (std::make_pair (mbps, q));
     }
+    return !curve.empty ();
   }
 
-  // ===== TCP: accept 新连接 =====
-  void HandleTcpAccept(Ptr<Socket> s, const Address&)
+  void Setup (const std::vector<std::pair<double, double>> &curve, uint32_t layers,
+              uint32_t payload, Time interval, uint32_t deadlineMs, double freezeScore)
   {
-    s->SetRecvCallback(MakeCallback(&VrReceiverApp::HandleTcpRead, this));
+    m_enabled     = true;
+    m_curve       = curve;
+    m_layers      = std::max<uint32_t> (layers, 1);
+    m_payload     = payload;
+    m_interval    = interval;
+    m_deadlineMs  = deadlineMs;
+    m_freezeScore = freezeScore;
   }
 
-  // ===== TCP: 处理流式数据 =====
-  void HandleTcpRead (Ptr<Socket> socket)
+  void SetDeadlineMs (uint32_t ms) { m_deadlineMs = ms; }
+  bool IsOn () const { return m_enabled; }
+
+  void OnFragment (uint32_t fid, uint16_t pktId, uint16_t pktCount, uint32_t sendMs)
   {
-    Address from;
-    Ptr<Packet> pkt = socket->RecvFrom(from);
+    if (!m_enabled || m_stopped || (m_started && fid < m_next)) return;
 
-    // 1) 先把收到的所有 segment 全部 append 到 m_tcpBuffer
-    while (pkt && pkt->GetSize() > 0)
+    auto it = m_inFlight.find (fid);
+    if (it == m_inFlight.end ())
     {
-      uint32_t sz = pkt->GetSize();
+      if (!m_started)
+      {
+        m_started = true;
+        m_next    = fid;
+      }
+      it = m_inFlight.emplace (fid, InFlight ()).first;
+      it->second.pktCount = pktCount;
+      it->second.got.assign (m_layers, 0);
 
-      if (m_tcpBuffer.size() + sz > m_tcpBufferSize)
+      int64_t now = Simulator::Now ().GetMilliSeconds ();
+      int64_t due = (int64_t) sendMs + m_deadlineMs;
+      if (now > due)
       {
-        NS_LOG_UNCOND("TCP buffer overflow, clear buffer");
-        m_tcpBuffer.clear();
+        // 第一个 fragment 就过了 deadline：直接按冻结打分，后面的 fragment 走 fid < m_next
+        Score (fid);
         return;
       }
-
-      size_t oldSize = m_tcpBuffer.size();
-      m_tcpBuffer.resize(oldSize + sz);
-      pkt->CopyData(&m_tcpBuffer[oldSize], sz);
-
-      pkt = socket->RecvFrom(from);
+      Simulator::Schedule (MilliSeconds (due - now), &QualityModel::Score, this, fid);
     }
+    it->second.got[LayerOf (pktId, pktCount)] += 1;
+  }
 
-    // 2) 只要 buffer 里还有 >= 1 个完整的“header+payload”块，就反复解析
-    while (m_tcpBuffer.size() >= m_packetSize)
-    {
-      // 前 12 字节是 VrHeader（network-order）
-      VrHeader hdr;
-      hdr.DeserializeFromRaw(m_tcpBuffer.data());
-
-      // 调统一的处理逻辑
-      ProcessPacket(hdr);
+  void Stop () { m_stopped = true; }
 
-      // 丢掉整个一块：header(12B) + payload(1200B)
-      m_tcpBuffer.erase(
-        m_tcpBuffer.begin(),
-        m_tcpBuffer.begin() + m_packetSize
-      );
-    }
-  }
+  uint32_t GetFrames ()       const { return m_frames; }
+  uint32_t GetFrozenFrames () const { return m_frozenFrames; }
+  uint32_t GetFreezes ()      const { return m_freezes; }
+  uint32_t GetSwitches ()     const { return m_switches; }
+  double   GetScoreSum ()     const { return m_scoreSum; }
+  const DelaySketch &GetScores () const { return m_scores; }   // rounded scores
 
-  // ===== UDP: 每个 packet 自带 header，直接拆掉 =====
-  void HandleRead (Ptr<Socket> socket)
+private:
+  struct InFlight
   {
-    Address from;
-    Ptr<Packet> p = socket->RecvFrom (from);
-    if (!p) return;
-
-    VrHeader hdr;
-    p->RemoveHeader(hdr);   // ns-3 会自动识别 12B header（Serialize/Deserialize）
+    uint16_t pktCount = 0;
+    std::vector<uint16_t> got;   // fragments received per layer
+  };
 
-    ProcessPacket(hdr);
+  uint32_t LayerOf (uint32_t pktId, uint32_t pktCount) const
+  {
+    return std::min<uint32_t> (pktId * m_layers / pktCount, m_layers - 1);
   }
 
-  // ===== 统一的 per-fragment 处理逻辑（UDP/TCP 共用） =====
-  void ProcessPacket(const VrHeader& hdr)
+  double Curve (double mbps) const
   {
-    uint32_t fid   = hdr.GetFrameId();
-    uint32_t nowMs = Simulator::Now().GetMilliSeconds();
-
-    auto &st = m_frames[fid];
+    if (mbps <= m_curve.front ().first) return m_curve.front ().second;
+    if (mbps >= m_curve.back ().first)  return m_curve.back ().second;
+    size_t i = 1;
+    while (m_curve[i].first < mbps) ++i;
+    double x0 = std::log (m_curve[i - 1].first), x1 = std::log (m_curve[i].first);
+    double w  = (std::log (mbps) - x0) / (x1 - x0);
+    return m_curve[i - 1].second + w * (m_curve[i].second - m_curve[i - 1].second);
+  }
 
-    if (!st.counted)
+  void Score (uint32_t fid)
+  {
+    if (m_stopped) return;
+    if (fid < m_next)
     {
-      st.counted   = true;
-      st.pktCount  = hdr.GetPktCount();
-      st.sendTsMs  = hdr.GetSendTsMs();
-      m_totalFrames += 1;   // 只要这一帧有第一个 fragment 到达，就算一帧
+      m_inFlight.erase (fid);   // 乱序：已经按冻结计过了
+      return;
     }
 
-    st.arrived += 1;
+    // 中间一个 fragment 都没到的帧：冻结
+    for (; m_next < fid; ++m_next) Add (0, 0);
 
-    // 这一帧第一次达到“所有 fragment 到齐”的时刻 → 判定 delay & onTime/late
-    if (!st.done && st.arrived == st.pktCount)
+    InFlight &f = m_inFlight[fid];
+    uint32_t decodable = 0, pkts = 0;
+    for (uint32_t l = 0; l < m_layers; ++l)
     {
-      uint32_t delta = nowMs - st.sendTsMs;
-      m_delays.push_back(delta);
-
-      if (delta <= m_deadlineMs)
-        m_onTimeFrames += 1;
-      else
-        m_lateFrames += 1;
+      uint32_t size = (l + 1) * f.pktCount / m_layers - l * f.pktCount / m_layers;
+      if (f.got[l] < size) break;
+      decodable += 1;
+      pkts      += size;
+    }
+    Add (decodable, pkts);
+    m_inFlight.erase (fid);
+    m_next = fid + 1;
+  }
 
-      st.done = true;
+  void Add (uint32_t layers, uint32_t pkts)
+  {
+    double q;
+    if (layers == 0)
+    {
+      q = m_freezeScore;
+      m_frozenFrames += 1;
+      if (!m_frozen) m_freezes += 1;
+      m_frozen = true;
+    }
+    else
+    {
+      double mbps = pkts * m_payload * 8.0 / m_interval.GetSeconds () / 1e6;
+      q = Curve (mbps);
+      if (m_lastLayers && layers != m_lastLayers) m_switches += 1;
+      m_lastLayers = layers;
+      m_frozen     = false;
     }
+    m_frames   += 1;
+    m_scoreSum += q;
+    m_scores.Add (std::lround (q));
   }
 
-  // ===== 成员变量 =====
-  Ptr<Socket> m_socket;
-  bool m_useTcp;
+  bool     m_enabled;
+  std::vector<std::pair<double, double>> m_curve;   // (Mbps, score), increasing rate
+  uint32_t m_layers;
+  uint32_t m_payload;        // bytes per fragment
+  Time     m_interval;
+  uint32_t m_deadlineMs;
+  double   m_freezeScore;
+
+  bool     m_started;
+  bool     m_stopped;
+  uint32_t m_next;           // next frameId to score
+  uint32_t m_lastLayers;
+  bool     m_frozen;
+  std::map<uint32_t, InFlight> m_inFlight;
+
+  uint32_t m_frames;
+  uint32_t m_frozenFrames;
+  uint32_t m_freezes;
+  uint32_t m_switches;
+  double   m_scoreSum;
+  DelaySketch m_scores;
+};
 
-  // TCP 流重组缓冲区
-  std::vector<uint8_t> m_tcpBuffer;
-  uint32_t m_tcpBufferSize;
+
+//
+// 3. Receiver app: collect packets by frameId and check deadline
+//
+// ===================== Receiver App Supporting UDP + TCP =====================
+
+//
+// Per-session receive state: frame reassembly, deadline accounting, delay
+// stats, playout buffer and quality model of one VR stream. VrReceiverApp
+// keeps these in a flat table (one entry per session on the node); the
+// table is sized once before the app starts and never grows, so the
+// PlayoutBuffer / QualityModel events that point into it stay valid
+//
+class VrSession
+{
+public:
+  VrSession ()
+    : m_deadlineMs (33),
+      m_totalFrames (0),
+      m_onTimeFrames (0),
+      m_lateFrames (0),
+      m_incompleteFrames (0)
+  {}
+
+  // 已完成的帧按新 deadline 重新分类：frame 计数和从头设置一致。fork 时
+  // 排队/调度（EDF qdisc、AP edf）只从分支点起按新 deadline，warm-up 期间
+  // 的调度仍是旧值；QualityModel 已排好的打分事件不改，所以 fork 拒绝 --qoe
+  void SetDeadlineMs (uint32_t d)
+  {
+    m_deadlineMs   = d;
+    m_quality.SetDeadlineMs (d);   // 只影响之后打分的帧
+    m_onTimeFrames = 0;
+    m_lateFrames   = 0;
+    for (uint32_t delta : m_delays)
+    {
+      if (delta <= d) m_onTimeFrames += 1;
+      else            m_lateFrames   += 1;
+    }
+  }
+
+  uint32_t GetTotalFrames () const { return m_totalFrames; }
+  uint32_t GetOnTimeFrames () const { return m_onTimeFrames; }
+  uint32_t GetLateFrames () const { return m_lateFrames; }
+  uint32_t GetIncompleteFrames () const { return m_incompleteFrames; }
+  const DelaySketch &GetDelaySketch () const { return m_delaySketch; }
+
+  // 播放缓冲：main 里 Setup，off 时不影响其他统计
+  PlayoutBuffer &GetPlayout () { return m_playout; }
+  const PlayoutBuffer &GetPlayout () const { return m_playout; }
+  QualityModel &GetQuality () { return m_quality; }
+  const QualityModel &GetQuality () const { return m_quality; }
+
+  // 单帧结果（frame trace / outage 统计用），StopApplication 之后调用
+  enum FrameStatus { FRAME_MISSING, FRAME_ONTIME, FRAME_LATE, FRAME_INCOMPLETE };
+  FrameStatus GetFrameStatus (uint32_t fid, uint32_t &delayMs) const
+  {
+    delayMs = 0;
+    auto it = m_frames.find (fid);
+    if (it == m_frames.end ()) return FRAME_MISSING;
+    if (!it->second.done) return FRAME_INCOMPLETE;
+    delayMs = it->second.delayMs;
+    return delayMs <= m_deadlineMs ? FRAME_ONTIME : FRAME_LATE;
+  }
+
+  // 下行 per-frame delay 统计
+  std::vector<uint32_t> m_delays;
+
+  double GetAvgDelay() const {
+    if (m_delays.empty()) return 0.0;
+    uint64_t sum = 0;
+    for (uint32_t d : m_delays) sum += d;
+    return double(sum) / m_delays.size();
+  }
+
+  uint32_t GetP99Delay() const {
+    if (m_delays.empty()) return 0;
+    std::vector<uint32_t> sorted = m_delays;
+    std::sort(sorted.begin(), sorted.end());
+    size_t idx = static_cast<size_t>(sorted.size() * 0.99);
+    if (idx >= sorted.size()) idx = sorted.size() - 1;
+    return sorted[idx];
+  }
+
+  uint32_t GetMaxDelay() const {
+    if (m_delays.empty()) return 0;
+    return *std::max_element(m_delays.begin(), m_delays.end());
+  }
+
+  // 同一次仿真里对多个 deadline 事后判定：每个完成帧的 delay 都在 m_delays 里。
+  // 只有 fifo/prio 调度时流量与 deadline 无关，结果才和单独跑 --deadline=d 一致；
+  // edf (qdisc / AP) 按 deadline 排队，main 里拒绝这种组合。QualityModel 和
+  // pcap ring 只按 --deadline 判定，不参与这里
+  std::vector<uint32_t> GetOnTimeFrames (const std::vector<uint32_t> &deadlines) const {
+    std::vector<uint32_t> sorted = m_delays;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<uint32_t> onTime;
+    onTime.reserve(deadlines.size());
+    for (uint32_t d : deadlines)
+      onTime.push_back(std::upper_bound(sorted.begin(), sorted.end(), d) - sorted.begin());
+    return onTime;
+  }
+
+  // ===== 统一的 per-fragment 处理逻辑（UDP/TCP 共用） =====
+  //   Extras: playout buffer / quality model attached (see VrReceiverApp::SelectPaths)
+  template <bool Extras>
+  void OnFragment (const VrHeader& hdr)
+  {
+    uint32_t fid   = hdr.GetFrameId();
+    uint32_t nowMs = Simulator::Now().GetMilliSeconds();
+
+    auto &st = m_frames[fid];
+
+    if (!st.counted)
+    {
+      st.counted   = true;
+      st.pktCount  = hdr.GetPktCount();
+      st.sendTsMs  = hdr.GetSendTsMs();
+      m_totalFrames += 1;   // 只要这一帧有第一个 fragment 到达，就算一帧
+    }
+
+    st.arrived += 1;
+    if constexpr (Extras) m_quality.OnFragment (fid, hdr.GetPktId (), st.pktCount, st.sendTsMs);
+
+    // 这一帧第一次达到“所有 fragment 到齐”的时刻 → 判定 delay & onTime/late
+    if (!st.done && st.arrived == st.pktCount)
+    {
+      uint32_t delta = nowMs - st.sendTsMs;
+      m_delays.push_back(delta);
+      m_delaySketch.Add(delta);
+      st.delayMs = delta;
+      if constexpr (Extras) m_playout.OnFrameComplete (fid, st.sendTsMs, nowMs);
+
+      if (delta <= m_deadlineMs)
+        m_onTimeFrames += 1;
+      else
+        m_lateFrames += 1;
+
+      st.done = true;
+    }
+  }
+
+  void Stop ()
+  {
+    m_playout.Stop ();
+    m_quality.Stop ();
+
+    // 对所有已经“计入 totalFrames 但没完成”的帧，视作 incomplete
+    for (auto &kv : m_frames)
+    {
+      auto &st = kv.second;
+      if (st.counted && !st.done)
+      {
+        m_incompleteFrames += 1;
+      }
+    }
+  }
+
+private:
+  struct FrameState {
+    uint16_t pktCount = 0;   // 这一帧一共有多少 fragment
+    uint16_t arrived  = 0;   // 到了多少个 fragment
+    uint32_t sendTsMs = 0;   // 这一帧的发送时间戳（ms）
+    uint32_t delayMs  = 0;   // 完成时的 delay（done 之后有效）
+    bool     counted  = false; // 是否已经统计过 totalFrames
+    bool     done     = false; // 是否已经完成（onTime 或 late）
+  };
+
+  // 每帧的聚合状态（无论 UDP/TCP）
+  std::map<uint32_t, FrameState> m_frames;
+  DelaySketch m_delaySketch;   // 和 m_delays 同步，给 live reporter 用
+  PlayoutBuffer m_playout;
+  QualityModel  m_quality;
+
+  // 指标统计
+  uint32_t m_deadlineMs;
+  uint32_t m_totalFrames;
+  uint32_t m_onTimeFrames;
+  uint32_t m_lateFrames;
+  uint32_t m_incompleteFrames;
+};
+
+// 修复后的 VrReceiverApp - 正确处理TCP流
+//   one socket per node; sessions > 1 demultiplexes VrSessionHeader onto the
+//   session table, otherwise every fragment goes to session 0
+class VrReceiverApp : public Application
+{
+public:
+  VrReceiverApp ()
+    : m_useTcp(false),
+      m_port(5000),
+      m_tcpBufferSize(200000),
+      m_packetSize(12 + 1200),  // header(12B) + payload(1200B)
+      m_tos(0),
+      m_passive(false),
+      m_groMax(0),
+      m_groSession(nullptr),
+      m_groDeliveries(0),
+      m_groSegments(0),
+      m_sessions(1),
+      m_useSession(false),
+      m_sessionBase(0),
+      m_unknown(0),
+      m_process(&VrSession::OnFragment<true>),
+      m_flush(&VrReceiverApp::FlushGroT<true>)
+  {
+    m_tcpBuffer.reserve(m_tcpBufferSize);
+  }
+
+  // `count` sessions with IDs [base, base + count), carried in VrSessionHeader.
+  // Call once, before the sessions are set up: the table never reallocates
+  void SetSessions (uint32_t count, uint32_t base)
+  {
+    m_sessions    = std::vector<VrSession> (std::max<uint32_t> (count, 1));
+    m_useSession  = true;
+    m_sessionBase = base;
+  }
+  uint32_t GetSessionCount () const { return m_sessions.size (); }
+  VrSession &GetSession (uint32_t idx) { return m_sessions[idx]; }
+  // fragments whose session ID is not in the table (dropped)
+  uint64_t GetUnknownSessionPkts () const { return m_unknown; }
+
+  void SetUseTcp(bool useTcp) { m_useTcp = useTcp; }
+  void SetPacketSize(uint32_t p) { m_packetSize = p; }
+  void SetPort(uint16_t port) { m_port = port; }
+  // TCP: ToS of the ACKs sent back to the server (0 = unmarked)
+  void SetTos(uint8_t tos) { m_tos = tos; }
+
+  // emulation: no socket, fragments are handed in by EmuMonitor. sendTsMs of
+  // an observed header is the simulator time its frame entered the bottleneck
+  void SetPassive (bool passive) { m_passive = passive; }
+  void Observe (const VrHeader &hdr) { (m_sessions[0].*m_process) (hdr); }
+
+  // UDP GRO: back-to-back fragments (same session and frame, consecutive
+  // pktId) are held and handed to the frame logic together, when maxSegs are
+  // collected, the next fragment does not continue the run, or `flush` after
+  // the first one (the end of the NAPI poll). Frame completion is timed at
+  // the flush
+  void SetGro (Time flush, uint32_t maxSegs)
+  {
+    m_groFlush = flush;
+    m_groMax   = std::max<uint32_t> (maxSegs, 1);
+  }
+  uint64_t GetGroDeliveries () const { return m_groDeliveries; }
+  uint64_t GetGroSegments () const { return m_groSegments; }
+
+private:
+  //
+  // Hot path specialization: header format, GRO on/off and whether the
+  // playout/quality stats backends are attached are template parameters of
+  // the read handlers and of VrSession::OnFragment, chosen once in
+  // StartApplication (the backends are set up in main before the app
+  // starts). With extras off, OnFragment<false> only touches the frame map
+  // and delay stats
+  //
+  typedef void (VrSession::*ProcessFn) (const VrHeader &);
+  typedef void (VrReceiverApp::*FlushFn) ();
+  typedef void (VrReceiverApp::*ReadFn) (Ptr<Socket>);
+
+  template <class Hdr>
+  ReadFn SelectPaths (bool gro, bool extras)
+  {
+    static const ReadFn udp[2][2] = {
+      {&VrReceiverApp::HandleReadT<Hdr, false, false>, &VrReceiverApp::HandleReadT<Hdr, false, true>},
+      {&VrReceiverApp::HandleReadT<Hdr, true,  false>, &VrReceiverApp::HandleReadT<Hdr, true,  true>}};
+    static const ReadFn tcp[2] = {
+      &VrReceiverApp::HandleTcpReadT<false>, &VrReceiverApp::HandleTcpReadT<true>};
+    static const ProcessFn process[2] = {
+      &VrSession::OnFragment<false>, &VrSession::OnFragment<true>};
+    static const FlushFn flush[2] = {
+      &VrReceiverApp::FlushGroT<false>, &VrReceiverApp::FlushGroT<true>};
+    m_process = process[extras];
+    m_flush   = flush[extras];
+    return m_useTcp ? tcp[extras] : udp[gro][extras];
+  }
+
+  // ===== Application 生命周期 =====
+  virtual void StartApplication () override
+  {
+    bool extras = false;
+    for (const VrSession &s : m_sessions)
+    {
+      extras = extras || s.GetPlayout ().IsOn () || s.GetQuality ().IsOn ();
+    }
+    m_read = m_useSession ? SelectPaths<VrSessionHeader> (m_groMax > 0, extras)
+                          : SelectPaths<VrHeader> (m_groMax > 0, extras);
+    if (m_passive) return;
+    if (m_useTcp)
+    {
+      // TCP: 监听 m_port（默认 5000），等待下行连接
+      m_socket = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
+      InetSocketAddress local = InetSocketAddress(Ipv4Address::GetAny(), m_port);
+      m_socket->Bind(local);
+      if (m_tos) m_socket->SetIpTos(m_tos);
+      m_socket->Listen();
+      m_socket->SetAcceptCallback(
+        MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
+        MakeCallback(&VrReceiverApp::HandleTcpAccept, this)
+      );
+      // 这里不再把 m_tcpBufferSize 设成 0！
+      m_tcpBuffer.clear();
+    }
+    else
+    {
+      // UDP: 直接 Bind+RecvCallback
+      m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+      m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port));
+      m_socket->SetRecvCallback (MakeCallback (m_read, this));
+    }
+  }
+
+  virtual void StopApplication () override
+  {
+    if (m_socket)
+    {
+      m_socket->Close ();
+      m_socket = nullptr;
+    }
+    (this->*m_flush) ();
+    for (VrSession &s : m_sessions) s.Stop ();
+  }
+
+  // ===== TCP: accept 新连接 =====
+  void HandleTcpAccept(Ptr<Socket> s, const Address&)
+  {
+    if (m_tos) s->SetIpTos(m_tos);   // accept 出来的 socket 不一定继承 ToS
+    s->SetRecvCallback(MakeCallback(m_read, this));
+  }
+
+  // ===== TCP: 处理流式数据（单 session：一条连接一个流） =====
+  template <bool Extras>
+  void HandleTcpReadT (Ptr<Socket> socket)
+  {
+    Address from;
+    Ptr<Packet> pkt = socket->RecvFrom(from);
+
+    // 1) 先把收到的所有 segment 全部 append 到 m_tcpBuffer
+    while (pkt && pkt->GetSize() > 0)
+    {
+      uint32_t sz = pkt->GetSize();
+
+      if (m_tcpBuffer.size() + sz > m_tcpBufferSize)
+      {
+        NS_LOG_UNCOND("TCP buffer overflow, clear buffer");
+        m_tcpBuffer.clear();
+        return;
+      }
+
+      size_t oldSize = m_tcpBuffer.size();
+      m_tcpBuffer.resize(oldSize + sz);
+      pkt->CopyData(&m_tcpBuffer[oldSize], sz);
+
+      pkt = socket->RecvFrom(from);
+    }
+
+    // 2) 只要 buffer 里还有 >= 1 个完整的“header+payload”块，就反复解析
+    while (m_tcpBuffer.size() >= m_packetSize)
+    {
+      // 前 12 字节是 VrHeader（network-order）
+      VrHeader hdr;
+      hdr.DeserializeFromRaw(m_tcpBuffer.data());
+
+      // 调统一的处理逻辑
+      m_sessions[0].OnFragment<Extras>(hdr);
+
+      // 丢掉整个一块：header(12B) + payload(1200B)
+      m_tcpBuffer.erase(
+        m_tcpBuffer.begin(),
+        m_tcpBuffer.begin() + m_packetSize
+      );
+    }
+  }
+
+  // session table lookup; plain VrHeader = the single session
+  template <class Hdr>
+  VrSession *Lookup (const Hdr &hdr)
+  {
+    if constexpr (std::is_same<Hdr, VrSessionHeader>::value)
+    {
+      uint32_t idx = hdr.GetSession () - m_sessionBase;   // 小于 base 时回绕成大数
+      if (idx >= m_sessions.size ())
+      {
+        m_unknown += 1;
+        return nullptr;
+      }
+      return &m_sessions[idx];
+    }
+    else
+    {
+      return &m_sessions[0];
+    }
+  }
+
+  // ===== UDP: 每个 packet 自带 header，直接拆掉 =====
+  template <class Hdr, bool Gro, bool Extras>
+  void HandleReadT (Ptr<Socket> socket)
+  {
+    Address from;
+    Ptr<Packet> p = socket->RecvFrom (from);
+    if (!p) return;
+
+    Hdr hdr;
+    p->RemoveHeader(hdr);   // ns-3 会自动识别 12B header（Serialize/Deserialize）
+    VrSession *s = Lookup (hdr);
+    if (!s) return;
+
+    if constexpr (!Gro)
+    {
+      s->OnFragment<Extras>(hdr);
+    }
+    else
+    {
+      if (!m_gro.empty ())
+      {
+        const VrHeader &last = m_gro.back ();
+        if (s != m_groSession || hdr.GetFrameId () != last.GetFrameId ()
+            || hdr.GetPktId () != last.GetPktId () + 1)
+        {
+          FlushGroT<Extras> ();
+        }
+      }
+      m_groSession = s;
+      m_gro.push_back (hdr);
+      if (m_gro.size () >= m_groMax)
+      {
+        FlushGroT<Extras> ();
+      }
+      else if (m_groEvent.IsExpired ())
+      {
+        m_groEvent = Simulator::Schedule (m_groFlush, &VrReceiverApp::FlushGroT<Extras>, this);
+      }
+    }
+  }
+
+  template <bool Extras>
+  void FlushGroT ()
+  {
+    m_groEvent.Cancel ();
+    if (m_gro.empty ()) return;
+    m_groDeliveries += 1;
+    m_groSegments   += m_gro.size ();
+    for (const VrHeader &hdr : m_gro) m_groSession->OnFragment<Extras> (hdr);
+    m_gro.clear ();
+  }
+
+  // ===== 成员变量 =====
+  Ptr<Socket> m_socket;
+  bool m_useTcp;
+  uint16_t m_port;
+
+  // TCP 流重组缓冲区
+  std::vector<uint8_t> m_tcpBuffer;
+  uint32_t m_tcpBufferSize;
   uint32_t m_packetSize;   // header + payload 的总长度（默认 12+1200）
+  uint8_t  m_tos;          // ACK 的 ToS
+  bool     m_passive;      // emulation: EmuMonitor calls Observe ()
+
+  // GRO
+  Time     m_groFlush;
+  uint32_t m_groMax;       // 0 = GRO off
+  std::vector<VrHeader> m_gro;
+  VrSession *m_groSession; // session of the held run
+  EventId  m_groEvent;
+  uint64_t m_groDeliveries;
+  uint64_t m_groSegments;
+
+  // session table: index = session ID - m_sessionBase
+  std::vector<VrSession> m_sessions;
+  bool     m_useSession;   // VrSessionHeader on the wire
+  uint32_t m_sessionBase;
+  uint64_t m_unknown;
+
+  // SelectPaths
+  ProcessFn m_process;     // Observe (emulation)
+  FlushFn   m_flush;       // StopApplication
+  ReadFn    m_read;        // UDP recv / accepted TCP sockets
+};
+
+
+class UplinkHeader : public Header
+{
+public:
+  UplinkHeader (uint32_t ts = 0) : m_ts(ts) {}
+
+  void SetTs (uint32_t ts) { m_ts = ts; }
+  uint32_t GetTs () const { return m_ts; }
+
+  static TypeId GetTypeId (void) {
+    static TypeId tid = TypeId("UplinkHeader")
+      .SetParent<Header>()
+      .AddConstructor<UplinkHeader>();
+    return tid;
+  }
+
+  virtual TypeId GetInstanceTypeId (void) const { return GetTypeId(); }
+  virtual void Print (std::ostream& os) const { os << m_ts; }
+
+  virtual uint32_t GetSerializedSize (void) const { return 4; }
+
+  virtual void Serialize (Buffer::Iterator start) const {
+    start.WriteHtonU32(m_ts);
+  }
+
+  virtual uint32_t Deserialize (Buffer::Iterator start) {
+    m_ts = start.ReadNtohU32();
+    return 4;
+  }
+
+private:
+  uint32_t m_ts;
+};
+
+// UplinkHeader + session ID (sessions.perHeadset > 1: one uplink port for all)
+class UplinkSessionHeader : public UplinkHeader
+{
+public:
+  UplinkSessionHeader (uint32_t ts = 0, uint32_t session = 0) : UplinkHeader(ts), m_session(session) {}
+
+  uint32_t GetSession () const { return m_session; }
+
+  static TypeId GetTypeId (void) {
+    static TypeId tid = TypeId("UplinkSessionHeader")
+      .SetParent<UplinkHeader>()
+      .AddConstructor<UplinkSessionHeader>();
+    return tid;
+  }
+
+  virtual TypeId GetInstanceTypeId (void) const { return GetTypeId(); }
+  virtual void Print (std::ostream& os) const { UplinkHeader::Print(os); os << " session=" << m_session; }
+
+  virtual uint32_t GetSerializedSize (void) const { return 8; }
+
+  virtual void Serialize (Buffer::Iterator start) const {
+    start.WriteHtonU32(GetTs());
+    start.WriteHtonU32(m_session);
+  }
+
+  virtual uint32_t Deserialize (Buffer::Iterator start) {
+    SetTs(start.ReadNtohU32());
+    m_session = start.ReadNtohU32();
+    return 8;
+  }
+
+private:
+  uint32_t m_session;
+};
+
+//
+// 4. Uplink app: send small packets periodically (e.g., every 10ms)
+//
+class VrUplinkApp : public Application
+{
+public:
+  VrUplinkApp () : m_useSession(false), m_session(0) {}
+
+  void Setup (Ptr<Socket> socket, Address peer,
+              Time interval, uint32_t pktSize)
+  {
+    m_socket   = socket;
+    m_peer     = peer;
+    m_interval = interval;
+    m_pktSize  = pktSize;
+  }
+
+  // shared uplink port: tag every packet with the session ID
+  void SetSession (uint32_t session)
+  {
+    m_useSession = true;
+    m_session    = session;
+  }
+
+private:
+  virtual void StartApplication () override
+  {
+    m_socket->Connect (m_peer);
+    SendOne ();
+  }
+
+  void SendOne ()
+  {
+    uint32_t nowMs = Simulator::Now ().GetMilliSeconds ();
+
+    Ptr<Packet> p = Create<Packet> (m_pktSize);
+    if (m_useSession)
+    {
+      p->AddHeader (UplinkSessionHeader (nowMs, m_session));
+    }
+    else
+    {
+      UplinkHeader hdr(nowMs);
+      p->AddHeader(hdr);
+    }
+
+    m_socket->Send (p);
+
+    Simulator::Schedule (m_interval, &VrUplinkApp::SendOne, this);
+  }
+
+  Ptr<Socket> m_socket;
+  Address     m_peer;
+  Time        m_interval;
+  uint32_t    m_pktSize;
+  bool        m_useSession;
+  uint32_t    m_session;
+};
+
+class VrUplinkReceiver : public Application
+{
+public:
+  std::vector<uint32_t> m_delays;
+  DelaySketch m_sketch;
+
+  void SetPort (uint16_t port) { m_port = port; }
+
+  // one receiver for `count` sessions (IDs 0..count-1): UplinkSessionHeader,
+  // per-session counters in a flat table; m_delays / m_sketch stay merged
+  struct Session
+  {
+    uint32_t pkts       = 0;
+    uint32_t maxDelayMs = 0;
+  };
+  void SetSessions (uint32_t count) { m_sessions.assign (count, Session ()); }
+  const std::vector<Session> &GetSessions () const { return m_sessions; }
+  uint64_t GetUnknownSessionPkts () const { return m_unknown; }
+
+private:
+  virtual void StartApplication() override
+  {
+    Ptr<Socket> s =
+      Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    s->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_port));
+    s->SetRecvCallback(MakeCallback(&VrUplinkReceiver::HandleRead, this));
+    m_socket = s;
+  }
+
+  void HandleRead(Ptr<Socket> socket)
+  {
+    Address from;
+    Ptr<Packet> p = socket->RecvFrom(from);
+    if (!p) return;
+
+    uint32_t now = Simulator::Now().GetMilliSeconds();
+    if (!m_sessions.empty ())
+    {
+      UplinkSessionHeader hdr;
+      p->RemoveHeader(hdr);
+      if (hdr.GetSession () >= m_sessions.size ())
+      {
+        m_unknown += 1;
+        return;
+      }
+      Session &s = m_sessions[hdr.GetSession ()];
+      s.pkts       += 1;
+      s.maxDelayMs  = std::max (s.maxDelayMs, now - hdr.GetTs ());
+      m_delays.push_back(now - hdr.GetTs());
+      m_sketch.Add(now - hdr.GetTs());
+      return;
+    }
+
+    UplinkHeader hdr;
+    p->RemoveHeader(hdr);
+
+    uint32_t sendTs = hdr.GetTs();
+    m_delays.push_back(now - sendTs);
+    m_sketch.Add(now - sendTs);
+  }
+
+  Ptr<Socket> m_socket;
+  uint16_t    m_port = 6000;
+  std::vector<Session> m_sessions;   // empty = single session, plain UplinkHeader
+  uint64_t    m_unknown = 0;
+};
+
+//
+// VR header lookup on an in-flight packet (AP scheduling, queue discs)
+//   - hasIpv4: packet still starts with the IPv4 header (NetDevice::Send);
+//     queue disc items carry the IPv4 header separately
+//   - only UDP to vrPort carries a VrHeader right after the UDP header;
+//     TCP segments do not align with fragments, so they never match
+//
+static bool
+PeekVrHeader (Ptr<const Packet> p, bool hasIpv4, uint16_t vrPort, VrHeader &vr)
+{
+  Ptr<Packet> c = p->Copy ();
+  if (hasIpv4)
+  {
+    Ipv4Header ip;
+    if (c->RemoveHeader (ip) == 0 || ip.GetProtocol () != UdpL4Protocol::PROT_NUMBER) return false;
+  }
+
+  UdpHeader udp;
+  if (c->GetSize () < udp.GetSerializedSize () + vr.GetSerializedSize ()) return false;
+  c->RemoveHeader (udp);
+  if (udp.GetDestinationPort () != vrPort) return false;
+
+  c->PeekHeader (vr);
+  return true;
+}
+
+//
+// EDF queue disc for the bottleneck: serve VR fragments in deadline order
+//   - deadline = VrHeader sendTsMs + deadline for VR fragments (UDP to
+//     vrPort), arrival time for everything else (uplink, ACKs): non-VR
+//     traffic is never held back behind a frame burst
+//   - one FIFO lane per flow (5-tuple hash); within a flow deadlines never
+//     decrease, so taking the lane head with the smallest deadline is exact
+//     EDF without sorting individual packets
+//   - a VR fragment whose deadline has passed is dropped at dequeue instead
+//     of spending link time on a frame that is already late
+//   - MaxSize bounds the sum of all lanes (same meaning as --queue)
+//
+class VrEdfQueueDisc : public QueueDisc
+{
+public:
+  static constexpr const char *EXPIRED_DROP   = "Deadline expired";
+  static constexpr const char *OVERLIMIT_DROP = "Queue disc limit exceeded";
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::VrEdfQueueDisc")
+      .SetParent<QueueDisc> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<VrEdfQueueDisc> ();
+    return tid;
+  }
+
+  VrEdfQueueDisc ()
+    : QueueDisc (QueueDiscSizePolicy::MULTIPLE_QUEUES, QueueSizeUnit::PACKETS),
+      m_deadlineMs (50),
+      m_vrPort (5000)
+  {}
+
+  void Setup (uint32_t deadlineMs, uint16_t vrPort)
+  {
+    m_deadlineMs = deadlineMs;
+    m_vrPort     = vrPort;
+  }
+
+  // --forkParam=deadline 分支后也要跟着改；已排队的 VR 包一起平移
+  void SetDeadlineMs (uint32_t ms)
+  {
+    int64_t shift = (int64_t) ms - m_deadlineMs;
+    for (Lane &lane : m_lanes)
+    {
+      for (size_t i = 0; i < lane.deadlines.size (); ++i)
+      {
+        if (lane.isVr[i]) lane.deadlines[i] += shift;
+      }
+    }
+    m_deadlineMs = ms;
+  }
+
+private:
+  struct Lane
+  {
+    std::size_t         queue;       // internal queue index
+    std::deque<int64_t> deadlines;   // parallel to the internal queue
+    std::deque<bool>    isVr;
+  };
+
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item) override
+  {
+    if (GetCurrentSize () + item > GetMaxSize ())
+    {
+      DropBeforeEnqueue (item, OVERLIMIT_DROP);
+      return false;
+    }
+
+    uint32_t flow = item->Hash ();
+    auto it = m_laneOf.find (flow);
+    if (it == m_laneOf.end ())
+    {
+      // 新 flow 第一次出现时才建 lane
+      AddInternalQueue (CreateObjectWithAttributes<DropTailQueue<QueueDiscItem>> (
+                          "MaxSize", QueueSizeValue (GetMaxSize ())));
+      it = m_laneOf.emplace (flow, m_lanes.size ()).first;
+      m_lanes.push_back (Lane {GetNInternalQueues () - 1, {}, {}});
+    }
+    Lane &lane = m_lanes[it->second];
+
+    // queue disc item 的 packet 不含 IPv4 header
+    VrHeader vr;
+    bool isVr = PeekVrHeader (item->GetPacket (), false, m_vrPort, vr);
+    int64_t deadline = isVr ? (int64_t) vr.GetSendTsMs () + m_deadlineMs
+                            : Simulator::Now ().GetMilliSeconds ();
+
+    if (!GetInternalQueue (lane.queue)->Enqueue (item))
+    {
+      return false;   // internal queue 已经调用 DropBeforeEnqueue
+    }
+    lane.deadlines.push_back (deadline);
+    lane.isVr.push_back (isVr);
+    return true;
+  }
+
+  virtual Ptr<QueueDiscItem> DoDequeue (void) override
+  {
+    int64_t now = Simulator::Now ().GetMilliSeconds ();
+
+    while (true)
+    {
+      // lane 数 = flow 数（每个用户几个），线性扫描足够
+      Lane *best = nullptr;
+      for (Lane &lane : m_lanes)
+      {
+        if (!lane.deadlines.empty ()
+            && (!best || lane.deadlines.front () < best->deadlines.front ()))
+        {
+          best = &lane;
+        }
+      }
+      if (!best) return nullptr;
+
+      Ptr<QueueDiscItem> item = GetInternalQueue (best->queue)->Dequeue ();
+      int64_t deadline = best->deadlines.front ();
+      bool    isVr     = best->isVr.front ();
+      best->deadlines.pop_front ();
+      best->isVr.pop_front ();
+
+      if (isVr && deadline < now)
+      {
+        DropAfterDequeue (item, EXPIRED_DROP);
+        continue;
+      }
+      return item;
+    }
+  }
+
+  virtual bool CheckConfig (void) override
+  {
+    if (GetMaxSize ().GetValue () == 0)
+    {
+      NS_LOG_UNCOND ("VrEdfQueueDisc: MaxSize must be > 0");
+      return false;
+    }
+    return true;
+  }
+
+  virtual void InitializeParams (void) override {}
+
+  uint32_t m_deadlineMs;
+  uint16_t m_vrPort;
+  std::map<uint32_t, std::size_t> m_laneOf;   // flow hash -> lane
+  std::vector<Lane>               m_lanes;
+};
+
+//
+// Strict-priority queue disc: three DSCP bands, lower band always first
+//   band 0: EF / CS5..CS7 (dscp >= 40)    IMU uplink, ACKs/control
+//   band 1: AF3x / CS3 / AF4x / CS4        VR video
+//   band 2: everything else (incl. unmarked)
+//   - classified by the IPv4 DS field, so marks set at the sender survive
+//     forwarding through the ap unchanged
+//   - MaxSize bounds the sum of all bands (same meaning as --queue)
+//
+class VrPrioQueueDisc : public QueueDisc
+{
+public:
+  static constexpr const char *OVERLIMIT_DROP = "Queue disc limit exceeded";
+  static const uint32_t N_BANDS = 3;
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::VrPrioQueueDisc")
+      .SetParent<QueueDisc> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<VrPrioQueueDisc> ();
+    return tid;
+  }
+
+  VrPrioQueueDisc ()
+    : QueueDisc (QueueDiscSizePolicy::MULTIPLE_QUEUES, QueueSizeUnit::PACKETS)
+  {}
+
+  static uint32_t DscpToBand (uint8_t dscp)
+  {
+    if (dscp >= 40) return 0;
+    if (dscp >= 24) return 1;
+    return 2;
+  }
+
+private:
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item) override
+  {
+    if (GetCurrentSize () + item > GetMaxSize ())
+    {
+      DropBeforeEnqueue (item, OVERLIMIT_DROP);
+      return false;
+    }
+
+    uint8_t tos = 0;
+    item->GetUint8Value (QueueItem::IP_DSFIELD, tos);
+    return GetInternalQueue (DscpToBand (tos >> 2))->Enqueue (item);
+  }
+
+  virtual Ptr<QueueDiscItem> DoDequeue (void) override
+  {
+    for (uint32_t b = 0; b < N_BANDS; ++b)
+    {
+      Ptr<QueueDiscItem> item = GetInternalQueue (b)->Dequeue ();
+      if (item) return item;
+    }
+    return nullptr;
+  }
+
+  virtual bool CheckConfig (void) override
+  {
+    if (GetMaxSize ().GetValue () == 0)
+    {
+      NS_LOG_UNCOND ("VrPrioQueueDisc: MaxSize must be > 0");
+      return false;
+    }
+    return true;
+  }
+
+  virtual void InitializeParams (void) override
+  {
+    for (uint32_t b = 0; b < N_BANDS; ++b)
+    {
+      AddInternalQueue (CreateObjectWithAttributes<DropTailQueue<QueueDiscItem>> (
+                          "MaxSize", QueueSizeValue (GetMaxSize ())));
+    }
+  }
+};
+
+//
+// Outage gate: wraps the link's real queue disc (child) and stops the link
+// while the headset is in an outage (handover, roaming, blockage)
+//   - buffer: nothing is dequeued during the outage; packets wait in the
+//     child (subject to its own limit) and drain when the link comes back
+//   - drop:   the child is flushed at outage start and every packet offered
+//     during the outage is dropped (OUTAGE_DROP)
+//   - the device queue under the gate must be tiny (1p), otherwise packets
+//     already handed to the device still cross the link
+//
+class OutageQueueDisc : public QueueDisc
+{
+public:
+  static constexpr const char *OUTAGE_DROP = "Link outage";
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::OutageQueueDisc")
+      .SetParent<QueueDisc> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<OutageQueueDisc> ();
+    return tid;
+  }
+
+  OutageQueueDisc ()
+    : QueueDisc (QueueDiscSizePolicy::SINGLE_CHILD_QUEUE_DISC),
+      m_down (false),
+      m_drop (false)
+  {}
+
+  void SetChild (Ptr<QueueDisc> child)
+  {
+    Ptr<QueueDiscClass> c = CreateObject<QueueDiscClass> ();
+    c->SetQueueDisc (child);
+    AddQueueDiscClass (c);
+  }
+
+  void SetDown (bool down, bool drop)
+  {
+    m_down = down;
+    m_drop = drop;
+    if (down && drop)
+    {
+      Ptr<QueueDisc> child = GetQueueDiscClass (0)->GetQueueDisc ();
+      while (Ptr<QueueDiscItem> item = child->Dequeue ())
+      {
+        DropAfterDequeue (item, OUTAGE_DROP);
+      }
+    }
+    if (!down)
+    {
+      Run ();   // 恢复后主动拉一次，不等下一个包来触发
+    }
+  }
+
+private:
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item) override
+  {
+    if (m_down && m_drop)
+    {
+      DropBeforeEnqueue (item, OUTAGE_DROP);
+      return false;
+    }
+    return GetQueueDiscClass (0)->GetQueueDisc ()->Enqueue (item);
+  }
+
+  virtual Ptr<QueueDiscItem> DoDequeue (void) override
+  {
+    if (m_down) return nullptr;
+    return GetQueueDiscClass (0)->GetQueueDisc ()->Dequeue ();
+  }
+
+  virtual bool CheckConfig (void) override
+  {
+    if (GetNQueueDiscClasses () != 1)
+    {
+      NS_LOG_UNCOND ("OutageQueueDisc: needs exactly one child queue disc");
+      return false;
+    }
+    return true;
+  }
+
+  virtual void InitializeParams (void) override {}
+
+  bool m_down;
+  bool m_drop;
+};
+
+//
+// Fluid background on the bottleneck (background.mode = fluid)
+//   - root queue disc of the server's bottleneck device: one FIFO shared by
+//     the packet-level flows and a fluid background of `flows` on/off
+//     sources (exponential on/off periods, peak rate chosen so the mean is
+//     `rate`; off = 0: constant rate)
+//   - exact FIFO mixing via the unfinished work W (seconds at link rate):
+//     between events dW/dt = bg(t) / R - 1, clamped at 0 and at the buffer
+//     (fluid above it is dropped); a packet arriving at t starts on the
+//     wire at t + W and adds its own L / R
+//   - a packet is dropped if W * R + L exceeds the buffer (drop-tail on
+//     bytes, shared with the fluid); otherwise it is held here until its
+//     start time, so the 1p device queue below sends it on an idle link
+//   - cost: one event per source on/off switch, none per background byte
+//
+class FluidBgQueueDisc : public QueueDisc
+{
+public:
+  static constexpr const char *OVERFLOW_DROP = "Shared buffer full";
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::FluidBgQueueDisc")
+      .SetParent<QueueDisc> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<FluidBgQueueDisc> ();
+    return tid;
+  }
+
+  FluidBgQueueDisc ()
+    : QueueDisc (QueueDiscSizePolicy::NO_LIMITS),
+      m_bufferBytes (0),
+      m_peakBps (0),
+      m_bgBps (0),
+      m_offeredBytes (0),
+      m_droppedBytes (0),
+      m_pkts (0)
+  {}
+
+  void Setup (DataRate link, uint64_t bufferBytes, uint32_t flows, DataRate mean, Time on, Time off)
+  {
+    m_link        = link;
+    m_bufferBytes = bufferBytes;
+    m_on          = on;
+    m_off         = off;
+    m_sources.assign (flows, false);
+
+    double duty = off.IsZero () ? 1.0 : on.GetSeconds () / (on + off).GetSeconds ();
+    m_peakBps = flows ? mean.GetBitRate () / (flows * duty) : 0.0;
+    m_onOff   = CreateObject<ExponentialRandomVariable> ();
+    m_coin    = CreateObject<UniformRandomVariable> ();
+  }
+
+  // sources start in their stationary state at t = 0 and run to the end
+  void Start ()
+  {
+    double duty = m_off.IsZero () ? 1.0 : m_on.GetSeconds () / (m_on + m_off).GetSeconds ();
+    for (uint32_t i = 0; i < m_sources.size (); ++i)
+    {
+      m_sources[i] = m_off.IsZero () || m_coin->GetValue () < duty;
+      if (m_sources[i]) m_bgBps += m_peakBps;
+      if (!m_off.IsZero ()) ScheduleToggle (i);
+    }
+  }
+
+  // at the end of the run: bring the fluid up to Now
+  void Finish () { Advance (); }
+
+  double   GetOfferedBytes () const { return m_offeredBytes; }
+  double   GetDroppedBytes () const { return m_droppedBytes; }
+  uint64_t GetPackets () const { return m_pkts; }
+  // FIFO wait (unfinished work ahead) seen by arriving packets
+  double   GetWaitAvgMs () const { return m_pkts ? m_waitSum.GetSeconds () * 1000.0 / m_pkts : 0.0; }
+  double   GetWaitMaxMs () const { return m_waitMax.GetSeconds () * 1000.0; }
+
+private:
+  void ScheduleToggle (uint32_t i)
+  {
+    Time mean = m_sources[i] ? m_on : m_off;
+    Simulator::Schedule (Seconds (m_onOff->GetValue (mean.GetSeconds (), 0)),
+                         &FluidBgQueueDisc::Toggle, this, i);
+  }
+
+  void Toggle (uint32_t i)
+  {
+    Advance ();
+    m_sources[i] = !m_sources[i];
+    m_bgBps += m_sources[i] ? m_peakBps : -m_peakBps;
+    if (m_bgBps < 1.0) m_bgBps = 0.0;   // 浮点累加误差
+    ScheduleToggle (i);
+  }
+
+  // W 在两个事件之间是线性的，终点截到 [0, buffer] 就是精确解
+  void Advance ()
+  {
+    Time now = Simulator::Now ();
+    double dt = (now - m_last).GetSeconds ();
+    m_last = now;
+    if (dt <= 0.0) return;
+
+    double in   = m_bgBps * dt / 8.0;
+    double work = m_work.GetSeconds () + dt * (m_bgBps / m_link.GetBitRate () - 1.0);
+    double cap  = m_bufferBytes * 8.0 / m_link.GetBitRate ();
+    m_offeredBytes += in;
+    if (work > cap)
+    {
+      m_droppedBytes += (work - cap) * m_link.GetBitRate () / 8.0;
+      work = cap;
+    }
+    m_work = Seconds (std::max (work, 0.0));
+  }
+
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item) override
+  {
+    Advance ();
+    uint32_t bytes = item->GetSize () + 2;   // + PPP header
+    if (m_work.GetSeconds () * m_link.GetBitRate () / 8.0 + bytes > m_bufferBytes)
+    {
+      DropBeforeEnqueue (item, OVERFLOW_DROP);
+      return false;
+    }
+
+    m_pkts    += 1;
+    m_waitSum += m_work;
+    m_waitMax  = std::max (m_waitMax, m_work);
+    m_start.push_back (Simulator::Now () + m_work);
+    m_work += m_link.CalculateBytesTxTime (bytes);
+    return GetInternalQueue (0)->Enqueue (item);
+  }
+
+  virtual Ptr<QueueDiscItem> DoDequeue (void) override
+  {
+    if (m_start.empty ()) return nullptr;
+    Time start = m_start.front ();
+    if (start > Simulator::Now ())
+    {
+      // 还轮不到它：前面的 fluid 还没发完，到点再拉
+      if (m_wake.IsExpired ())
+      {
+        m_wake = Simulator::Schedule (start - Simulator::Now (), &FluidBgQueueDisc::Run, this);
+      }
+      return nullptr;
+    }
+    m_start.pop_front ();
+    return GetInternalQueue (0)->Dequeue ();
+  }
+
+  virtual bool CheckConfig (void) override
+  {
+    if (m_link.GetBitRate () == 0 || m_bufferBytes == 0)
+    {
+      NS_LOG_UNCOND ("FluidBgQueueDisc: call Setup() with a link rate and a buffer");
+      return false;
+    }
+    return true;
+  }
+
+  virtual void InitializeParams (void) override
+  {
+    // 字节上限在 DoEnqueue 里按共享 buffer 判，内部队列本身不设限
+    AddInternalQueue (CreateObjectWithAttributes<DropTailQueue<QueueDiscItem>> (
+                        "MaxSize", QueueSizeValue (QueueSize ("1000000p"))));
+  }
+
+  DataRate          m_link;
+  uint64_t          m_bufferBytes;
+  Time              m_on;
+  Time              m_off;
+  std::vector<bool> m_sources;        // on / off
+  double            m_peakBps;        // per source while on
+  double            m_bgBps;          // current aggregate background rate
+  Ptr<ExponentialRandomVariable> m_onOff;
+  Ptr<UniformRandomVariable>     m_coin;
+
+  Time              m_work;           // unfinished work at the link (fluid + packets)
+  Time              m_last;           // m_work is valid at this time
+  std::deque<Time>  m_start;          // wire start time of each queued packet
+  EventId           m_wake;
+
+  double            m_offeredBytes;
+  double            m_droppedBytes;
+  uint64_t          m_pkts;
+  Time              m_waitSum;
+  Time              m_waitMax;
+};
+
+//
+// Last-hop device base: the NetDevice boilerplate shared by the abstract
+// access models below (AirNetDevice, CellNetDevice)
+//   - broadcast-capable, no ARP: the AP / gNB side maps IPv4 destinations
+//     to stations itself
+//   - derived classes implement Send() and GetChannel(); their channel
+//     hands packets back through Receive()
+//
+class LastHopDevice : public NetDevice
+{
+public:
+  LastHopDevice ()
+    : m_ifIndex (0),
+      m_mtu (1500),
+      m_address (Mac48Address::Allocate ())
+  {}
+
+  // ===== delivery from the channel =====
+  void Receive (Ptr<Packet> p, uint16_t protocol, Mac48Address from)
+  {
+    if (!m_rxCallback.IsNull ())
+      m_rxCallback (this, p, protocol, from);
+  }
+
+  // ===== NetDevice =====
+  virtual void SetIfIndex (const uint32_t index) override { m_ifIndex = index; }
+  virtual uint32_t GetIfIndex () const override { return m_ifIndex; }
+  virtual void SetAddress (Address address) override { m_address = Mac48Address::ConvertFrom (address); }
+  virtual Address GetAddress () const override { return m_address; }
+  virtual bool SetMtu (const uint16_t mtu) override { m_mtu = mtu; return true; }
+  virtual uint16_t GetMtu () const override { return m_mtu; }
+  virtual bool IsLinkUp () const override { return true; }
+  virtual void AddLinkChangeCallback (Callback<void> callback) override {}
+  virtual bool IsBroadcast () const override { return true; }
+  virtual Address GetBroadcast () const override { return Mac48Address ("ff:ff:ff:ff:ff:ff"); }
+  virtual bool IsMulticast () const override { return false; }
+  virtual Address GetMulticast (Ipv4Address group) const override { return Mac48Address::GetMulticast (group); }
+  virtual Address GetMulticast (Ipv6Address addr) const override { return Mac48Address::GetMulticast (addr); }
+  virtual bool IsBridge () const override { return false; }
+  virtual bool IsPointToPoint () const override { return false; }
+  virtual Ptr<Node> GetNode () const override { return m_node; }
+  virtual void SetNode (Ptr<Node> node) override { m_node = node; }
+  virtual bool NeedsArp () const override { return false; }
+  virtual bool SupportsSendFrom () const override { return false; }
+  virtual void SetReceiveCallback (NetDevice::ReceiveCallback cb) override { m_rxCallback = cb; }
+  virtual void SetPromiscReceiveCallback (NetDevice::PromiscReceiveCallback cb) override {}
+
+  virtual bool SendFrom (Ptr<Packet> packet, const Address &source, const Address &dest,
+                         uint16_t protocolNumber) override
+  {
+    return Send (packet, dest, protocolNumber);
+  }
+
+protected:
+  Ptr<Node>       m_node;
+  uint32_t        m_ifIndex;
+  uint16_t        m_mtu;
+  Mac48Address    m_address;
+  NetDevice::ReceiveCallback m_rxCallback;
+};
+
+//
+// Shared AP air interface: one medium, per-station queues at the AP
+//   - AirChannel serialises every transmission (one sender at a time);
+//     backlogged senders (AP + stations) take turns, like DCF's equal
+//     transmit opportunities
+//   - every station has its own PHY rate: a packet to/from station i costs
+//     overhead + size * 8 / rate_i of airtime, so slow stations cost more
+//   - AP downlink scheduler:
+//       fifo    - one shared FIFO (arrival order across stations)
+//       rr      - round-robin over backlogged stations, one packet each
+//       airtime - deficit round-robin in airtime units (airtime fairness)
+//       edf     - earliest deadline first; VR deadline = VrHeader sendTsMs
+//                 + deadline, anything else = its arrival time
+//   - no ARP: the AP maps the IPv4 destination to a station
+//
+class AirNetDevice;
+
+class AirChannel : public Channel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::AirChannel")
+      .SetParent<Channel> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<AirChannel> ();
+    return tid;
+  }
+
+  AirChannel ()
+    : m_overhead (Seconds (0)),
+      m_busy (false)
+  {}
+
+  void SetOverhead (Time t) { m_overhead = t; }
+
+  // the AP must be attached first; stations get index 0..N-1 in attach order
+  uint32_t Attach (Ptr<AirNetDevice> dev);
+
+  // a device went from idle to backlogged
+  void RequestAccess (Ptr<AirNetDevice> dev);
+
+  Time GetAirtime (uint32_t bytes, uint32_t sta) const;
+
+  virtual std::size_t GetNDevices () const override { return m_devices.size (); }
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const override;
+
+private:
+  void TryStart ();
+  void EndTx (Ptr<AirNetDevice> sender);
+
+  std::vector<Ptr<AirNetDevice>> m_devices;   // [0] = AP, [1 + i] = station i
+  std::deque<Ptr<AirNetDevice>>  m_contenders;
+  Time m_overhead;
+  bool m_busy;
+};
+
+class AirNetDevice : public LastHopDevice
+{
+public:
+  enum Scheduler { FIFO, RR, AIRTIME, EDF };
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::AirNetDevice")
+      .SetParent<NetDevice> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<AirNetDevice> ();
+    return tid;
+  }
+
+  AirNetDevice ()
+    : m_isAp (false),
+      m_staIndex (0),
+      m_rate (DataRate ("100Mbps")),
+      m_delay (Seconds (0)),
+      m_queueLimit (100),
+      m_scheduler (FIFO),
+      m_deadlineMs (50),
+      m_vrPort (5000),
+      m_seq (0),
+      m_backlog (0),
+      m_drops (0),
+      m_inContention (false)
+  {}
+
+  static bool ParseScheduler (const std::string &name, Scheduler &s)
+  {
+    if      (name == "fifo")    s = FIFO;
+    else if (name == "rr")      s = RR;
+    else if (name == "airtime") s = AIRTIME;
+    else if (name == "edf")     s = EDF;
+    else return false;
+    return true;
+  }
+
+  void SetupAp (Scheduler sched, uint32_t queueLimit, Time quantum,
+                uint32_t deadlineMs, uint16_t vrPort)
+  {
+    m_isAp       = true;
+    m_scheduler  = sched;
+    m_queueLimit = queueLimit;
+    m_quantum    = std::max (quantum, MicroSeconds (1));   // 0 会让 DRR 死循环
+    m_deadlineMs = deadlineMs;
+    m_vrPort     = vrPort;
+  }
+
+  // --forkParam=deadline: later VR packets and the ones already in the edf
+  // heap use the new deadline
+  void SetDeadlineMs (uint32_t ms)
+  {
+    int64_t shift = (int64_t) ms - m_deadlineMs;
+    m_deadlineMs = ms;
+    if (m_scheduler != EDF) return;
+    for (Entry &e : m_heap)
+    {
+      if (e.vr) e.key += shift;
+    }
+    std::make_heap (m_heap.begin (), m_heap.end (), EntryLater);
+  }
+
+  void SetupStation (DataRate rate, Time delay, uint32_t queueLimit)
+  {
+    m_isAp       = false;
+    m_rate       = rate;
+    m_delay      = delay;
+    m_queueLimit = queueLimit;
+  }
+
+  void Attach (Ptr<AirChannel> ch)
+  {
+    m_channel  = ch;
+    m_staIndex = ch->Attach (this);
+  }
+
+  // AP only: IPv4 destination -> station, called after address assignment
+  void AddStation (Ipv4Address addr, uint32_t sta)
+  {
+    m_ipToSta[addr] = sta;
+    if (m_stations.size () <= sta) m_stations.resize (sta + 1);
+  }
+
+  DataRate GetRate ()  const { return m_rate; }
+  Time     GetDelay () const { return m_delay; }
+  uint64_t GetDrops () const { return m_drops; }
+  bool     HasBacklog () const { return m_backlog > 0; }
+
+  // ===== called by AirChannel when this device wins the medium =====
+  // 返回要发的包和对端 station（AP 发给谁 / station 自己）
+  bool Dequeue (Ptr<Packet> &p, uint16_t &protocol, uint32_t &sta)
+  {
+    if (m_backlog == 0) return false;
+
+    if (!m_isAp)
+    {
+      Entry e = m_fifo.front ();
+      m_fifo.pop_front ();
+      p = e.packet; protocol = e.protocol; sta = m_staIndex;
+      m_backlog -= 1;
+      return true;
+    }
+
+    Entry e;
+    if (m_scheduler == FIFO || m_scheduler == EDF)
+    {
+      std::pop_heap (m_heap.begin (), m_heap.end (), EntryLater);
+      e = m_heap.back ();
+      m_heap.pop_back ();
+    }
+    else
+    {
+      e = DequeueRoundRobin ();
+    }
+
+    m_stations[e.sta].queued -= 1;
+    m_backlog -= 1;
+    p = e.packet; protocol = e.protocol; sta = e.sta;
+    return true;
+  }
+
+  void SetInContention (bool v) { m_inContention = v; }
+  bool IsInContention () const { return m_inContention; }
+
+  // ===== NetDevice =====
+  virtual Ptr<Channel> GetChannel () const override { return m_channel; }
+
+  virtual bool Send (Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber) override
+  {
+    Entry e;
+    e.packet   = packet;
+    e.protocol = protocolNumber;
+    e.seq      = m_seq++;
+    e.sta      = m_staIndex;
+
+    if (!m_isAp)
+    {
+      if (m_fifo.size () >= m_queueLimit)
+      {
+        m_drops += 1;
+        return false;
+      }
+      m_fifo.push_back (e);
+    }
+    else
+    {
+      // 不走 ARP：按 IPv4 目的地址找 station
+      Ipv4Header ip;
+      packet->PeekHeader (ip);
+      auto it = m_ipToSta.find (ip.GetDestination ());
+      if (it == m_ipToSta.end ())
+      {
+        m_drops += 1;
+        return false;
+      }
+      e.sta = it->second;
+
+      StaQueue &sq = m_stations[e.sta];
+      if (sq.queued >= m_queueLimit)
+      {
+        m_drops += 1;
+        return false;
+      }
+      sq.queued += 1;
+
+      if (m_scheduler == FIFO || m_scheduler == EDF)
+      {
+        e.key = (int64_t) e.seq;
+        if (m_scheduler == EDF)
+        {
+          VrHeader vr;
+          e.vr  = PeekVrHeader (packet, true, m_vrPort, vr);
+          e.key = e.vr ? (int64_t) vr.GetSendTsMs () + m_deadlineMs
+                       : Simulator::Now ().GetMilliSeconds ();
+        }
+        m_heap.push_back (e);
+        std::push_heap (m_heap.begin (), m_heap.end (), EntryLater);
+      }
+      else
+      {
+        sq.fifo.push_back (e);
+        if (!sq.active)
+        {
+          sq.active  = true;
+          sq.deficit = Seconds (0);
+          m_active.push_back (e.sta);
+        }
+      }
+    }
+
+    m_backlog += 1;
+    if (!m_inContention)
+    {
+      m_channel->RequestAccess (this);
+    }
+    return true;
+  }
+
+private:
+  struct Entry
+  {
+    Ptr<Packet> packet;
+    uint16_t    protocol = 0;
+    uint64_t    seq      = 0;
+    int64_t     key      = 0;    // fifo: seq, edf: absolute deadline (ms)
+    uint32_t    sta      = 0;
+    bool        vr       = false; // edf: key = sendTs + deadline
+  };
+
+  struct StaQueue
+  {
+    std::deque<Entry> fifo;       // rr / airtime only
+    uint32_t queued  = 0;
+    Time     deficit;
+    bool     active  = false;
+  };
+
+  // min-heap on (key, seq)
+  static bool EntryLater (const Entry &a, const Entry &b)
+  {
+    return a.key != b.key ? a.key > b.key : a.seq > b.seq;
+  }
+
+  Entry DequeueRoundRobin ()
+  {
+    while (true)
+    {
+      uint32_t sta = m_active.front ();
+      StaQueue &sq = m_stations[sta];
+      Entry &head  = sq.fifo.front ();
+
+      if (m_scheduler == AIRTIME)
+      {
+        Time cost = m_channel->GetAirtime (head.packet->GetSize (), sta);
+        if (sq.deficit < cost)
+        {
+          // 这一轮额度不够：加 quantum，排到队尾
+          sq.deficit += m_quantum;
+          m_active.pop_front ();
+          m_active.push_back (sta);
+          continue;
+        }
+        sq.deficit -= cost;
+      }
+
+      Entry e = head;
+      sq.fifo.pop_front ();
+      m_active.pop_front ();
+      if (!sq.fifo.empty ())
+      {
+        // rr：每次一个包就轮到下一个；airtime：额度还够就继续留在队首
+        if (m_scheduler == AIRTIME && sq.deficit > Seconds (0)) m_active.push_front (sta);
+        else m_active.push_back (sta);
+      }
+      else
+      {
+        sq.active = false;
+      }
+      return e;
+    }
+  }
+
+  Ptr<AirChannel> m_channel;
+
+  bool     m_isAp;
+  uint32_t m_staIndex;
+  DataRate m_rate;        // station PHY rate
+  Time     m_delay;       // station propagation delay
+  uint32_t m_queueLimit;  // per-station packets
+
+  // AP state
+  Scheduler m_scheduler;
+  Time      m_quantum;
+  uint32_t  m_deadlineMs;
+  uint16_t  m_vrPort;
+  std::map<Ipv4Address, uint32_t> m_ipToSta;
+  std::vector<StaQueue> m_stations;
+  std::deque<uint32_t>  m_active;   // rr / airtime rotation
+  std::vector<Entry>    m_heap;     // fifo / edf
+
+  // station state
+  std::deque<Entry> m_fifo;
+
+  uint64_t m_seq;
+  uint64_t m_backlog;
+  uint64_t m_drops;
+  bool     m_inContention;
+};
+
+uint32_t
+AirChannel::Attach (Ptr<AirNetDevice> dev)
+{
+  m_devices.push_back (dev);
+  return m_devices.size () >= 2 ? m_devices.size () - 2 : 0;
+}
+
+Ptr<NetDevice>
+AirChannel::GetDevice (std::size_t i) const
+{
+  return m_devices[i];
+}
+
+Time
+AirChannel::GetAirtime (uint32_t bytes, uint32_t sta) const
+{
+  return m_overhead + m_devices[1 + sta]->GetRate ().CalculateBytesTxTime (bytes);
+}
+
+void
+AirChannel::RequestAccess (Ptr<AirNetDevice> dev)
+{
+  dev->SetInContention (true);
+  m_contenders.push_back (dev);
+  TryStart ();
+}
+
+void
+AirChannel::TryStart ()
+{
+  if (m_busy || m_contenders.empty ()) return;
+
+  Ptr<AirNetDevice> sender = m_contenders.front ();
+  m_contenders.pop_front ();
+
+  Ptr<Packet> p;
+  uint16_t protocol = 0;
+  uint32_t sta = 0;
+  if (!sender->Dequeue (p, protocol, sta))
+  {
+    sender->SetInContention (false);
+    TryStart ();
+    return;
+  }
+
+  // AP -> station sta，或 station sta -> AP
+  Ptr<AirNetDevice> peer = (sender == m_devices[0]) ? m_devices[1 + sta] : m_devices[0];
+  Time airtime = GetAirtime (p->GetSize (), sta);
+  Time delay   = m_devices[1 + sta]->GetDelay ();
+
+  m_busy = true;
+  Simulator::ScheduleWithContext (peer->GetNode ()->GetId (), airtime + delay,
+                                  &AirNetDevice::Receive, peer, p, protocol,
+                                  Mac48Address::ConvertFrom (sender->GetAddress ()));
+  Simulator::Schedule (airtime, &AirChannel::EndTx, this, sender);
+}
+
+void
+AirChannel::EndTx (Ptr<AirNetDevice> sender)
+{
+  m_busy = false;
+  // 还有包就回到竞争队尾，和其他发送方轮流
+  if (sender->HasBacklog ())
+    m_contenders.push_back (sender);
+  else
+    sender->SetInContention (false);
+  TryStart ();
+}
+//
+// Abstract cellular last hop (access.mode = cell): TTI-slotted, no PHY
+//   - one cell: gNB on the ap node, one UE per headset
+//   - time is cut into TTIs; every TTI has a DL and an UL byte budget, either
+//     constant (cell.dlRate / cell.ulRate) or read from cell.trace, one
+//     "<dl Mbps> <ul Mbps>" line per TTI (cycled)
+//   - DL: the gNB serves backlogged UEs round-robin inside the budget;
+//     packets may be split across TTIs (RLC segmentation)
+//   - UL: a UE with new data and no grant waits for its next SR opportunity
+//     (cell.srPeriod) plus cell.grantDelay; it keeps the grant while its
+//     buffer is non-empty (BSR) and loses it once the buffer drains.
+//     cell.configuredGrant = every UE is always granted
+//   - HARQ: each transport block (one UE, one TTI) fails with cell.bler;
+//     every failure adds cell.harqRtt, after cell.harqMax transmissions the
+//     packets in it are lost. Retransmissions do not take capacity from
+//     later TTIs
+//   - the TTI clock only ticks while someone has data: idle time costs no
+//     events, which keeps the model cheap enough for sweeps
+//
+class CellNetDevice;
+
+class CellChannel : public Channel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CellChannel")
+      .SetParent<Channel> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<CellChannel> ();
+    return tid;
+  }
+
+  CellChannel ()
+    : m_tti (MicroSeconds (500)),
+      m_srPeriod (MilliSeconds (5)),
+      m_grantDelay (MilliSeconds (3)),
+      m_harqRtt (MilliSeconds (2)),
+      m_bler (0.1),
+      m_harqMax (4),
+      m_configuredGrant (false),
+      m_queueLimit (1000),
+      m_ttiPending (false),
+      m_lastSlot (-1),
+      m_dlNext (0),
+      m_ulNext (0),
+      m_tbs (0),
+      m_harqRetx (0),
+      m_harqLost (0),
+      m_drops (0),
+      m_outageDrops (0),
+      m_grants (0)
+  {
+    m_rng = CreateObject<UniformRandomVariable> ();
+  }
+
+  void Setup (Time tti, DataRate dl, DataRate ul, Time srPeriod, Time grantDelay,
+              Time harqRtt, double bler, uint32_t harqMax, bool configuredGrant,
+              uint32_t queueLimit)
+  {
+    m_tti             = tti;
+    m_dlRate          = dl;
+    m_ulRate          = ul;
+    m_srPeriod        = srPeriod;
+    m_grantDelay      = grantDelay;
+    m_harqRtt         = harqRtt;
+    m_bler            = bler;
+    m_harqMax         = std::max<uint32_t> (harqMax, 1);
+    m_configuredGrant = configuredGrant;
+    m_queueLimit      = queueLimit;
+  }
+
+  // "<dl Mbps> <ul Mbps>" per TTI; '#' comments and blank lines are skipped
+  bool LoadTrace (const std::string &path)
+  {
+    std::ifstream in (path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline (in, line))
+    {
+      size_t hash = line.find ('#');
+      if (hash != std::string::npos) line.erase (hash);
+      std::stringstream ls (line);
+      double dl = 0, ul = 0;
+      if (!(ls >> dl)) continue;
+      if (!(ls >> ul)) ul = 0;
+      m_trace.push_back (std::make_pair (TtiBytes (dl * 1e6), TtiBytes (ul * 1e6)));
+    }
+    return !m_trace.empty ();
+  }
+
+  // the gNB must be attached first; UEs get index 0..N-1 in attach order
+  uint32_t Attach (Ptr<CellNetDevice> dev, Time delay)
+  {
+    m_devices.push_back (dev);
+    if (m_devices.size () == 1) return 0;
+
+    m_ues.push_back (UeState ());
+    m_ues.back ().delay   = delay;
+    m_ues.back ().granted = m_configuredGrant;
+    return m_ues.size () - 1;
+  }
+
+  bool EnqueueDl (uint32_t ue, Ptr<Packet> p, uint16_t protocol)
+  {
+    if (DropInOutage (ue)) return false;
+    return Enqueue (m_ues[ue].dl, p, protocol) && Kick ();
+  }
+
+  bool EnqueueUl (uint32_t ue, Ptr<Packet> p, uint16_t protocol)
+  {
+    UeState &u = m_ues[ue];
+    if (DropInOutage (ue)) return false;
+    if (!Enqueue (u.ul, p, protocol)) return false;
+    if (u.granted) return Kick ();
+    if (u.srPending) return true;
+
+    // 下一个 SR 机会（按 UE 错开）+ SR -> grant 的调度时延
+    int64_t now    = Simulator::Now ().GetTimeStep ();
+    int64_t period = std::max<int64_t> (m_srPeriod.GetTimeStep (), 1);
+    int64_t offset = (ue * m_tti.GetTimeStep ()) % period;
+    int64_t sr     = now - offset <= 0 ? offset
+                     : offset + ((now - offset + period - 1) / period) * period;
+
+    u.srPending = true;
+    u.waitSince = Simulator::Now ();
+    Simulator::Schedule (Time (sr - now) + m_grantDelay, &CellChannel::Grant, this, ue);
+    return true;
+  }
+
+  // headset-link outage (handover): a UE that is down is not scheduled in
+  // either direction; drop = its queues are flushed and new packets lost
+  void SetOutage (uint32_t ue, bool down, bool drop)
+  {
+    UeState &u = m_ues[ue];
+    u.down       = down;
+    u.outageDrop = drop;
+    if (down && drop)
+    {
+      m_outageDrops += u.dl.size () + u.ul.size ();
+      u.dl.clear ();
+      u.ul.clear ();
+    }
+    if (!down && (!u.dl.empty () || !u.ul.empty ())) Kick ();
+  }
+
+  uint64_t GetDrops ()    const { return m_drops; }
+  uint64_t GetOutageDrops () const { return m_outageDrops; }
+  uint64_t GetTbs ()      const { return m_tbs; }
+  uint64_t GetHarqRetx () const { return m_harqRetx; }
+  uint64_t GetHarqLost () const { return m_harqLost; }
+  uint64_t GetGrants ()   const { return m_grants; }
+  const DelaySketch &GetGrantWait () const { return m_grantWait; }   // ms
+
+  virtual std::size_t GetNDevices () const override { return m_devices.size (); }
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const override;
+
+private:
+  struct Entry
+  {
+    Ptr<Packet> packet;
+    uint16_t    protocol  = 0;
+    uint32_t    remaining = 0;   // bytes not yet sent (segmentation)
+  };
+
+  struct UeState
+  {
+    std::deque<Entry> dl;
+    std::deque<Entry> ul;
+    Time delay;
+    bool granted   = false;
+    bool srPending = false;
+    Time waitSince;
+    bool down       = false;   // outage
+    bool outageDrop = false;
+  };
+
+  bool DropInOutage (uint32_t ue)
+  {
+    if (!m_ues[ue].down || !m_ues[ue].outageDrop) return false;
+    m_outageDrops += 1;
+    return true;
+  }
+
+  uint64_t TtiBytes (double bps) const
+  {
+    return static_cast<uint64_t> (bps * m_tti.GetSeconds () / 8);
+  }
+
+  bool Enqueue (std::deque<Entry> &q, Ptr<Packet> p, uint16_t protocol)
+  {
+    if (q.size () >= m_queueLimit)
+    {
+      m_drops += 1;
+      return false;
+    }
+    Entry e;
+    e.packet    = p;
+    e.protocol  = protocol;
+    e.remaining = p->GetSize ();
+    q.push_back (e);
+    return true;
+  }
+
+  // start the TTI clock at the next TTI boundary if it is not running;
+  // a slot that was already served never gets a second budget
+  bool Kick ()
+  {
+    if (m_ttiPending) return true;
+    int64_t now  = Simulator::Now ().GetTimeStep ();
+    int64_t T    = m_tti.GetTimeStep ();
+    int64_t slot = std::max ((now + T - 1) / T, m_lastSlot + 1);
+    m_ttiPending = true;
+    Simulator::Schedule (Time (slot * T - now), &CellChannel::Tti, this);
+    return true;
+  }
+
+  void Grant (uint32_t ue)
+  {
+    UeState &u = m_ues[ue];
+    u.srPending = false;
+    u.granted   = true;
+    m_grants   += 1;
+    m_grantWait.Add ((Simulator::Now () - u.waitSince).GetMilliSeconds ());
+    Kick ();
+  }
+
+  void Tti ();
+  void Serve (bool downlink, uint64_t budget);
+  void SendTb (bool downlink, uint32_t ue, std::vector<Entry> &tb);
+
+  std::vector<Ptr<CellNetDevice>> m_devices;   // [0] = gNB, [1 + i] = UE i
+  std::vector<UeState> m_ues;
+  std::vector<std::pair<uint64_t, uint64_t>> m_trace;   // bytes per TTI (dl, ul)
+
+  Time     m_tti;
+  DataRate m_dlRate;
+  DataRate m_ulRate;
+  Time     m_srPeriod;
+  Time     m_grantDelay;
+  Time     m_harqRtt;
+  double   m_bler;
+  uint32_t m_harqMax;
+  bool     m_configuredGrant;
+  uint32_t m_queueLimit;   // packets per UE and direction
+
+  bool     m_ttiPending;
+  int64_t  m_lastSlot;     // last TTI served
+  uint32_t m_dlNext;       // round-robin start
+  uint32_t m_ulNext;
+  Ptr<UniformRandomVariable> m_rng;
+
+  uint64_t m_tbs;
+  uint64_t m_harqRetx;
+  uint64_t m_harqLost;
+  uint64_t m_drops;
+  uint64_t m_outageDrops;
+  uint64_t m_grants;
+  DelaySketch m_grantWait;
+};
+
+class CellNetDevice : public LastHopDevice
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CellNetDevice")
+      .SetParent<NetDevice> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<CellNetDevice> ();
+    return tid;
+  }
+
+  CellNetDevice ()
+    : m_isGnb (false),
+      m_ue (0)
+  {}
+
+  void Attach (Ptr<CellChannel> ch, bool isGnb, Time delay)
+  {
+    m_channel = ch;
+    m_isGnb   = isGnb;
+    m_ue      = ch->Attach (this, delay);
+  }
+
+  // gNB only: IPv4 destination -> UE, called after address assignment
+  void AddUe (Ipv4Address addr, uint32_t ue) { m_ipToUe[addr] = ue; }
+
+  virtual Ptr<Channel> GetChannel () const override { return m_channel; }
+
+  virtual bool Send (Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber) override
+  {
+    if (!m_isGnb)
+    {
+      return m_channel->EnqueueUl (m_ue, packet, protocolNumber);
+    }
+
+    Ipv4Header ip;
+    packet->PeekHeader (ip);
+    auto it = m_ipToUe.find (ip.GetDestination ());
+    if (it == m_ipToUe.end ()) return false;
+    return m_channel->EnqueueDl (it->second, packet, protocolNumber);
+  }
+
+private:
+  Ptr<CellChannel> m_channel;
+  bool     m_isGnb;
+  uint32_t m_ue;
+  std::map<Ipv4Address, uint32_t> m_ipToUe;
+};
+
+Ptr<NetDevice>
+CellChannel::GetDevice (std::size_t i) const
+{
+  return m_devices[i];
+}
+
+void
+CellChannel::Tti ()
+{
+  m_ttiPending = false;
+  m_lastSlot   = Simulator::Now ().GetTimeStep () / m_tti.GetTimeStep ();
+
+  uint64_t dl = TtiBytes (m_dlRate.GetBitRate ());
+  uint64_t ul = TtiBytes (m_ulRate.GetBitRate ());
+  if (!m_trace.empty ())
+  {
+    // 按绝对 TTI 编号取 trace，时钟停过也和时间对齐
+    dl = m_trace[m_lastSlot % m_trace.size ()].first;
+    ul = m_trace[m_lastSlot % m_trace.size ()].second;
+  }
+
+  Serve (true, dl);
+  Serve (false, ul);
+
+  for (const UeState &u : m_ues)
+  {
+    if (!u.down && (!u.dl.empty () || (u.granted && !u.ul.empty ())))
+    {
+      m_ttiPending = true;
+      Simulator::Schedule (m_tti, &CellChannel::Tti, this);
+      return;
+    }
+  }
+}
+
+void
+CellChannel::Serve (bool downlink, uint64_t budget)
+{
+  uint32_t n = m_ues.size ();
+  uint32_t &next = downlink ? m_dlNext : m_ulNext;
+  std::vector<std::vector<Entry>> tbs (n);
+
+  // 逐包轮转：每个 UE 一次发一个包（或其剩余分段），直到预算用完
+  bool progress = true;
+  while (budget > 0 && progress)
+  {
+    progress = false;
+    for (uint32_t k = 0; k < n && budget > 0; ++k)
+    {
+      uint32_t ue = (next + k) % n;
+      UeState &u = m_ues[ue];
+      std::deque<Entry> &q = downlink ? u.dl : u.ul;
+      if (q.empty () || u.down || (!downlink && !u.granted)) continue;
+
+      Entry &head = q.front ();
+      uint64_t take = std::min<uint64_t> (budget, head.remaining);
+      head.remaining -= take;
+      budget         -= take;
+      progress        = true;
+      if (head.remaining == 0)
+      {
+        tbs[ue].push_back (head);
+        q.pop_front ();
+      }
+    }
+  }
+  next = n ? (next + 1) % n : 0;
+
+  for (uint32_t ue = 0; ue < n; ++ue)
+  {
+    if (!tbs[ue].empty ()) SendTb (downlink, ue, tbs[ue]);
+
+    // buffer 清空，grant 失效，下次有数据要重新发 SR
+    UeState &u = m_ues[ue];
+    if (!downlink && u.granted && u.ul.empty () && !m_configuredGrant) u.granted = false;
+  }
+}
+
+void
+CellChannel::SendTb (bool downlink, uint32_t ue, std::vector<Entry> &tb)
+{
+  m_tbs += 1;
+
+  uint32_t failures = 0;
+  while (failures < m_harqMax && m_rng->GetValue () < m_bler) failures += 1;
+  if (failures == m_harqMax)
+  {
+    m_harqRetx += failures - 1;
+    m_harqLost += 1;
+    return;
+  }
+  m_harqRetx += failures;
+
+  // TTI 结束时解码成功，每次 HARQ 重传多等一个 RTT
+  Time delay = m_tti + m_harqRtt * (int64_t) failures + m_ues[ue].delay;
+  Ptr<CellNetDevice> from = downlink ? m_devices[0] : m_devices[1 + ue];
+  Ptr<CellNetDevice> to   = downlink ? m_devices[1 + ue] : m_devices[0];
+  for (const Entry &e : tb)
+  {
+    Simulator::ScheduleWithContext (to->GetNode ()->GetId (), delay,
+                                    &CellNetDevice::Receive, to, e.packet, e.protocol,
+                                    Mac48Address::ConvertFrom (from->GetAddress ()));
+  }
+}
+
+
+//
+// Outage process on the headset links (outage.mode)
+//   - scheduled: outage.at = "3s,7.5s", the same instants for every
+//     selected user
+//   - poisson: independent per user, exponential gaps (mean
+//     outage.interval) between the end of one outage and the next start
+//   - length of each outage: outage.duration fixed, exp (same mean) or
+//     uniform in [0.5, 1.5] x duration
+//   - targets: the OutageQueueDisc gates of a p2p headset link (both
+//     directions) or the user's UE in the cell; buffer/drop is applied there
+//   - all outages are drawn up front and logged (id, user, start, end), so
+//     frames can be tagged afterwards; overlapping outages of one user merge
+//
+class OutageProcess
+{
+public:
+  struct Outage
+  {
+    uint32_t id;
+    uint32_t user;
+    Time     start;
+    Time     end;
+  };
+
+  OutageProcess ()
+    : m_drop (false)
+  {}
+
+  void Setup (const std::string &dist, Time duration, Time interval, bool drop)
+  {
+    m_dist     = dist;
+    m_duration = duration;
+    m_interval = interval;
+    m_drop     = drop;
+  }
+
+  void AddGate (uint32_t user, Ptr<OutageQueueDisc> gate) { m_gates[user].push_back (gate); }
+  void SetCell (Ptr<CellChannel> cell) { m_cell = cell; }
+
+  // outage.mode = scheduled
+  void Add (uint32_t user, Time at)
+  {
+    Time len = SampleDuration ();
+    m_log.push_back (Outage {(uint32_t) m_log.size (), user, at, at + len});
+    Simulator::Schedule (at, &OutageProcess::Switch, this, user, true);
+    Simulator::Schedule (at + len, &OutageProcess::Switch, this, user, false);
+  }
+
+  // outage.mode = poisson: outages starting in [from, until)
+  void AddPoisson (uint32_t user, Time from, Time until)
+  {
+    if (!m_gap) m_gap = CreateObject<ExponentialRandomVariable> ();
+    Time t = from + Seconds (m_gap->GetValue (m_interval.GetSeconds (), 0));
+    while (t < until)
+    {
+      Add (user, t);
+      t = m_log.back ().end + Seconds (m_gap->GetValue (m_interval.GetSeconds (), 0));
+    }
+  }
+
+  const std::vector<Outage> &GetOutages () const { return m_log; }
+
+  uint64_t GetGateDrops () const
+  {
+    uint64_t n = 0;
+    for (const auto &kv : m_gates)
+    {
+      for (const Ptr<OutageQueueDisc> &g : kv.second)
+      {
+        n += g->GetStats ().GetNDroppedPackets (OutageQueueDisc::OUTAGE_DROP);
+      }
+    }
+    return n;
+  }
+
+private:
+  Time SampleDuration ()
+  {
+    if (m_dist == "fixed") return m_duration;
+    if (!m_len)
+    {
+      m_len    = CreateObject<ExponentialRandomVariable> ();
+      m_spread = CreateObject<UniformRandomVariable> ();
+    }
+    if (m_dist == "exp") return Seconds (m_len->GetValue (m_duration.GetSeconds (), 0));
+    return Seconds (m_spread->GetValue (0.5, 1.5) * m_duration.GetSeconds ());
+  }
+
+  void Switch (uint32_t user, bool down)
+  {
+    // 同一用户的重叠 outage 计数，最后一个结束才恢复
+    uint32_t &depth = m_depth[user];
+    if (down ? depth++ > 0 : --depth > 0) return;
+
+    for (const Ptr<OutageQueueDisc> &g : m_gates[user])
+    {
+      g->SetDown (down, m_drop);
+    }
+    if (m_cell) m_cell->SetOutage (user, down, m_drop);
+  }
+
+  std::string m_dist;
+  Time        m_duration;
+  Time        m_interval;
+  bool        m_drop;
+
+  std::map<uint32_t, std::vector<Ptr<OutageQueueDisc>>> m_gates;
+  Ptr<CellChannel> m_cell;
+  std::map<uint32_t, uint32_t> m_depth;
+  std::vector<Outage> m_log;
+
+  // 只在用到时才建，关掉 outage 时不改变其他随机流的编号
+  Ptr<ExponentialRandomVariable> m_gap;
+  Ptr<ExponentialRandomVariable> m_len;
+  Ptr<UniformRandomVariable>     m_spread;
+};
+
+//
+// Live reporter: periodic in-simulation snapshots for long/soak runs
+//   - every `interval` of simulated time: frame counters, delay sketch
+//     quantiles, uplink stats and bottleneck queue occupancy (summed /
+//     merged over all users)
+//   - one "[LIVE] key=value ..." line per snapshot (same shape as [VR-RECV])
+//   - sink: "stdout", a file path, or "unix:/path" (connects to a listening
+//     SOCK_STREAM socket, e.g. `nc -lU /path`)
+//   - bounded memory: at most maxLines snapshots wait for a slow consumer;
+//     newer ones are dropped and counted in the next line's dropped=
+//   - a consumer that disconnects (EPIPE, sent with MSG_NOSIGNAL) only ends
+//     the live output; the run goes on. At exit the queue gets at most
+//     kCloseTimeoutMs to drain, lines still unsent are counted as dropped
+//
+class LiveReporter
+{
+public:
+  LiveReporter (const std::vector<VrSession *> &recvs,
+                const std::vector<Ptr<VrUplinkReceiver>> &uls,
+                NetDeviceContainer devs)
+    : m_recvs (recvs),
+      m_uls (uls),
+      m_devs (devs),
+      m_fd (-1),
+      m_ownFd (false),
+      m_isSocket (false),
+      m_maxLines (1024),
+      m_offset (0),
+      m_dropped (0)
+  {}
+
+  ~LiveReporter ()
+  {
+    Close ();
+  }
+
+  bool Open (const std::string &target, uint32_t maxLines)
+  {
+    m_maxLines = std::max<uint32_t> (1, maxLines);
+
+    if (target == "stdout")
+    {
+      m_fd = STDOUT_FILENO;
+      return true;
+    }
+
+    if (target.compare (0, 5, "unix:") == 0)
+    {
+      std::string path = target.substr (5);
+      sockaddr_un addr {};
+      if (path.size () >= sizeof (addr.sun_path)) return false;
+      addr.sun_family = AF_UNIX;
+      std::memcpy (addr.sun_path, path.c_str (), path.size () + 1);
+
+      m_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+      if (m_fd < 0) return false;
+      if (connect (m_fd, (const sockaddr *) &addr, sizeof (addr)) != 0)
+      {
+        close (m_fd);
+        m_fd = -1;
+        return false;
+      }
+      // 非阻塞：消费者卡住时绝不拖慢仿真，只在内存里排队
+      fcntl (m_fd, F_SETFL, fcntl (m_fd, F_GETFL) | O_NONBLOCK);
+      m_ownFd    = true;
+      m_isSocket = true;
+      return true;
+    }
+
+    m_fd = open (target.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    m_ownFd = true;
+    return m_fd >= 0;
+  }
+
+  void Start (Time interval)
+  {
+    m_interval = interval;
+    Simulator::Schedule (interval, &LiveReporter::Snapshot, this);
+  }
+
+  // final flush after Simulator::Run(): waits up to kCloseTimeoutMs for a
+  // slow consumer, then drops the rest instead of hanging at exit
+  void Close ()
+  {
+    if (m_fd < 0) return;
+    auto until = std::chrono::steady_clock::now () + std::chrono::milliseconds (kCloseTimeoutMs);
+    Flush ();
+    while (m_fd >= 0 && !m_pending.empty ())
+    {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds> (
+                    until - std::chrono::steady_clock::now ()).count ();
+      if (left <= 0) break;
+      pollfd pfd {m_fd, POLLOUT, 0};
+      if (poll (&pfd, 1, (int) left) < 0 && errno != EINTR) break;
+      Flush ();
+    }
+    if (m_fd < 0) return;   // 消费者已断开，Flush 里处理过了
+    if (!m_pending.empty ())
+    {
+      m_dropped += m_pending.size ();
+      m_pending.clear ();
+      std::cerr << "[LIVE] sink stalled at exit, dropped=" << m_dropped << std::endl;
+    }
+    if (m_ownFd) close (m_fd);
+    m_fd = -1;
+  }
+
+private:
+  static constexpr int kCloseTimeoutMs = 1000;
+
+  void Snapshot ()
+  {
+    if (m_fd < 0) return;   // sink 断开后不再采样
+    DelaySketch dl;
+    DelaySketch ul;
+    uint32_t total  = 0;
+    uint32_t onTime = 0;
+    uint32_t late   = 0;
+    for (const VrSession *r : m_recvs)
+    {
+      dl.Merge (r->GetDelaySketch ());
+      total  += r->GetTotalFrames ();
+      onTime += r->GetOnTimeFrames ();
+      late   += r->GetLateFrames ();
+    }
+    for (const Ptr<VrUplinkReceiver> &u : m_uls)
+    {
+      ul.Merge (u->m_sketch);
+    }
+
+    std::ostringstream oss;
+    oss << "[LIVE] t=" << Simulator::Now ().GetSeconds ()
+        << " total=" << total
+        << " onTime=" << onTime
+        << " late=" << late
+        << " pending=" << (total - onTime - late)
+        << " ratio=" << (total ? (double) onTime / total : 0.0)
+        << " dl_p50=" << dl.GetQuantile (0.50)
+        << " dl_p99=" << dl.GetQuantile (0.99)
+        << " dl_max=" << dl.GetMax ()
+        << " ul_n=" << ul.GetCount ()
+        << " ul_avg=" << ul.GetMean ()
+        << " ul_p99=" << ul.GetQuantile (0.99)
+        << " ul_max=" << ul.GetMax ()
+        << " dlQ=" << QueuedPackets (m_devs.Get (0))
+        << " ulQ=" << QueuedPackets (m_devs.Get (1))
+        << " dropped=" << m_dropped
+        << "\n";
+
+    if (m_pending.size () < m_maxLines)
+      m_pending.push_back (oss.str ());
+    else
+      m_dropped += 1;
+
+    Flush ();
+    Simulator::Schedule (m_interval, &LiveReporter::Snapshot, this);
+  }
+
+  // device queue + root queue disc (Ipv4AddressHelper installs one by default)
+  static uint32_t QueuedPackets (Ptr<NetDevice> dev)
+  {
+    uint32_t n = 0;
+    Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice> (dev);
+    if (p2p && p2p->GetQueue ())
+      n += p2p->GetQueue ()->GetNPackets ();
+
+    Ptr<TrafficControlLayer> tc = dev->GetNode ()->GetObject<TrafficControlLayer> ();
+    if (tc && tc->GetRootQueueDiscOnDevice (dev))
+      n += tc->GetRootQueueDiscOnDevice (dev)->GetNPackets ();
+    return n;
+  }
+
+  // consumer went away: stop the live output, keep simulating
+  void DropSink ()
+  {
+    m_dropped += m_pending.size ();
+    m_pending.clear ();
+    m_offset = 0;
+    if (m_ownFd) close (m_fd);
+    m_fd = -1;
+    std::cerr << "[LIVE] sink disconnected, live output stopped, run continues" << std::endl;
+  }
+
+  void Flush ()
+  {
+    if (m_fd == STDOUT_FILENO) std::cout.flush ();
+
+    while (!m_pending.empty ())
+    {
+      const std::string &line = m_pending.front ();
+      // socket: MSG_NOSIGNAL, 消费者断开时返回 EPIPE 而不是 SIGPIPE 杀掉整个进程
+      ssize_t n = m_isSocket ? send (m_fd, line.data () + m_offset, line.size () - m_offset, MSG_NOSIGNAL)
+                             : write (m_fd, line.data () + m_offset, line.size () - m_offset);
+      if (n < 0)
+      {
+        if (errno == EINTR) continue;
+        if (errno == EPIPE || errno == ECONNRESET) DropSink ();
+        return;   // EAGAIN：下次快照再试；其他错误同样保留在队列里
+      }
+      m_offset += n;
+      if (m_offset < line.size ()) return;
+      m_pending.pop_front ();
+      m_offset = 0;
+    }
+  }
+
+  std::vector<VrSession *>           m_recvs;
+  std::vector<Ptr<VrUplinkReceiver>> m_uls;
+  NetDeviceContainer                 m_devs;
+  Time                  m_interval;
+
+  int      m_fd;
+  bool     m_ownFd;
+  bool     m_isSocket;     // unix: sink, send () with MSG_NOSIGNAL
+  uint32_t m_maxLines;
+  std::deque<std::string> m_pending;
+  size_t   m_offset;     // 队首这一行已经写出去的字节数
+  uint64_t m_dropped;
+};
+
+//
+// Emulation monitor (emulation.mode = tap): real host processes send through
+// the modeled bottleneck, the simulator runs on the realtime clock
+//   - frames are accounted by a passive VrReceiverApp; a frame is timed from
+//     its first fragment entering the server-side tap to the fragment that
+//     completes it leaving the headset-side tap (the host sender's clock is
+//     not the simulator's, so its sendTsMs is ignored)
+//   - an ingress entry is dropped once pktCount fragments have left the
+//     headset tap; an entry older than kFrameStaleMs is overwritten by the
+//     next fragment with that frameId (host sender restarted or the 32-bit
+//     frameId wrapped) and swept by Probe (fragments lost in the bottleneck)
+//   - the host sender must lead each UDP payload to dlPort with the 12 B
+//     VrHeader; other traffic is forwarded and only counted
+//   - lag: every `probe` the wall clock is compared with simulated time; a
+//     probe more than `maxLag` behind realtime is an event-deadline miss
+//
+class EmuMonitor
+{
+public:
+  EmuMonitor ()
+    : m_dlPort (0),
+      m_misses (0),
+      m_inPkts (0),
+      m_inBytes (0),
+      m_outPkts (0),
+      m_vrPkts (0)
+  {}
+
+  void Setup (Ptr<VrReceiverApp> recv, uint16_t dlPort, Time stop, Time probe, Time maxLag)
+  {
+    m_recv   = recv;
+    m_dlPort = dlPort;
+    m_stop   = stop;
+    m_probe  = probe;
+    m_maxLag = maxLag;
+  }
+
+  void Start ()
+  {
+    m_wallStart = std::chrono::steady_clock::now ();
+    m_simStart  = Simulator::Now ();
+    Simulator::Schedule (m_probe, &EmuMonitor::Probe, this);
+  }
+
+  // server tap MacRx: Ethernet frame from the host sender
+  void OnIngress (Ptr<const Packet> frame)
+  {
+    Ptr<Packet> p = frame->Copy ();
+    EthernetHeader eth (false);
+    p->RemoveHeader (eth);
+    if (eth.GetLengthType () != Ipv4L3Protocol::PROT_NUMBER) return;   // ARP
+
+    if (!m_inPkts) m_firstIn = Simulator::Now ();
+    m_lastIn   = Simulator::Now ();
+    m_inPkts  += 1;
+    m_inBytes += p->GetSize ();
+
+    VrHeader hdr;
+    if (PeekVrHeader (p, true, m_dlPort, hdr))
+    {
+      // 只记第一片进入瓶颈的时刻；过期的同号条目属于上一轮发送端，直接覆盖
+      uint32_t nowMs = Simulator::Now ().GetMilliSeconds ();
+      auto it = m_frameIn.find (hdr.GetFrameId ());
+      if (it == m_frameIn.end () || nowMs - it->second.ingressMs > kFrameStaleMs)
+        m_frameIn[hdr.GetFrameId ()] = FrameIn {nowMs, hdr.GetPktCount (), 0};
+    }
+  }
+
+  // headset tap MacTx: IPv4 packet on its way to the host receiver
+  void OnEgress (Ptr<const Packet> p)
+  {
+    m_outPkts += 1;
+    VrHeader hdr;
+    if (Simulator::Now () >= m_stop || !PeekVrHeader (p, true, m_dlPort, hdr)) return;
+    auto it = m_frameIn.find (hdr.GetFrameId ());
+    if (it == m_frameIn.end ()) return;
+    m_vrPkts += 1;
+    hdr.SetSendTsMs (it->second.ingressMs);
+    m_recv->Observe (hdr);
+    if (++it->second.outPkts >= it->second.pktCount) m_frameIn.erase (it);
+  }
+
+  uint64_t GetProbes () const { return m_lagsUs.size (); }
+  uint64_t GetMisses () const { return m_misses; }
+  int64_t GetLagUs (double q) const
+  {
+    if (m_lagsUs.empty ()) return 0;
+    std::vector<int64_t> sorted = m_lagsUs;
+    std::sort (sorted.begin (), sorted.end ());
+    return sorted[std::min<size_t> (sorted.size () * q, sorted.size () - 1)];
+  }
+  uint64_t GetInPkts () const { return m_inPkts; }
+  uint64_t GetOutPkts () const { return m_outPkts; }
+  uint64_t GetVrPkts () const { return m_vrPkts; }
+  double GetInMbps () const
+  {
+    double s = (m_lastIn - m_firstIn).GetSeconds ();
+    return s > 0 ? m_inBytes * 8.0 / s / 1e6 : 0.0;
+  }
+
+private:
+  void Probe ()
+  {
+    int64_t wallUs = std::chrono::duration_cast<std::chrono::microseconds> (
+                       std::chrono::steady_clock::now () - m_wallStart).count ();
+    int64_t lagUs  = std::max<int64_t> (wallUs - (Simulator::Now () - m_simStart).GetMicroSeconds (), 0);
+    m_lagsUs.push_back (lagUs);
+    if (lagUs > m_maxLag.GetMicroSeconds ()) m_misses += 1;
+
+    // 瓶颈里丢了片的帧永远凑不齐，按龄清掉
+    uint32_t nowMs = Simulator::Now ().GetMilliSeconds ();
+    for (auto it = m_frameIn.begin (); it != m_frameIn.end (); )
+      it = nowMs - it->second.ingressMs > kFrameStaleMs ? m_frameIn.erase (it) : std::next (it);
+    Simulator::Schedule (m_probe, &EmuMonitor::Probe, this);
+  }
+
+  Ptr<VrReceiverApp> m_recv;
+  uint16_t m_dlPort;
+  Time     m_stop;
+  Time     m_probe;
+  Time     m_maxLag;
+
+  std::chrono::steady_clock::time_point m_wallStart;
+  Time     m_simStart;
+  std::vector<int64_t> m_lagsUs;
+  uint64_t m_misses;
+
+  static constexpr uint32_t kFrameStaleMs = 1000;
+
+  struct FrameIn
+  {
+    uint32_t ingressMs;   // first fragment into the server tap
+    uint16_t pktCount;
+    uint16_t outPkts;     // fragments out of the headset tap so far
+  };
+  std::map<uint32_t, FrameIn> m_frameIn;   // frameId -> in-flight frame
+  Time     m_firstIn;
+  Time     m_lastIn;
+  uint64_t m_inPkts;
+  uint64_t m_inBytes;
+  uint64_t m_outPkts;
+  uint64_t m_vrPkts;
+};
+
+//
+// pcap capture on the bottleneck devices (pcap.mode)
+//   - both ends' PromiscSniffer (tx and rx, PPP framing), one file per device
+//   - header-only: records are cut to `snaplen` bytes when seen (PPP + IPv4 +
+//     UDP + VrHeader = 42 B for udp/quic), the original length is kept
+//   - all: continuous capture, <prefix>-<dev>.pcap
+//   - ring: the last `pre` of records stay in memory. A VR frame that has not
+//     fully arrived at the headset end `deadline` after it left the server
+//     (late or incomplete) triggers a capture: the held window plus the next
+//     `post` go to <prefix>-<n>-<dev>.pcap. A trigger while a capture is open
+//     extends it; only the newest `files` captures are kept on disk
+//
+class PcapRing
+{
+public:
+  PcapRing ()
+    : m_ring (false),
+      m_snaplen (42),
+      m_deadlineMs (50),
+      m_dlPort (5000),
+      m_maxFiles (8),
+      m_open (false),
+      m_triggers (0),
+      m_captures (0),
+      m_records (0),
+      m_bytes (0)
+  {}
+
+  void Setup (bool ring, const std::string &prefix, uint32_t snaplen,
+              Time pre, Time post, uint32_t files, uint32_t deadlineMs, uint16_t dlPort)
+  {
+    m_ring       = ring;
+    m_prefix     = prefix;
+    m_snaplen    = snaplen;
+    m_pre        = pre;
+    m_post       = post;
+    m_maxFiles   = std::max<uint32_t> (files, 1);
+    m_deadlineMs = deadlineMs;
+    m_dlPort     = dlPort;
+    if (!m_ring) Open (m_prefix + "-0.pcap", m_prefix + "-1.pcap");
+  }
+
+  void OnServer (Ptr<const Packet> p)  { OnPacket (0, p); }
+  void OnHeadset (Ptr<const Packet> p) { OnPacket (1, p); }
+
+  void Stop ()
+  {
+    if (m_open) Close ();
+  }
+
+  uint64_t GetTriggers () const { return m_triggers; }
+  uint64_t GetCaptures () const { return m_captures; }
+  uint64_t GetKept () const { return m_kept.size (); }
+  uint64_t GetRecords () const { return m_records; }
+  uint64_t GetBytes () const { return m_bytes; }
+
+private:
+  struct Record
+  {
+    Time     t;
+    uint32_t len;                 // original length
+    std::vector<uint8_t> data;    // first snaplen bytes
+  };
+
+  struct FrameSeen
+  {
+    uint16_t pktCount = 0;
+    uint16_t arrived  = 0;
+  };
+
+  void OnPacket (uint32_t dev, Ptr<const Packet> p)
+  {
+    Record r;
+    r.t   = Simulator::Now ();
+    r.len = p->GetSize ();
+    r.data.resize (std::min (r.len, m_snaplen));
+    p->CopyData (r.data.data (), r.data.size ());
+
+    if (m_open) Write (dev, r);
+    if (!m_ring) return;
+
+    std::deque<Record> &held = m_held[dev];
+    held.push_back (std::move (r));
+    while (held.front ().t < Simulator::Now () - m_pre) held.pop_front ();
+
+    // 只有下行 VR fragment 参与触发：服务器端看发出，headset 端看到达
+    Ptr<Packet> c = p->Copy ();
+    PppHeader ppp;
+    Ipv4Header ip;
+    if (c->RemoveHeader (ppp) == 0 || c->RemoveHeader (ip) == 0) return;
+    VrHeader vr;
+    if (!PeekVrHeader (c, false, m_dlPort, vr)) return;
+
+    std::pair<uint32_t, uint32_t> key (ip.GetDestination ().Get (), vr.GetFrameId ());
+    if (dev == 0)
+    {
+      if (m_frames.count (key)) return;
+      m_frames[key].pktCount = vr.GetPktCount ();
+      int64_t dueMs = (int64_t) vr.GetSendTsMs () + m_deadlineMs;
+      Time due = std::max (MilliSeconds (dueMs) - Simulator::Now (), Seconds (0));
+      Simulator::Schedule (due, &PcapRing::Check, this, key);
+    }
+    else
+    {
+      auto it = m_frames.find (key);
+      if (it != m_frames.end ()) it->second.arrived += 1;
+    }
+  }
+
+  void Check (std::pair<uint32_t, uint32_t> key)
+  {
+    // 条目留着：同一帧迟到的 fragment 不会再触发一次
+    const FrameSeen &f = m_frames[key];
+    if (f.arrived >= f.pktCount) return;
+
+    m_triggers += 1;
+    if (m_open)
+    {
+      m_until = std::max (m_until, Simulator::Now () + m_post);
+      return;
+    }
+
+    std::ostringstream base;
+    base << m_prefix << "-" << m_captures;
+    m_kept.push_back ({base.str () + "-0.pcap", base.str () + "-1.pcap"});
+    m_captures += 1;
+    // 文件环：超过 files 个 capture 就删掉最老的
+    while (m_kept.size () > m_maxFiles)
+    {
+      std::remove (m_kept.front ().first.c_str ());
+      std::remove (m_kept.front ().second.c_str ());
+      m_kept.pop_front ();
+    }
+
+    Open (m_kept.back ().first, m_kept.back ().second);
+    for (uint32_t dev = 0; dev < 2; ++dev)
+    {
+      for (const Record &r : m_held[dev]) Write (dev, r);
+    }
+    m_until = Simulator::Now () + m_post;
+    Simulator::Schedule (m_post, &PcapRing::MaybeClose, this);
+  }
+
+  void MaybeClose ()
+  {
+    if (!m_open) return;
+    if (Simulator::Now () < m_until)
+    {
+      Simulator::Schedule (m_until - Simulator::Now (), &PcapRing::MaybeClose, this);
+      return;
+    }
+    Close ();
+  }
+
+  void Open (const std::string &a, const std::string &b)
+  {
+    const std::string *names[2] = {&a, &b};
+    for (uint32_t dev = 0; dev < 2; ++dev)
+    {
+      m_file[dev].Open (*names[dev], std::ios::out);
+      if (m_file[dev].Fail ())
+      {
+        NS_FATAL_ERROR ("Cannot write pcap " << *names[dev]);
+      }
+      m_file[dev].Init (PcapHelper::DLT_PPP, m_snaplen);
+    }
+    m_open = true;
+  }
+
+  void Close ()
+  {
+    for (uint32_t dev = 0; dev < 2; ++dev) m_file[dev].Close ();
+    m_open = false;
+  }
+
+  void Write (uint32_t dev, const Record &r)
+  {
+    int64_t us = r.t.GetMicroSeconds ();
+    m_file[dev].Write (us / 1000000, us % 1000000, r.data.data (), r.len);
+    m_records += 1;
+    m_bytes   += 16 + r.data.size ();   // pcap record header + captured bytes
+  }
+
+  bool        m_ring;
+  std::string m_prefix;
+  uint32_t    m_snaplen;
+  Time        m_pre;
+  Time        m_post;
+  uint32_t    m_deadlineMs;
+  uint16_t    m_dlPort;
+  uint32_t    m_maxFiles;
+
+  std::deque<Record> m_held[2];
+  std::map<std::pair<uint32_t, uint32_t>, FrameSeen> m_frames;   // (dst, frameId)
+
+  PcapFile m_file[2];
+  bool     m_open;
+  Time     m_until;
+  std::deque<std::pair<std::string, std::string>> m_kept;
+
+  uint64_t m_triggers;
+  uint64_t m_captures;
+  uint64_t m_records;
+  uint64_t m_bytes;
+};
+
+//
+// Calendar-queue event scheduler for periodic AR/VR event patterns (--scheduler)
+//   - ring of 2^k buckets, fixed width (default 20us, below one 1200 B
+//     serialization at 100 Mbps): bucket i holds events of exactly one
+//     width-slot of the current "year" [base, base + buckets x width)
+//   - the year (default 2048 x 20us ~ 41ms) covers a frame period, the
+//     uplink period and the bottleneck delay, so nearly every insert is an
+//     O(1) append at a bucket tail; events beyond the year wait in a
+//     sorted overflow map and move into the ring as the window advances
+//   - no resizing and no width re-sampling (ns3::CalendarScheduler does both
+//     on bursts, which frame-sized packet trains trigger every frame)
+//   - order within a bucket is (ts, uid) like every ns-3 scheduler, so runs
+//     are event-for-event identical to map/heap/list
+//
+class VrCalendarScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::VrCalendarScheduler")
+      .SetParent<Scheduler> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<VrCalendarScheduler> ()
+      .AddAttribute ("BucketWidth", "Time covered by one bucket",
+                     TimeValue (MicroSeconds (20)),
+                     MakeTimeAccessor (&VrCalendarScheduler::m_widthTime),
+                     MakeTimeChecker ())
+      .AddAttribute ("Buckets", "Buckets in the ring, rounded up to a power of two",
+                     UintegerValue (2048),
+                     MakeUintegerAccessor (&VrCalendarScheduler::m_nBuckets),
+                     MakeUintegerChecker<uint32_t> ());
+    return tid;
+  }
+
+  VrCalendarScheduler ()
+    : m_width (1), m_mask (0), m_year (0),
+      m_base (0), m_cur (0), m_near (0)
+  {
+  }
+
+  virtual void Insert (const Event &ev) override
+  {
+    if (m_buckets.empty ()) Configure ();
+    // PeekNext 可能已把窗口推过了 now；往回插的事件先把窗口退回来
+    if (ev.key.m_ts < m_base) Rewind (ev.key.m_ts);
+    if (ev.key.m_ts < m_base + m_year) AddNear (ev);
+    else m_far.emplace (ev.key, ev.impl);
+  }
+
+  virtual bool IsEmpty (void) const override
+  {
+    return m_near == 0 && m_far.empty ();
+  }
+
+  virtual Event PeekNext (void) const override
+  {
+    if (m_near == 0) return FarFront ();
+    Seek ();
+    const Event &ev = m_buckets[m_cur].front ();
+    // 窗口前移后还没搬进环的远期事件可能更早
+    if (!m_far.empty () && m_far.begin ()->first < ev.key) return FarFront ();
+    return ev;
+  }
+
+  virtual Event RemoveNext (void) override
+  {
+    if (m_near == 0) JumpTo (m_far.begin ()->first.m_ts);
+    else Seek ();
+    Migrate ();
+    Event ev = m_buckets[m_cur].front ();
+    m_buckets[m_cur].pop_front ();
+    m_near -= 1;
+    return ev;
+  }
+
+  virtual void Remove (const Event &ev) override
+  {
+    auto f = m_far.find (ev.key);
+    if (f != m_far.end ())
+    {
+      m_far.erase (f);
+      return;
+    }
+    std::deque<Event> &b = m_buckets[Slot (ev.key.m_ts)];
+    auto it = std::lower_bound (b.begin (), b.end (), ev);
+    NS_ASSERT (it != b.end () && it->key.m_uid == ev.key.m_uid);
+    b.erase (it);
+    m_near -= 1;
+  }
+
+private:
+  // ring from the attributes, on the first insert
+  void Configure (void)
+  {
+    uint32_t n = 1;
+    while (n < m_nBuckets) n <<= 1;
+    m_width = std::max<int64_t> (m_widthTime.GetTimeStep (), 1);
+    m_mask  = n - 1;
+    m_year  = m_width * n;
+    m_buckets.assign (n, std::deque<Event> ());
+  }
+
+  uint32_t Slot (uint64_t ts) const
+  {
+    return (ts / m_width) & m_mask;
+  }
+
+  Event FarFront (void) const
+  {
+    Event ev;
+    ev.key  = m_far.begin ()->first;
+    ev.impl = m_far.begin ()->second;
+    return ev;
+  }
+
+  void AddNear (const Event &ev)
+  {
+    std::deque<Event> &b = m_buckets[Slot (ev.key.m_ts)];
+    // 周期性事件几乎总是按时间顺序到达，直接追加
+    if (b.empty () || b.back () < ev) b.push_back (ev);
+    else b.insert (std::upper_bound (b.begin (), b.end (), ev), ev);
+    m_near += 1;
+  }
+
+  // skip empty buckets; needs m_near > 0, stops within one year
+  void Seek (void) const
+  {
+    while (m_buckets[m_cur].empty ())
+    {
+      m_cur   = (m_cur + 1) & m_mask;
+      m_base += m_width;
+    }
+  }
+
+  // ring is empty: restart the window at ts
+  void JumpTo (uint64_t ts)
+  {
+    m_base = ts - ts % m_width;
+    m_cur  = Slot (ts);
+  }
+
+  // overflow events the advanced window now covers
+  void Migrate (void)
+  {
+    while (!m_far.empty () && m_far.begin ()->first.m_ts < m_base + m_year)
+    {
+      Event ev;
+      ev.key  = m_far.begin ()->first;
+      ev.impl = m_far.begin ()->second;
+      m_far.erase (m_far.begin ());
+      AddNear (ev);
+    }
+  }
+
+  // move the window back to ts; the slots it re-uses at the front held the
+  // tail of the old year, which now lies beyond the window
+  void Rewind (uint64_t ts)
+  {
+    uint64_t base = ts - ts % m_width;
+    uint64_t back = std::min<uint64_t> ((m_base - base) / m_width, m_mask + 1);
+    for (uint64_t j = 1; j <= back; ++j)
+    {
+      std::deque<Event> &b = m_buckets[(m_cur - j) & m_mask];
+      for (const Event &ev : b) m_far.emplace (ev.key, ev.impl);
+      m_near -= b.size ();
+      b.clear ();
+    }
+    m_base = base;
+    m_cur  = Slot (ts);
+  }
+
+  Time     m_widthTime;
+  uint32_t m_nBuckets;
+  uint64_t m_width;      // time steps per bucket
+  uint32_t m_mask;
+  uint64_t m_year;
+  std::vector<std::deque<Event>> m_buckets;
+  std::map<EventKey, EventImpl *> m_far;
+  mutable uint64_t m_base;   // start of the bucket at m_cur
+  mutable uint32_t m_cur;
+  uint64_t m_near;       // events in the ring
+};
+
+//
+// Scenario description: everything main() used to hard-code
+//   - the defaults below reproduce the original 2-node setup exactly
+//   - precedence: defaults < --scenario file < named flags < --set
+//   - users > 1 builds a star behind the bottleneck: server -- ap -- headset_i
+//
+struct UserSpec
+{
+  uint32_t    frameSize;
+  std::string accessRate;
+  std::string accessDelay;
+  Time        start;
+  double      distance;      // wifi: metres from the AP
+};
+
+struct Scenario
+{
+  // transport
+  std::string transport       = "udp";
+  std::string tcpType         = "cubic";   // or "bbr"
+  Time        pacingInterval  = MicroSeconds (200);
+  bool        batch           = false;    // udp/quic: VrBatchSender instead of socket sends
+  uint32_t    gso             = 0;        // udp/quic: fragments per GSO super-packet, 0 = off
+  bool        gro             = false;    // udp/quic: GRO on the headsets
+  Time        groFlush        = MicroSeconds (50);
+
+  // bottleneck link (server side)
+  std::string bottleneckRate  = "100Mbps";
+  std::string bottleneckDelay = "10ms";
+  std::string queueSize       = "100p";
+  std::string qdisc           = "default";  // default / droptail / edf / prio
+  double      loss            = 0.0;
+
+  // per-headset access hop, only built when users > 1
+  uint32_t    users           = 1;
+  uint32_t    sessions        = 1;        // VR sessions per headset node (> 1: VrSessionHeader + demux)
+  std::string accessMode      = "p2p";    // p2p: one link per headset; air: shared AP medium;
+                                          // wifi: 802.11ax; cell: abstract cellular
+  std::string accessRate      = "1Gbps";  // air: per-station PHY rate
+  std::string accessDelay     = "1ms";
+  std::string apScheduler     = "fifo";   // air: fifo / rr / airtime / edf
+  uint32_t    apQueue         = 100;      // air: packets per station queue
+  Time        apQuantum       = MicroSeconds (500);   // air: airtime DRR quantum
+  Time        airOverhead     = MicroSeconds (0);     // air: per-transmission PHY/MAC overhead
+
+  // access.mode = wifi: 802.11ax AP + one station per headset
+  int32_t     wifiMcs         = -1;       // -1: IdealWifiManager, 0..11: fixed HeMcs
+  uint32_t    wifiWidth       = 80;       // MHz: 20 / 40 / 80 / 160
+  uint32_t    wifiNss         = 1;        // spatial streams (= antennas)
+  double      wifiDistance    = 5.0;      // m, default for every headset
+  double      wifiExponent    = 3.0;      // log-distance path loss exponent
+  bool        wifiFast        = false;    // cheaper PHY, see InstallWifiLastHop
+
+  // access.mode = cell: abstract TTI-slotted cellular hop (CellChannel)
+  Time        cellTti         = MicroSeconds (500);   // NR 30 kHz slot
+  std::string cellDlRate      = "200Mbps";            // constant capacity when no trace
+  std::string cellUlRate      = "50Mbps";
+  std::string cellTrace;                              // "<dl Mbps> <ul Mbps>" per TTI
+  Time        cellSrPeriod    = MilliSeconds (5);     // SR opportunity period
+  Time        cellGrantDelay  = MilliSeconds (2);     // SR -> first UL grant
+  Time        cellHarqRtt     = MilliSeconds (2);
+  double      cellBler        = 0.1;                  // per transmission
+  uint32_t    cellHarqMax     = 4;                    // transmissions per block
+  bool        cellConfiguredGrant = false;            // true: UL never waits for a grant
+
+  // headset-link outages (handover / roaming), see OutageProcess
+  std::string outageMode      = "off";    // off / scheduled / poisson
+  std::string outageAt;                   // scheduled: "3s,7.5s"
+  Time        outageInterval  = Seconds (5);          // poisson: mean gap between outages
+  Time        outageDuration  = MilliSeconds (100);   // mean outage length
+  std::string outageDist      = "fixed";  // fixed / exp / uniform
+  std::string outagePolicy    = "buffer"; // buffer / drop
+  std::string outageUsers     = "all";    // or "0,2"
+
+  // background load on the bottleneck downlink, see FluidBgQueueDisc
+  std::string bgMode          = "off";    // off / fluid / packet (UDP on/off apps)
+  std::string bgRate          = "50Mbps"; // mean offered load
+  uint32_t    bgFlows         = 10;
+  Time        bgOn            = MilliSeconds (100);   // mean on period (exponential)
+  Time        bgOff           = MilliSeconds (100);   // mean off period, 0 = constant rate
+  uint32_t    bgPktSize       = 1472;     // packet mode: UDP payload
+  uint16_t    bgPort          = 9000;
+
+  // traffic sources
+  uint32_t    frameSize       = 90000;
+  Time        frameInterval   = MilliSeconds (33);
+  uint32_t    pktSize         = 1200;
+  uint16_t    dlPort          = 5000;
+  Time        ulInterval      = MilliSeconds (10);   // 100 Hz
+  uint32_t    ulPktSize       = 100;
+  uint16_t    ulPort          = 6000;                // user i -> ulPort + i
+
+  // sender encoder model, see VrDownlinkApp::SetEncoder
+  bool        encoder         = false;
+  std::string encoderDist     = "fixed";  // fixed / uniform / normal
+  Time        encoderMean     = MilliSeconds (8);
+  Time        encoderJitter   = MilliSeconds (2);     // uniform: +-, normal: stddev
+  uint32_t    encoderSlices   = 1;        // > 1: fragments leave slice by slice
+
+  // render -> encode -> send pipeline, see VrDownlinkApp::SetPipeline
+  bool        pipeline        = false;
+  std::string renderDist      = "fixed";  // fixed / uniform / normal
+  Time        renderMean      = MilliSeconds (5);
+  Time        renderJitter    = MilliSeconds (1);
+  uint32_t    renderQueue     = 2;        // frames, render -> encode (GPU frame queue)
+  uint32_t    sendQueue       = 2;        // frames, encode -> send
+  std::string pipelineFull    = "block";  // block (back-pressure) / drop (oldest frame)
+
+  // receiver playout buffer, see PlayoutBuffer
+  std::string playoutMode     = "off";    // off / fixed / percentile / kalman
+  std::string playoutPolicy   = "skip";   // skip (freeze, VR style) / stall (rebuffer)
+  Time        playoutTarget   = MilliSeconds (50);    // fixed target; initial target otherwise
+  double      playoutPercentile = 0.95;
+  uint32_t    playoutWindow   = 64;       // frames in the percentile window
+  double      playoutK        = 3.0;      // kalman: mean + k * stddev
+  Time        playoutMin      = MilliSeconds (0);
+  Time        playoutMax      = MilliSeconds (500);
+  Time        playoutStep     = MilliSeconds (1);     // max offset change per displayed frame
+
+  // quality proxy, see QualityModel
+  bool        quality         = false;
+  std::string qualityCurve    = "5:40,10:60,20:75,40:88,80:95";   // Mbps:score
+  uint32_t    qualityLayers   = 1;        // 1 = the whole frame or nothing
+  double      qualityFreeze   = 20;       // score of a frozen slot
+
+  // DSCP marks: "off", "on" (video AF41, IMU EF, ACK CS6) or "video,imu,ack"
+  std::string dscp            = "off";
+
+  Time        appStart        = Seconds (1.0);
+  Time        appStop         = Seconds (10.0);
+  Time        simStop         = Seconds (20.0);
+
+  // metrics / output
+  uint32_t    deadlineMs      = 50;
+  std::string deadlineList;               // e.g. "20,33,50,80,100"
+  std::string outDir          = ".";
+  double      liveInterval    = 0.0;      // 0 = off
+  std::string liveOut         = "stdout";
+  uint32_t    liveBuffer      = 1024;
+  std::string frameTrace;                 // per-frame CSV, "" = off
+
+  // fork-from-warm-state
+  double      forkAt          = 0.0;      // 0 = off
+
+  // packet simulation or the analytic fast path, see RunFluidModel
+  std::string model           = "packet"; // packet / fluid / auto
+  uint32_t    modelMargin     = 5;        // auto: ms around a deadline that need packets
+  // realtime emulation with host processes, see EmuMonitor
+  std::string emuMode         = "off";    // off / tap
+  std::string emuServerTap    = "arvr-srv";
+  std::string emuHeadsetTap   = "arvr-hs";
+  Time        emuProbe        = MilliSeconds (1);     // lag probe period
+  Time        emuMaxLag       = MilliSeconds (1);     // probe later than this = deadline miss
+  // header-only pcap on the bottleneck, see PcapRing
+  std::string pcapMode        = "off";    // off / all / ring
+  uint32_t    pcapSnaplen     = 0;        // 0 = headers only (42 B udp/quic, 46 B with sessions, 82 B tcp)
+  Time        pcapPre         = MilliSeconds (500);   // ring: kept before a trigger
+  Time        pcapPost        = MilliSeconds (500);   // ring: written after it
+  uint32_t    pcapFiles       = 8;        // ring: captures kept on disk
+  std::string pcapPrefix;                 // empty = <outDir>/arvr-pcap
+  // event scheduler, see VrCalendarScheduler; no effect on results
+  std::string scheduler       = "map";    // map / heap / list / calendar / ns3-calendar / auto
+  Time        schedWidth      = MicroSeconds (20);    // calendar: bucket width
+  uint32_t    schedBuckets    = 2048;     // calendar: rounded up to a power of two
+  std::string schedTable;                 // auto: sched-bench.sh table, empty = built-in rule
+  std::string forkParam       = "loss";
+  std::string forkValues;
+  uint32_t    forkJobs        = 0;        // 0 = one per core
+
+  // [[user]] tables, applied on top of the defaults above
+  std::vector<std::map<std::string, std::string>> userOverrides;
+};
+
+// 端口先按 unsigned long 读，超过 65535 直接报错，不要静默截断成 uint16_t
+static uint16_t
+ScenarioPort (const std::string &v)
+{
+  unsigned long p = std::stoul (v);
+  if (p > 65535) throw std::out_of_range ("port " + v);
+  return (uint16_t) p;
+}
+
+// "section.key" -> field; false = unknown key
+static bool
+SetScenarioValue (Scenario &sc, const std::string &key, const std::string &v)
+{
+  if      (key == "transport.type")       sc.transport       = v;
+  else if (key == "transport.tcp")        sc.tcpType         = v;
+  else if (key == "transport.pacing")     sc.pacingInterval  = Time (v);
+  else if (key == "transport.batch")      sc.batch           = (v == "true" || v == "1");
+  else if (key == "transport.gso")        sc.gso             = std::stoul (v);
+  else if (key == "transport.gro")        sc.gro             = (v == "true" || v == "1");
+  else if (key == "transport.groFlush")   sc.groFlush        = Time (v);
+  else if (key == "link.rate")            sc.bottleneckRate  = v;
+  else if (key == "link.delay")           sc.bottleneckDelay = v;
+  else if (key == "link.queue")           sc.queueSize       = v;
+  else if (key == "link.qdisc")           sc.qdisc           = v;
+  else if (key == "qos.dscp")             sc.dscp            = v;
+  else if (key == "link.loss")            sc.loss            = std::stod (v);
+  else if (key == "users.count")          sc.users           = std::stoul (v);
+  else if (key == "users.sessions")       sc.sessions        = std::stoul (v);
+  else if (key == "access.rate")          sc.accessRate      = v;
+  else if (key == "access.delay")         sc.accessDelay     = v;
+  else if (key == "access.mode")          sc.accessMode      = v;
+  else if (key == "access.scheduler")     sc.apScheduler     = v;
+  else if (key == "access.queue")         sc.apQueue         = std::stoul (v);
+  else if (key == "access.quantum")       sc.apQuantum       = Time (v);
+  else if (key == "access.overhead")      sc.airOverhead     = Time (v);
+  else if (key == "wifi.mcs")             sc.wifiMcs         = std::stoi (v);
+  else if (key == "wifi.width")           sc.wifiWidth       = std::stoul (v);
+  else if (key == "wifi.nss")             sc.wifiNss         = std::stoul (v);
+  else if (key == "wifi.distance")        sc.wifiDistance    = std::stod (v);
+  else if (key == "wifi.exponent")        sc.wifiExponent    = std::stod (v);
+  else if (key == "wifi.fast")            sc.wifiFast        = (v == "true" || v == "1");
+  else if (key == "cell.tti")             sc.cellTti         = Time (v);
+  else if (key == "cell.dlRate")          sc.cellDlRate      = v;
+  else if (key == "cell.ulRate")          sc.cellUlRate      = v;
+  else if (key == "cell.trace")           sc.cellTrace       = v;
+  else if (key == "cell.srPeriod")        sc.cellSrPeriod    = Time (v);
+  else if (key == "cell.grantDelay")      sc.cellGrantDelay  = Time (v);
+  else if (key == "cell.harqRtt")         sc.cellHarqRtt     = Time (v);
+  else if (key == "cell.bler")            sc.cellBler        = std::stod (v);
+  else if (key == "cell.harqMax")         sc.cellHarqMax     = std::stoul (v);
+  else if (key == "cell.configuredGrant") sc.cellConfiguredGrant = (v == "true" || v == "1");
+  else if (key == "outage.mode")          sc.outageMode      = v;
+  else if (key == "outage.at")            sc.outageAt        = v;
+  else if (key == "outage.interval")      sc.outageInterval  = Time (v);
+  else if (key == "outage.duration")      sc.outageDuration  = Time (v);
+  else if (key == "outage.dist")          sc.outageDist      = v;
+  else if (key == "outage.policy")        sc.outagePolicy    = v;
+  else if (key == "outage.users")         sc.outageUsers     = v;
+  else if (key == "encoder.enabled")      sc.encoder         = (v == "true" || v == "1");
+  else if (key == "encoder.dist")         sc.encoderDist     = v;
+  else if (key == "encoder.mean")         sc.encoderMean     = Time (v);
+  else if (key == "encoder.jitter")       sc.encoderJitter   = Time (v);
+  else if (key == "encoder.slices")       sc.encoderSlices   = std::stoul (v);
+  else if (key == "pipeline.enabled")     sc.pipeline        = (v == "true" || v == "1");
+  else if (key == "pipeline.renderDist")  sc.renderDist      = v;
+  else if (key == "pipeline.renderMean")  sc.renderMean      = Time (v);
+  else if (key == "pipeline.renderJitter") sc.renderJitter   = Time (v);
+  else if (key == "pipeline.renderQueue") sc.renderQueue     = std::stoul (v);
+  else if (key == "pipeline.sendQueue")   sc.sendQueue       = std::stoul (v);
+  else if (key == "pipeline.full")        sc.pipelineFull    = v;
+  else if (key == "playout.mode")         sc.playoutMode     = v;
+  else if (key == "playout.policy")       sc.playoutPolicy   = v;
+  else if (key == "playout.target")       sc.playoutTarget   = Time (v);
+  else if (key == "playout.percentile")   sc.playoutPercentile = std::stod (v);
+  else if (key == "playout.window")       sc.playoutWindow   = std::stoul (v);
+  else if (key == "playout.k")            sc.playoutK        = std::stod (v);
+  else if (key == "playout.min")          sc.playoutMin      = Time (v);
+  else if (key == "playout.max")          sc.playoutMax      = Time (v);
+  else if (key == "playout.step")         sc.playoutStep     = Time (v);
+  else if (key == "quality.enabled")      sc.quality         = (v == "true" || v == "1");
+  else if (key == "quality.curve")        sc.qualityCurve    = v;
+  else if (key == "quality.layers")       sc.qualityLayers   = std::stoul (v);
+  else if (key == "quality.freeze")       sc.qualityFreeze   = std::stod (v);
+  else if (key == "downlink.frameSize")   sc.frameSize       = std::stoul (v);
+  else if (key == "downlink.interval")    sc.frameInterval   = Time (v);
+  else if (key == "downlink.pktSize")     sc.pktSize         = std::stoul (v);
+  else if (key == "downlink.port")        sc.dlPort          = ScenarioPort (v);
+  else if (key == "uplink.interval")      sc.ulInterval      = Time (v);
+  else if (key == "uplink.pktSize")       sc.ulPktSize       = std::stoul (v);
+  else if (key == "uplink.port")          sc.ulPort          = ScenarioPort (v);
+  else if (key == "time.start")           sc.appStart        = Time (v);
+  else if (key == "time.stop")            sc.appStop         = Time (v);
+  else if (key == "time.end")             sc.simStop         = Time (v);
+  else if (key == "metrics.deadline")     sc.deadlineMs      = std::stoul (v);
+  else if (key == "metrics.deadlines")    sc.deadlineList    = v;
+  else if (key == "metrics.outDir")       sc.outDir          = v;
+  else if (key == "metrics.liveInterval") sc.liveInterval    = std::stod (v);
+  else if (key == "metrics.liveOut")      sc.liveOut         = v;
+  else if (key == "metrics.liveBuffer")   sc.liveBuffer      = std::stoul (v);
+  else if (key == "metrics.frameTrace")   sc.frameTrace      = v;
+  else if (key == "background.mode")      sc.bgMode          = v;
+  else if (key == "background.rate")      sc.bgRate          = v;
+  else if (key == "background.flows")     sc.bgFlows         = std::stoul (v);
+  else if (key == "background.on")        sc.bgOn            = Time (v);
+  else if (key == "background.off")       sc.bgOff           = Time (v);
+  else if (key == "background.pktSize")   sc.bgPktSize       = std::stoul (v);
+  else if (key == "background.port")      sc.bgPort          = ScenarioPort (v);
+  else if (key == "model.mode")           sc.model           = v;
+  else if (key == "model.margin")         sc.modelMargin     = std::stoul (v);
+  else if (key == "emulation.mode")       sc.emuMode         = v;
+  else if (key == "emulation.serverTap")  sc.emuServerTap    = v;
+  else if (key == "emulation.headsetTap") sc.emuHeadsetTap   = v;
+  else if (key == "emulation.probe")      sc.emuProbe        = Time (v);
+  else if (key == "emulation.maxLag")     sc.emuMaxLag       = Time (v);
+  else if (key == "pcap.mode")            sc.pcapMode        = v;
+  else if (key == "pcap.snaplen")         sc.pcapSnaplen     = std::stoul (v);
+  else if (key == "pcap.pre")             sc.pcapPre         = Time (v);
+  else if (key == "pcap.post")            sc.pcapPost        = Time (v);
+  else if (key == "pcap.files")           sc.pcapFiles       = std::stoul (v);
+  else if (key == "pcap.prefix")          sc.pcapPrefix      = v;
+  else if (key == "scheduler.type")       sc.scheduler       = v;
+  else if (key == "scheduler.width")      sc.schedWidth      = Time (v);
+  else if (key == "scheduler.buckets")    sc.schedBuckets    = std::stoul (v);
+  else if (key == "scheduler.table")      sc.schedTable      = v;
+  else return false;
+  return true;
+}
+
+static bool
+IsUserKey (const std::string &key)
+{
+  return key == "frameSize" || key == "rate" || key == "delay" || key == "start"
+         || key == "distance";
+}
+
+static std::string
+TrimScenario (const std::string &s)
+{
+  size_t b = s.find_first_not_of (" \t\r");
+  if (b == std::string::npos) return std::string ();
+  size_t e = s.find_last_not_of (" \t\r");
+  return s.substr (b, e - b + 1);
+}
+
+//
+// TOML subset, one forward pass (linear in the file size):
+//   # comment
+//   [section]
+//   key = value          # bare, "quoted" or 'quoted'
+//   [[user]]             # repeated table, one per headset
+//
+static void
+LoadScenarioFile (const std::string &path, Scenario &sc)
+{
+  std::ifstream in (path);
+  if (!in)
+  {
+    NS_FATAL_ERROR ("Cannot open scenario " << path);
+  }
+
+  std::string line;
+  std::string section;
+  bool        inUser = false;
+  uint32_t    lineNo = 0;
+
+  while (std::getline (in, line))
+  {
+    ++lineNo;
+
+    // 去掉引号外的注释
+    char quote = 0;
+    for (size_t i = 0; i < line.size (); ++i)
+    {
+      char c = line[i];
+      if (quote)
+      {
+        if (c == quote) quote = 0;
+      }
+      else if (c == '"' || c == '\'')
+      {
+        quote = c;
+      }
+      else if (c == '#')
+      {
+        line.resize (i);
+        break;
+      }
+    }
+    line = TrimScenario (line);
+    if (line.empty ()) continue;
+
+    if (line[0] == '[')
+    {
+      bool array = line.compare (0, 2, "[[") == 0;
+      size_t open = array ? 2 : 1;
+      size_t close = line.find (']', open);
+      if (close == std::string::npos)
+      {
+        NS_FATAL_ERROR (path << ":" << lineNo << ": unterminated section header");
+      }
+      section = TrimScenario (line.substr (open, close - open));
+      inUser  = array;
+      if (array)
+      {
+        if (section != "user")
+        {
+          NS_FATAL_ERROR (path << ":" << lineNo << ": only [[user]] tables are supported");
+        }
+        sc.userOverrides.emplace_back ();
+      }
+      continue;
+    }
+
+    size_t eq = line.find ('=');
+    if (eq == std::string::npos)
+    {
+      NS_FATAL_ERROR (path << ":" << lineNo << ": expected key = value");
+    }
+    std::string key   = TrimScenario (line.substr (0, eq));
+    std::string value = TrimScenario (line.substr (eq + 1));
+    if (value.size () >= 2 && (value[0] == '"' || value[0] == '\'') && value.back () == value[0])
+    {
+      value = value.substr (1, value.size () - 2);
+    }
+
+    if (inUser)
+    {
+      if (!IsUserKey (key))
+      {
+        NS_FATAL_ERROR (path << ":" << lineNo << ": unknown [[user]] key " << key);
+      }
+      sc.userOverrides.back ()[key] = value;
+      continue;
+    }
+
+    bool known = false;
+    try
+    {
+      known = SetScenarioValue (sc, section + "." + key, value);
+    }
+    catch (const std::exception &)
+    {
+      NS_FATAL_ERROR (path << ":" << lineNo << ": bad value for " << section << "." << key
+                      << ": " << value);
+    }
+    if (!known)
+    {
+      NS_FATAL_ERROR (path << ":" << lineNo << ": unknown key " << section << "." << key);
+    }
+  }
+}
+
+// --set="downlink.interval=16ms;users.count=8"
+static void
+ApplyScenarioOverrides (Scenario &sc, const std::string &overrides)
+{
+  std::stringstream ss (overrides);
+  std::string item;
+  while (std::getline (ss, item, ';'))
+  {
+    item = TrimScenario (item);
+    if (item.empty ()) continue;
+
+    size_t eq = item.find ('=');
+    std::string key = eq == std::string::npos ? item : TrimScenario (item.substr (0, eq));
+    bool known = false;
+    try
+    {
+      known = eq != std::string::npos && SetScenarioValue (sc, key, TrimScenario (item.substr (eq + 1)));
+    }
+    catch (const std::exception &)
+    {
+      NS_FATAL_ERROR ("--set: bad value in " << item);
+    }
+    if (!known)
+    {
+      NS_FATAL_ERROR ("--set: unknown key in " << item);
+    }
+  }
+}
+
+// per-headset specs: scenario/CLI defaults, then [[user]] overrides in order
+static std::vector<UserSpec>
+BuildUsers (const Scenario &sc)
+{
+  size_t n = std::max<size_t> (std::max<uint32_t> (sc.users, 1), sc.userOverrides.size ());
+  std::vector<UserSpec> users (n, UserSpec {sc.frameSize, sc.accessRate, sc.accessDelay, sc.appStart,
+                                            sc.wifiDistance});
+
+  for (size_t i = 0; i < sc.userOverrides.size (); ++i)
+  {
+    for (const auto &kv : sc.userOverrides[i])
+    {
+      if      (kv.first == "frameSize") users[i].frameSize   = std::stoul (kv.second);
+      else if (kv.first == "rate")      users[i].accessRate  = kv.second;
+      else if (kv.first == "delay")     users[i].accessDelay = kv.second;
+      else if (kv.first == "start")     users[i].start       = Time (kv.second);
+      else if (kv.first == "distance")  users[i].distance    = std::stod (kv.second);
+    }
+  }
+  return users;
+}
+
+// metrics.deadlines / --deadlines: "20,33,50" -> {20,33,50}; false on a bad entry
+static bool
+ParseDeadlineList (const std::string &list, std::vector<uint32_t> &out, std::string &bad)
+{
+  out.clear ();
+  std::stringstream ds (list);
+  std::string d;
+  while (std::getline (ds, d, ','))
+  {
+    d = TrimScenario (d);
+    if (d.empty ()) continue;
+    char *end = nullptr;
+    errno = 0;
+    unsigned long v = std::strtoul (d.c_str (), &end, 10);
+    if (*end != '\0' || errno || v == 0 || v > UINT32_MAX || d[0] == '-')
+    {
+      bad = d;
+      return false;
+    }
+    out.push_back ((uint32_t) v);
+  }
+  return true;
+}
+
+// scheduler.table: "pendingEst,scheduler" rows as written by sched-bench.sh.
+// auto takes the row with the largest pendingEst <= the estimate, or the
+// first row below all of them. false = unreadable, malformed or empty
+static bool
+LoadSchedTable (const std::string &path, std::vector<std::pair<double, std::string>> &rows)
+{
+  std::ifstream in (path);
+  if (!in) return false;
+
+  std::string line;
+  while (std::getline (in, line))
+  {
+    line = TrimScenario (line);
+    if (line.empty () || line[0] == '#' || line.compare (0, 10, "pendingEst") == 0) continue;
+    size_t comma = line.find (',');
+    if (comma == std::string::npos) return false;
+    try
+    {
+      rows.emplace_back (std::stod (line.substr (0, comma)), TrimScenario (line.substr (comma + 1)));
+    }
+    catch (const std::exception &)
+    {
+      return false;
+    }
+  }
+  std::sort (rows.begin (), rows.end ());
+  return !rows.empty ();
+}
+
+//
+// Wi-Fi 6 last hop (access.mode = wifi): one 802.11ax AP, one station per headset
+//   - AP at the origin, headset i at users[i].distance on a circle around it
+//   - wifi.mcs < 0: IdealWifiManager picks the MCS from the SNR; otherwise
+//     every data frame is sent at HeMcs<mcs> (ConstantRateWifiManager)
+//   - full: SpectrumWifiPhy + the default table-based error model
+//   - wifi.fast: YansWifiPhy, closed-form Nist error model, no preamble
+//     detection model; MAC behaviour (A-MPDU, block ack, retries) unchanged
+//   - returns {AP device, station 0..N-1}
+//
+static NetDeviceContainer
+InstallWifiLastHop (const Scenario &sc, const std::vector<UserSpec> &users,
+                    Ptr<Node> ap, NodeContainer headsets)
+{
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_STANDARD_80211ax);
+  if (sc.wifiMcs < 0)
+  {
+    wifi.SetRemoteStationManager ("ns3::IdealWifiManager");
+  }
+  else
+  {
+    wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                  "DataMode", StringValue ("HeMcs" + std::to_string (sc.wifiMcs)),
+                                  "ControlMode", StringValue ("OfdmRate24Mbps"));
+  }
+
+  YansWifiPhyHelper     yans;
+  SpectrumWifiPhyHelper spectrum;
+  WifiPhyHelper &phy = sc.wifiFast ? static_cast<WifiPhyHelper &> (yans) : spectrum;
+  if (sc.wifiFast)
+  {
+    YansWifiChannelHelper ch;
+    ch.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
+    ch.AddPropagationLoss ("ns3::LogDistancePropagationLossModel",
+                           "Exponent", DoubleValue (sc.wifiExponent));
+    yans.SetChannel (ch.Create ());
+    yans.SetErrorRateModel ("ns3::NistErrorRateModel");
+    yans.DisablePreambleDetectionModel ();
+  }
+  else
+  {
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+    loss->SetAttribute ("Exponent", DoubleValue (sc.wifiExponent));
+    Ptr<MultiModelSpectrumChannel> ch = CreateObject<MultiModelSpectrumChannel> ();
+    ch->AddPropagationLossModel (loss);
+    ch->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+    spectrum.SetChannel (ch);
+  }
+
+  // 5 GHz；信道号 0 = 该带宽下的默认信道
+  std::ostringstream channel;
+  channel << "{0, " << sc.wifiWidth << ", BAND_5GHZ, 0}";
+  phy.Set ("ChannelSettings", StringValue (channel.str ()));
+  phy.Set ("Antennas", UintegerValue (sc.wifiNss));
+  phy.Set ("MaxSupportedTxSpatialStreams", UintegerValue (sc.wifiNss));
+  phy.Set ("MaxSupportedRxSpatialStreams", UintegerValue (sc.wifiNss));
+
+  Ssid ssid ("arvr");
+  WifiMacHelper mac;
+  mac.SetType ("ns3::ApWifiMac", "Ssid", SsidValue (ssid));
+  NetDeviceContainer devs = wifi.Install (phy, mac, ap);
+  mac.SetType ("ns3::StaWifiMac", "Ssid", SsidValue (ssid));
+  devs.Add (wifi.Install (phy, mac, headsets));
+
+  Ptr<ListPositionAllocator> pos = CreateObject<ListPositionAllocator> ();
+  pos->Add (Vector (0.0, 0.0, 0.0));
+  for (uint32_t i = 0; i < users.size (); ++i)
+  {
+    double a = 2 * M_PI * i / users.size ();
+    pos->Add (Vector (users[i].distance * std::cos (a), users[i].distance * std::sin (a), 0.0));
+  }
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (pos);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (ap);          // 顺序和 pos 一致：先 AP 再 headset
+  mobility.Install (headsets);
+  return devs;
+}
+
+//
+// Bottleneck with a GSO-capable server end (--gso): same link as
+// PointToPointHelper::Install (rate, delay, device queues, tx queue
+// interface), but devs[0] is a GsoNetDevice. Its device queue holds at least
+// two super-packets of `segs` segments; with `own` (queue discs do the
+// queueing) exactly one, the GSO analogue of the 1p device queue. A byte
+// --queue stays in bytes (segBytes = one queued segment)
+//
+static NetDeviceContainer
+InstallGsoBottleneck (const Scenario &sc, NodeContainer nodes, bool own, uint32_t segs,
+                      uint32_t segBytes)
+{
+  Ptr<PointToPointChannel> ch = CreateObject<PointToPointChannel> ();
+  ch->SetAttribute ("Delay", StringValue (sc.bottleneckDelay));
+
+  Ptr<GsoNetDevice>          a = CreateObject<GsoNetDevice> ();
+  Ptr<PointToPointNetDevice> b = CreateObject<PointToPointNetDevice> ();
+  QueueSize limit (sc.queueSize);
+  QueueSize ring = own ? QueueSize (QueueSizeUnit::PACKETS, segs)
+                 : limit.GetUnit () == QueueSizeUnit::BYTES
+                     ? QueueSize (QueueSizeUnit::BYTES, std::max (limit.GetValue (), 2 * segs * segBytes))
+                     : QueueSize (QueueSizeUnit::PACKETS, std::max (limit.GetValue (), 2 * segs));
+  Ptr<PointToPointNetDevice> ends[2] = {a, b};
+  for (uint32_t i = 0; i < 2; ++i)
+  {
+    Ptr<PointToPointNetDevice> dev = ends[i];
+    dev->SetAddress (Mac48Address::Allocate ());
+    dev->SetAttribute ("DataRate", StringValue (sc.bottleneckRate));
+    QueueSize size = i == 0 ? ring : QueueSize (own ? "1p" : sc.queueSize);
+    Ptr<Queue<Packet>> q = CreateObjectWithAttributes<DropTailQueue<Packet>> ("MaxSize", QueueSizeValue (size));
+    dev->SetQueue (q);
+    nodes.Get (i)->AddDevice (dev);
+    dev->Attach (ch);
+
+    Ptr<NetDeviceQueueInterface> ndqi = CreateObject<NetDeviceQueueInterface> ();
+    dev->AggregateObject (ndqi);
+    // 服务器端自己管 stop/wake（按整个 super-packet），另一端和 helper 一样
+    if (i == 1) ndqi->GetTxQueue (0)->ConnectQueueTraces (q);
+  }
+  a->SetupGso (segs, segBytes);
+
+  NetDeviceContainer devs;
+  devs.Add (a);
+  devs.Add (b);
+  return devs;
+}
+
+//
+// Emulation tap: an FdNetDevice on `node` attached to the persistent host tap
+// `name`. emu-run.sh creates the taps owned by the user, so the simulator
+// itself needs no privileges. IFF_NO_PI: plain Ethernet frames, as
+// FdNetDevice expects
+//
+static Ptr<FdNetDevice>
+OpenEmuTap (Ptr<Node> node, const std::string &name)
+{
+  int fd = open ("/dev/net/tun", O_RDWR);
+  if (fd < 0)
+  {
+    NS_FATAL_ERROR ("Cannot open /dev/net/tun: " << std::strerror (errno));
+  }
+  struct ifreq ifr;
+  std::memset (&ifr, 0, sizeof (ifr));
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  std::strncpy (ifr.ifr_name, name.c_str (), IFNAMSIZ - 1);
+  if (ioctl (fd, TUNSETIFF, &ifr) < 0)
+  {
+    NS_FATAL_ERROR ("Cannot attach to tap " << name << " (see emu-run.sh): " << std::strerror (errno));
+  }
+
+  FdNetDeviceHelper helper;
+  Ptr<FdNetDevice> dev = DynamicCast<FdNetDevice> (helper.Install (node).Get (0));
+  dev->SetFileDescriptor (fd);
+  return dev;
+}
+
+//
+// Analytic fast path (--model=fluid|auto)
+//   - single p2p user, udp/quic: the bottleneck is one FIFO server of known
+//     rate, so every packet's departure follows the Lindley recursion
+//       done_j = max (arrive_j, done_{j-1}) + tx
+//     with tx = serialization time of the wire size (VrHeader, UDP, IPv4,
+//     PPP) and arrival at the headset = done_j + link delay. No events,
+//     no packets: a 9 s run is a few hundred thousand multiply-adds
+//   - frame ticks as in VrDownlinkApp: udp every frameInterval, quic paces
+//     fragments and starts the next frame frameInterval - pacing later (or
+//     right after the last fragment when pacing is slower than that)
+//   - drop-tail against queue disc + device queue + the packet on the wire;
+//     "default" = device queue + the fq_codel limit, CoDel itself is not
+//     modelled (it only acts on a standing queue, i.e. overload)
+//   - loss: the byte-unit RateErrorModel of the headset device, one draw
+//     per packet
+//   - receiver bookkeeping as VrReceiverApp: ms timestamps, a frame counts
+//     once its first packet arrives before appStop, frames still missing
+//     packets at appStop are incomplete
+//   - auto: a point goes to the packet simulator if the model sees queue
+//     overflow, overload or a completed frame within model.margin ms of a
+//     deadline; tcp, users > 1, other phys and the sender/receiver models
+//     (encoder, pipeline, outage, playout, quality, fork), background
+//     load, qdisc edf (drops late fragments), GSO and the packet-only
+//     outputs (frameTrace, live, pcap) are not covered
+//
+struct FluidResult
+{
+  uint32_t total = 0, onTime = 0, late = 0, incomplete = 0;
+  std::vector<uint32_t> delays;   // ms, completed frames, as VrSession::m_delays
+  uint32_t overflowFrames = 0;    // frames that lost packets to a full queue
+  uint32_t cliffFrames    = 0;    // completed within margin of a deadline
+  double   load           = 0;    // busy time per frame / frame period
+  std::vector<uint32_t> ulDelays; // ms, IMU uplink, as VrUplinkReceiver::m_delays
+};
+
+// "" = covered, otherwise what is not
+static std::string
+FluidUnsupported (const Scenario &sc, const std::vector<UserSpec> &users)
+{
+  if (users.size () != 1 || sc.accessMode != "p2p")        return "users/phy";
+  if (sc.transport != "udp" && sc.transport != "quic")     return "transport " + sc.transport;
+  if (sc.encoder || sc.pipeline)                           return "sender model";
+  if (sc.outageMode != "off")                              return "outage";
+  if (sc.playoutMode != "off" || sc.quality)               return "receiver model";
+  if (sc.forkAt > 0.0)                                     return "fork";
+  if (sc.sessions > 1)                                     return "sessions";
+  if (sc.bgMode != "off")                                  return "background";
+  if (sc.qdisc == "edf")                                   return "qdisc edf";
+  if (sc.gso)                                              return "gso";
+  // 只有 packet 仿真才产生的输出：fluid 不能悄悄跳过
+  if (!sc.frameTrace.empty ())                             return "frameTrace";
+  if (sc.liveInterval > 0.0)                               return "liveInterval";
+  if (sc.pcapMode != "off")                                return "pcap";
+  return "";
+}
+
+// explicit RNG stream of the fluid loss draws (automatic streams start at 2^63)
+static const int64_t kFluidLossStream = 1000;
+
+static FluidResult
+RunFluidModel (const Scenario &sc, const UserSpec &user,
+               const std::vector<uint32_t> &deadlines, uint32_t marginMs)
+{
+  FluidResult r;
+  DataRate rate (sc.bottleneckRate);
+  Time     delay (sc.bottleneckDelay);
+  uint32_t wire = sc.pktSize + 12 + 8 + 20 + 2;   // VrHeader + UDP + IPv4 + PPP
+  Time     tx   = rate.CalculateBytesTxTime (wire);
+  uint32_t n    = (user.frameSize + sc.pktSize - 1) / sc.pktSize;
+  bool     quic = (sc.transport == "quic");
+
+  Time period = sc.frameInterval;
+  if (quic)
+  {
+    // SendOneFragmentT: 最后一片之后再等 interval - n * pacing
+    Time remaining = sc.frameInterval - sc.pacingInterval * (int64_t) n;
+    period = remaining.IsPositive () ? sc.frameInterval - sc.pacingInterval
+                                     : sc.pacingInterval * (int64_t) (n - 1) + MicroSeconds (1);
+  }
+  r.load = (tx * (int64_t) n).GetSeconds () / period.GetSeconds ();
+
+  QueueSize q (sc.queueSize);
+  uint32_t qPkts = q.GetUnit () == QueueSizeUnit::PACKETS ? q.GetValue () : q.GetValue () / wire;
+  uint32_t cap   = (sc.qdisc == "default" ? qPkts + 10240 : qPkts + 1) + 1;
+
+  double pLoss = 1.0 - std::pow (1.0 - sc.loss, wire);
+  // 固定的显式 stream：不占自动分配的 stream 号，auto 回落到 packet 时
+  // RateErrorModel 拿到的 stream 和 --model=packet 一样，同 seed/run 可复现
+  Ptr<UniformRandomVariable> u = CreateObjectWithAttributes<UniformRandomVariable> (
+      "Stream", IntegerValue (kFluidLossStream));
+
+  std::deque<Time> inSystem;   // departures of accepted packets still queued or on the wire
+  Time done;                   // departure of the last accepted packet
+  for (Time t = user.start; t < sc.appStop; t += period)
+  {
+    uint32_t tickMs   = (uint32_t) t.GetMilliSeconds ();
+    Time     first    = Time::Max ();   // first surviving packet at the headset
+    Time     last;
+    uint32_t arrived  = 0;
+    bool     overflow = false;
+    for (uint32_t j = 0; j < n; ++j)
+    {
+      Time a = quic ? t + sc.pacingInterval * (int64_t) j : t;
+      while (!inSystem.empty () && inSystem.front () <= a) inSystem.pop_front ();
+      if (inSystem.size () >= cap)
+      {
+        overflow = true;
+        continue;
+      }
+      done = std::max (a, done) + tx;
+      inSystem.push_back (done);
+      if (pLoss > 0.0 && u->GetValue () < pLoss) continue;
+      arrived += 1;
+      first = std::min (first, done + delay);
+      last  = done + delay;
+    }
+    if (overflow) r.overflowFrames += 1;
+    if (!arrived || first >= sc.appStop) continue;   // socket 已关，这一帧不计数
+
+    r.total += 1;
+    if (arrived < n || last >= sc.appStop)
+    {
+      r.incomplete += 1;
+      continue;
+    }
+    uint32_t delta = (uint32_t) last.GetMilliSeconds () - tickMs;
+    r.delays.push_back (delta);
+    if (delta <= sc.deadlineMs) r.onTime += 1;
+    else                        r.late   += 1;
+    for (uint32_t d : deadlines)
+    {
+      if (delta + marginMs >= d && delta <= d + marginMs)
+      {
+        r.cliffFrames += 1;
+        break;
+      }
+    }
+  }
+
+  // 上行方向空闲（全双工），每个包单独按 ms 时间戳算，和 VrUplinkReceiver 一样
+  uint32_t ulWire = sc.ulPktSize + 4 + 8 + 20 + 2;   // UplinkHeader + UDP + IPv4 + PPP
+  Time     ulTx   = rate.CalculateBytesTxTime (ulWire);
+  for (Time t = sc.appStart; t < sc.appStop; t += sc.ulInterval)
+  {
+    Time a = t + ulTx + delay;
+    if (a >= sc.appStop) break;
+    r.ulDelays.push_back ((uint32_t) (a.GetMilliSeconds () - t.GetMilliSeconds ()));
+  }
+  return r;
+}
+
+//
+// 5. Run output: collision-free names, atomic XML write, shared manifest
+//    - file name = sweep params + feature tags + ScenarioDigest + RngSeed +
+//      RngRun, so parallel workers running different configurations or
+//      replications never overwrite each other
+//    - data goes to "<path>.tmp.<pid>" first and is renamed into place,
+//      a killed run never leaves a truncated XML behind
+//    - every finished run appends one line to <outDir>/manifest.csv under flock()
+//
+//
+// Digest of the resolved Scenario (every field but outDir, plus the [[user]]
+// overrides) for the XML name and manifest.csv: two runs share a name only
+// if they simulate the same configuration. New Scenario fields go here too
+//
+static std::string
+ScenarioDigest (const Scenario &sc)
+{
+  auto T = [] (Time t) { return t.GetTimeStep (); };
+  std::ostringstream os;
+  os.precision (17);
+  os << "v1|";
+  os << sc.transport << '|' << sc.tcpType << '|' << T (sc.pacingInterval) << '|' << sc.batch << '|'
+     << sc.gso << '|' << sc.gro << '|' << T (sc.groFlush) << '|';
+  os << sc.bottleneckRate << '|' << sc.bottleneckDelay << '|' << sc.queueSize << '|'
+     << sc.qdisc << '|' << sc.loss << '|';
+  os << sc.users << '|' << sc.sessions << '|' << sc.accessMode << '|' << sc.accessRate << '|'
+     << sc.accessDelay << '|' << sc.apScheduler << '|' << sc.apQueue << '|'
+     << T (sc.apQuantum) << '|' << T (sc.airOverhead) << '|';
+  os << sc.wifiMcs << '|' << sc.wifiWidth << '|' << sc.wifiNss << '|' << sc.wifiDistance << '|'
+     << sc.wifiExponent << '|' << sc.wifiFast << '|';
+  os << T (sc.cellTti) << '|' << sc.cellDlRate << '|' << sc.cellUlRate << '|'
+     << sc.cellTrace << '|' << T (sc.cellSrPeriod) << '|' << T (sc.cellGrantDelay) << '|'
+     << T (sc.cellHarqRtt) << '|' << sc.cellBler << '|' << sc.cellHarqMax << '|'
+     << sc.cellConfiguredGrant << '|';
+  os << sc.outageMode << '|' << sc.outageAt << '|' << T (sc.outageInterval) << '|'
+     << T (sc.outageDuration) << '|' << sc.outageDist << '|' << sc.outagePolicy << '|'
+     << sc.outageUsers << '|';
+  os << sc.bgMode << '|' << sc.bgRate << '|' << sc.bgFlows << '|' << T (sc.bgOn) << '|'
+     << T (sc.bgOff) << '|' << sc.bgPktSize << '|' << sc.bgPort << '|';
+  os << sc.frameSize << '|' << T (sc.frameInterval) << '|' << sc.pktSize << '|' << sc.dlPort << '|'
+     << T (sc.ulInterval) << '|' << sc.ulPktSize << '|' << sc.ulPort << '|';
+  os << sc.encoder << '|' << sc.encoderDist << '|' << T (sc.encoderMean) << '|'
+     << T (sc.encoderJitter) << '|' << sc.encoderSlices << '|';
+  os << sc.pipeline << '|' << sc.renderDist << '|' << T (sc.renderMean) << '|'
+     << T (sc.renderJitter) << '|' << sc.renderQueue << '|' << sc.sendQueue << '|'
+     << sc.pipelineFull << '|';
+  os << sc.playoutMode << '|' << sc.playoutPolicy << '|' << T (sc.playoutTarget) << '|'
+     << sc.playoutPercentile << '|' << sc.playoutWindow << '|' << sc.playoutK << '|'
+     << T (sc.playoutMin) << '|' << T (sc.playoutMax) << '|' << T (sc.playoutStep) << '|';
+  os << sc.quality << '|' << sc.qualityCurve << '|' << sc.qualityLayers << '|'
+     << sc.qualityFreeze << '|';
+  os << sc.dscp << '|';
+  os << T (sc.appStart) << '|' << T (sc.appStop) << '|' << T (sc.simStop) << '|';
+  os << sc.deadlineMs << '|' << sc.deadlineList << '|' << sc.liveInterval << '|'
+     << sc.liveOut << '|' << sc.liveBuffer << '|' << sc.frameTrace << '|';
+  os << sc.forkAt << '|';
+  os << sc.model << '|' << sc.modelMargin << '|' << sc.emuMode << '|' << sc.emuServerTap << '|'
+     << sc.emuHeadsetTap << '|' << T (sc.emuProbe) << '|' << T (sc.emuMaxLag) << '|'
+     << sc.pcapMode << '|' << sc.pcapSnaplen << '|' << T (sc.pcapPre) << '|'
+     << T (sc.pcapPost) << '|' << sc.pcapFiles << '|' << sc.pcapPrefix << '|'
+     << sc.scheduler << '|' << T (sc.schedWidth) << '|' << sc.schedBuckets << '|' << sc.schedTable << '|'
+     << sc.forkParam << '|' << sc.forkValues << '|' << sc.forkJobs << '|';
+  for (const std::map<std::string, std::string> &u : sc.userOverrides)
+  {
+    os << "[user]";
+    for (const auto &kv : u) os << kv.first << '=' << kv.second << '|';
+  }
+
+  // FNV-1a 64
+  uint64_t h = 1469598103934665603ULL;
+  for (unsigned char c : os.str ())
+  {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  std::ostringstream hex;
+  hex << std::hex << std::setw (16) << std::setfill ('0') << h;
+  return hex.str ();
+}
+
+static bool
+WriteFileAtomic (const std::string &path, const std::string &data)
+{
+  std::ostringstream tmp;
+  tmp << path << ".tmp." << getpid ();
+  std::string tmpPath = tmp.str ();
+
+  int fd = open (tmpPath.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  const char *p = data.data ();
+  size_t left = data.size ();
+  while (left > 0)
+  {
+    ssize_t n = write (fd, p, left);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      close (fd);
+      unlink (tmpPath.c_str ());
+      return false;
+    }
+    p    += n;
+    left -= n;
+  }
+
+  // 先落盘再 rename，保证看到的文件要么不存在、要么是完整的
+  if (fsync (fd) != 0 || close (fd) != 0 || rename (tmpPath.c_str (), path.c_str ()) != 0)
+  {
+    unlink (tmpPath.c_str ());
+    return false;
+  }
+  return true;
+}
+
+// model: packet, or fluid (no XML, empty file column)
+static const char *kManifestHeader = "file,transport,tcpType,rate,delay,loss,deadline,frameSize,queue,"
+                                     "seed,run,total,onTime,late,incomplete,ratio,cfg,model";
+
+static bool
+AppendManifestLine (const std::string &path, const std::string &header, const std::string &line)
+{
+  int fd = open (path.c_str (), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) return false;
 
-  // 每帧的聚合状态（无论 UDP/TCP）
-  std::map<uint32_t, FrameState> m_frames;
+  if (flock (fd, LOCK_EX) != 0)
+  {
+    close (fd);
+    return false;
+  }
 
-  // 指标统计
-  uint32_t m_deadlineMs;
-  uint32_t m_totalFrames;
-  uint32_t m_onTimeFrames;
-  uint32_t m_lateFrames;
-  uint32_t m_incompleteFrames;
-};
+  // 拿到锁之后再看文件是否为空，避免多个 worker 重复写表头
+  std::string out;
+  struct stat st;
+  if (fstat (fd, &st) == 0 && st.st_size == 0)
+    out = header + "\n";
+  out += line + "\n";
 
+  bool ok = write (fd, out.data (), out.size ()) == (ssize_t) out.size ();
 
-class UplinkHeader : public Header
+  flock (fd, LOCK_UN);
+  close (fd);
+  return ok;
+}
+
+//
+// 6. main: build 2-node topology and run AR/VR traffic
+//
+int
+main (int argc, char *argv[])
 {
-public:
-  UplinkHeader (uint32_t ts = 0) : m_ts(ts) {}
+  auto wallStart = std::chrono::steady_clock::now ();
 
-  void SetTs (uint32_t ts) { m_ts = ts; }
-  uint32_t GetTs () const { return m_ts; }
+  Scenario sc;
+  std::string scenarioPath;
+  std::string overrides;
 
-  static TypeId GetTypeId (void) {
-    static TypeId tid = TypeId("UplinkHeader")
-      .SetParent<Header>()
-      .AddConstructor<UplinkHeader>();
-    return tid;
+  // --scenario 要在 CommandLine 之前读进来，命名参数才能覆盖文件里的值
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string a = argv[i];
+    if (a.compare (0, 11, "--scenario=") == 0) scenarioPath = a.substr (11);
+  }
+  if (!scenarioPath.empty ())
+  {
+    LoadScenarioFile (scenarioPath, sc);
   }
 
-  virtual TypeId GetInstanceTypeId (void) const { return GetTypeId(); }
-  virtual void Print (std::ostream& os) const { os << m_ts; }
+  CommandLine cmd;
+  cmd.AddValue ("scenario",  "Scenario file (TOML subset), see scenarios/", scenarioPath);
+  cmd.AddValue ("set",       "Scenario overrides applied last: \"section.key=value;...\"", overrides);
+  cmd.AddValue ("users",     "Number of headsets behind the bottleneck", sc.users);
+  cmd.AddValue ("sessions",  "VR sessions per headset node, demultiplexed by one receiver per node", sc.sessions);
+  cmd.AddValue ("phy",       "Last hop: p2p, air (abstract shared AP), wifi (802.11ax) or cell", sc.accessMode);
+  cmd.AddValue ("wifiFast",  "wifi: Yans PHY + Nist error model, no preamble detection", sc.wifiFast);
+  cmd.AddValue ("transport", "Transport protocol: udp or tcp", sc.transport);
+  cmd.AddValue ("tcp",       "tcp type: cubic or bbr",         sc.tcpType);
+  cmd.AddValue ("batch",     "udp/quic: hand whole frames to the device queue in one call", sc.batch);
+  cmd.AddValue ("gso",       "udp/quic: fragments per GSO super-packet, split at the bottleneck device (0 = off)", sc.gso);
+  cmd.AddValue ("gro",       "udp/quic: coalesce back-to-back fragments on the headsets (GRO)", sc.gro);
+  cmd.AddValue ("rate",      "Bottleneck data rate",           sc.bottleneckRate);
+  cmd.AddValue ("delay",     "Bottleneck delay",               sc.bottleneckDelay);
+  cmd.AddValue ("deadline",  "Per-frame deadline (ms)",        sc.deadlineMs);
+  cmd.AddValue ("deadlines", "Extra deadlines (ms) evaluated post-hoc, comma-separated", sc.deadlineList);
+  cmd.AddValue ("loss",      "Packet loss rate [0..1.0]",      sc.loss);
+  cmd.AddValue ("frameSize", "Downlink frame size in bytes",   sc.frameSize);
+  cmd.AddValue ("queue",     "queue buffer size",              sc.queueSize);
+  cmd.AddValue ("qdisc",     "Queue discipline on every p2p link: default, droptail, edf or prio", sc.qdisc);
+  cmd.AddValue ("dscp",      "DSCP marks: off, on (AF41/EF/CS6) or video,imu,ack", sc.dscp);
+  cmd.AddValue ("outage",    "Headset-link outages: off, scheduled or poisson (outage.* keys)", sc.outageMode);
+  cmd.AddValue ("outagePolicy", "During an outage: buffer or drop", sc.outagePolicy);
+  cmd.AddValue ("bg",        "Bottleneck background load: off, fluid or packet (background.* keys)", sc.bgMode);
+  cmd.AddValue ("bgRate",    "Mean background load",           sc.bgRate);
+  cmd.AddValue ("encoder",   "Sender encoder model: per-frame encode time (encoder.* keys)", sc.encoder);
+  cmd.AddValue ("slices",    "Encoder slices per frame (1 = whole frame at once)", sc.encoderSlices);
+  cmd.AddValue ("pipeline",  "Sender render -> encode -> send pipeline (pipeline.* keys)", sc.pipeline);
+  cmd.AddValue ("playout",   "Receiver playout buffer: off, fixed, percentile or kalman (playout.* keys)", sc.playoutMode);
+  cmd.AddValue ("qoe",       "Per-frame quality proxy and session QoE (quality.* keys)", sc.quality);
+  cmd.AddValue ("frameTrace", "Per-frame CSV (user,frame,send,status,delay,outage); empty = off", sc.frameTrace);
+  cmd.AddValue ("outDir",    "Directory for FlowMonitor XML and manifest.csv", sc.outDir);
+  cmd.AddValue ("liveInterval", "Live snapshot period in simulated seconds (0 = off)", sc.liveInterval);
+  cmd.AddValue ("liveOut",   "Live sink: stdout, a file path or unix:/path", sc.liveOut);
+  cmd.AddValue ("liveBuffer", "Max live lines queued for a slow consumer", sc.liveBuffer);
+  cmd.AddValue ("model",     "packet (simulate), fluid (analytic fast path) or auto (fluid, packets near the deadline cliff)", sc.model);
+  cmd.AddValue ("emu",       "Realtime emulation: off, or tap (host processes through the bottleneck, emulation.* keys)", sc.emuMode);
+  cmd.AddValue ("pcap",      "Header-only pcap on the bottleneck: off, all or ring (around missed frames, pcap.* keys)", sc.pcapMode);
+  cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar, ns3-calendar or auto", sc.scheduler);
+  cmd.AddValue ("forkAt",    "Warm-up end (s): run once, then fork one worker per --forkValues entry (0 = off)", sc.forkAt);
+  cmd.AddValue ("forkParam", "Parameter changed at the fork point: loss, deadline or queue", sc.forkParam);
+  cmd.AddValue ("forkValues", "Comma-separated values of --forkParam, one worker each", sc.forkValues);
+  cmd.AddValue ("forkJobs",  "Max concurrent fork workers (0 = one per core)", sc.forkJobs);
+  cmd.Parse (argc, argv);
 
-  virtual uint32_t GetSerializedSize (void) const { return 4; }
+  ApplyScenarioOverrides (sc, overrides);
+  std::vector<UserSpec> users = BuildUsers (sc);
+  auto wallParsed = std::chrono::steady_clock::now ();
 
-  virtual void Serialize (Buffer::Iterator start) const {
-    start.WriteHtonU32(m_ts);
+  SystemPath::MakeDirectories (sc.outDir);
+
+  // realtime emulation: host sender -> serverTap -> server node -> bottleneck ->
+  // headset node -> headsetTap -> host receiver. The simulator implementation
+  // must be chosen before the first node exists
+  bool emu = (sc.emuMode == "tap");
+  if (sc.emuMode != "off" && !emu)
+  {
+    NS_FATAL_ERROR ("Unknown emulation.mode: " << sc.emuMode);
+  }
+  if (emu)
+  {
+    if (users.size () != 1 || sc.sessions > 1 || sc.accessMode != "p2p" || sc.transport == "tcp")
+    {
+      NS_FATAL_ERROR ("emulation.mode = tap needs one p2p user, one session and transport udp or quic");
+    }
+    // 发送端是真实进程：仿真侧的 sender 模型、fork、fluid 都不适用
+    if (sc.model != "packet" || sc.forkAt > 0.0 || sc.encoder || sc.pipeline || sc.batch || sc.gso
+        || sc.bgMode != "off" || !sc.frameTrace.empty ())
+    {
+      NS_FATAL_ERROR ("emulation.mode = tap does not combine with --model, --forkAt, encoder, "
+                      "pipeline, --batch, --gso, background load or --frameTrace");
+    }
+    GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+    GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));   // 主机内核会校验 IPv4 checksum
   }
 
-  virtual uint32_t Deserialize (Buffer::Iterator start) {
-    m_ts = start.ReadNtohU32();
-    return 4;
+  // single p2p user: {server, headset} exactly as before; otherwise {server, ap}
+  NodeContainer nodes;
+  nodes.Create (2);
+  Ptr<Node> server = nodes.Get (0);
+
+  if (sc.qdisc != "default" && sc.qdisc != "droptail" && sc.qdisc != "edf" && sc.qdisc != "prio")
+  {
+    NS_FATAL_ERROR ("Unknown qdisc: " << sc.qdisc);
+  }
+  bool ownQdisc = (sc.qdisc != "default");
+  // prio/edf 只装在 p2p 链路上；air/wifi/cell 的瓶颈在 AP/gNB 队列里，装了也不起作用
+  if ((sc.qdisc == "prio" || sc.qdisc == "edf") && sc.accessMode != "p2p")
+  {
+    NS_FATAL_ERROR ("--qdisc=" << sc.qdisc << " only schedules p2p links, not access.mode = "
+                    << sc.accessMode << " (use access.scheduler = edf for the air AP)");
   }
 
-private:
-  uint32_t m_ts;
-};
+  // post-hoc deadlines: 跑之前校验一次，fluid 和最后的 [VR-DEADLINE] 共用
+  std::vector<uint32_t> deadlines;
+  std::string badDeadline;
+  if (!ParseDeadlineList (sc.deadlineList, deadlines, badDeadline))
+  {
+    NS_FATAL_ERROR ("Bad --deadlines entry: " << badDeadline);
+  }
+  // edf 调度按 --deadline 排序，流量本身跟着 deadline 变，事后换 deadline 不等于单独跑
+  if (!deadlines.empty ()
+      && (sc.qdisc == "edf" || (sc.accessMode == "air" && sc.apScheduler == "edf")))
+  {
+    NS_FATAL_ERROR ("--deadlines needs a deadline-independent schedule; "
+                    "with --qdisc=edf or access.scheduler = edf run each --deadline separately");
+  }
 
-//
-// 4. Uplink app: send small packets periodically (e.g., every 10ms)
-//
-class VrUplinkApp : public Application
-{
-public:
-  VrUplinkApp () {}
+  // analytic fast path: fluid 直接出结果；auto 只有离 deadline 悬崖近的点才真跑仿真
+  if (sc.model != "packet" && sc.model != "fluid" && sc.model != "auto")
+  {
+    NS_FATAL_ERROR ("Unknown model.mode: " << sc.model);
+  }
+  if (sc.model != "packet")
+  {
+    std::string reason = FluidUnsupported (sc, users);
+    if (sc.model == "fluid" && !reason.empty ())
+    {
+      NS_FATAL_ERROR ("--model=fluid does not cover " << reason << ", use packet or auto");
+    }
+    if (reason.empty ())
+    {
+      std::vector<uint32_t> cliffs (1, sc.deadlineMs);
+      cliffs.insert (cliffs.end (), deadlines.begin (), deadlines.end ());
+      FluidResult fr = RunFluidModel (sc, users[0], cliffs, sc.modelMargin);
+      if (fr.overflowFrames)    reason = "overflow";
+      else if (fr.load >= 1.0)  reason = "overload";
+      else if (fr.cliffFrames)  reason = "cliff";
+
+      if (sc.model == "fluid" || reason.empty ())
+      {
+        std::vector<uint32_t> sorted = fr.delays;
+        std::sort (sorted.begin (), sorted.end ());
+        uint32_t p99 = sorted.empty () ? 0 : sorted[std::min<size_t> (sorted.size () * 0.99, sorted.size () - 1)];
+        std::cout << "[MODEL] mode=" << sc.model
+                  << " used=fluid"
+                  << " reason=" << (reason.empty () ? "clear" : reason)
+                  << " load=" << fr.load
+                  << " overflowFrames=" << fr.overflowFrames
+                  << " cliffFrames=" << fr.cliffFrames
+                  << " p99=" << p99
+                  << std::endl;
+        std::cout << "[RUN] phy=" << sc.accessMode
+                  << " wallMs=" << std::chrono::duration<double, std::milli> (
+                                     std::chrono::steady_clock::now () - wallParsed).count ()
+                  << " events=0"
+                  << std::endl;
+        std::vector<uint32_t> ul = fr.ulDelays;
+        std::sort (ul.begin (), ul.end ());
+        if (ul.empty ())
+        {
+          std::cout << "[UL-IMU] noSamples=1 avgDelay=0 p99=0 max=0" << std::endl;
+        }
+        else
+        {
+          uint64_t sum = 0;
+          for (uint32_t d : ul) sum += d;
+          std::cout << "[UL-IMU] avgDelay=" << double (sum) / ul.size ()
+                    << " p99=" << ul[std::min<size_t> (ul.size () * 0.99, ul.size () - 1)]
+                    << " max=" << ul.back () << std::endl;
+        }
+        std::cout << "[VR-RECV] total=" << fr.total
+                  << " onTime=" << fr.onTime
+                  << " late=" << fr.late
+                  << " incomplete=" << fr.incomplete
+                  << " ratio=" << (fr.total ? (double) fr.onTime / fr.total : 0.0)
+                  << std::endl;
+        for (size_t i = 1; i < cliffs.size (); ++i)
+        {
+          uint32_t onTime = std::upper_bound (sorted.begin (), sorted.end (), cliffs[i]) - sorted.begin ();
+          std::cout << "[VR-DEADLINE] deadline=" << cliffs[i]
+                    << " total=" << fr.total
+                    << " onTime=" << onTime
+                    << " late=" << sorted.size () - onTime
+                    << " incomplete=" << fr.incomplete
+                    << " ratio=" << (fr.total ? (double) onTime / fr.total : 0.0)
+                    << std::endl;
+        }
+
+        // 没有 XML，但 manifest 照样记一行（file 为空，model=fluid）
+        std::ostringstream row;
+        row << ',' << sc.transport << ',' << sc.tcpType << ',' << sc.bottleneckRate
+            << ',' << sc.bottleneckDelay << ',' << sc.loss << ',' << sc.deadlineMs << ',' << sc.frameSize
+            << ',' << sc.queueSize << ',' << RngSeedManager::GetSeed () << ',' << RngSeedManager::GetRun ()
+            << ',' << fr.total << ',' << fr.onTime << ',' << fr.late << ',' << fr.incomplete
+            << ',' << (fr.total ? (double) fr.onTime / fr.total : 0.0)
+            << ',' << ScenarioDigest (sc) << ",fluid";
+        std::string manifest = SystemPath::Append (sc.outDir, "manifest.csv");
+        if (!AppendManifestLine (manifest, kManifestHeader, row.str ()))
+        {
+          NS_FATAL_ERROR ("Cannot append to " << manifest << ": " << std::strerror (errno));
+        }
+        return 0;
+      }
+    }
+    std::cout << "[MODEL] mode=auto used=packet reason=" << reason << std::endl;
+  }
 
-  void Setup (Ptr<Socket> socket, Address peer,
-              Time interval, uint32_t pktSize)
+  // event scheduler; auto: the fastest scheduler for this pendingEst from the
+  // sched-bench.sh table (scheduler.table), otherwise a binary heap while few
+  // events are pending and the calendar queue once in-flight packets dominate
   {
-    m_socket   = socket;
-    m_peer     = peer;
-    m_interval = interval;
-    m_pktSize  = pktSize;
+    // pending ≈ 每个用户的周期定时器 + 瓶颈上在途的包（每个包一个到达事件）
+    double wire    = (sc.pktSize + 12 + 8 + 20 + 2) * 8.0;
+    double pending = users.size () * std::max<uint32_t> (sc.sessions, 1) * 4.0
+                     + DataRate (sc.bottleneckRate).GetBitRate () * Time (sc.bottleneckDelay).GetSeconds () / wire;
+    if (sc.bgMode == "packet") pending += sc.bgFlows;
+
+    std::string type = sc.scheduler;
+    if (type == "auto" && sc.schedTable.empty ())
+    {
+      type = (pending < 64) ? "heap" : "calendar";
+    }
+    else if (type == "auto")
+    {
+      std::vector<std::pair<double, std::string>> table;
+      if (!LoadSchedTable (sc.schedTable, table))
+      {
+        NS_FATAL_ERROR ("Cannot read scheduler.table " << sc.schedTable);
+      }
+      type = table.front ().second;
+      for (const auto &row : table)
+      {
+        if (row.first <= pending) type = row.second;
+      }
+    }
+
+    ObjectFactory factory;
+    if      (type == "map")          factory.SetTypeId ("ns3::MapScheduler");
+    else if (type == "heap")         factory.SetTypeId ("ns3::HeapScheduler");
+    else if (type == "list")         factory.SetTypeId ("ns3::ListScheduler");
+    else if (type == "ns3-calendar") factory.SetTypeId ("ns3::CalendarScheduler");
+    else if (type == "calendar")
+    {
+      factory.SetTypeId (VrCalendarScheduler::GetTypeId ());
+      factory.Set ("BucketWidth", TimeValue (sc.schedWidth));
+      factory.Set ("Buckets", UintegerValue (sc.schedBuckets));
+    }
+    else
+    {
+      NS_FATAL_ERROR ("Unknown scheduler.type: " << type);
+    }
+    if (type != "map") Simulator::SetScheduler (factory);
+    std::cout << "[SCHED] type=" << type
+              << " requested=" << sc.scheduler
+              << " table=" << (sc.schedTable.empty () ? "builtin" : sc.schedTable)
+              << " widthUs=" << sc.schedWidth.GetMicroSeconds ()
+              << " buckets=" << sc.schedBuckets
+              << " pendingEst=" << (uint32_t) pending
+              << std::endl;
   }
 
-private:
-  virtual void StartApplication () override
+  // DSCP per application class: video (downlink), IMU (uplink), ACK (TCP receiver)
+  uint32_t dscpVideo = 0, dscpImu = 0, dscpAck = 0;
+  if (sc.dscp == "on")
   {
-    m_socket->Connect (m_peer);
-    SendOne ();
+    dscpVideo = 34;   // AF41
+    dscpImu   = 46;   // EF
+    dscpAck   = 48;   // CS6
+  }
+  else if (sc.dscp != "off")
+  {
+    char c1 = 0, c2 = 0;
+    std::stringstream ms (sc.dscp);
+    if (!(ms >> dscpVideo >> c1 >> dscpImu >> c2 >> dscpAck) || c1 != ',' || c2 != ','
+        || dscpVideo > 63 || dscpImu > 63 || dscpAck > 63)
+    {
+      NS_FATAL_ERROR ("Bad --dscp: " << sc.dscp);
+    }
   }
 
-  void SendOne ()
+  PlayoutBuffer::Mode playoutMode;
+  if (!PlayoutBuffer::ParseMode (sc.playoutMode, playoutMode))
   {
-    uint32_t nowMs = Simulator::Now ().GetMilliSeconds ();
+    NS_FATAL_ERROR ("Unknown playout.mode: " << sc.playoutMode);
+  }
+  if (sc.playoutPolicy != "skip" && sc.playoutPolicy != "stall")
+  {
+    NS_FATAL_ERROR ("Unknown playout.policy: " << sc.playoutPolicy);
+  }
 
-    Ptr<Packet> p = Create<Packet> (m_pktSize);
-    UplinkHeader hdr(nowMs);
-    p->AddHeader(hdr);
+  TimeDist encodeTime;
+  if (sc.encoder)
+  {
+    if (!TimeDist::IsValid (sc.encoderDist))
+    {
+      NS_FATAL_ERROR ("Unknown encoder.dist: " << sc.encoderDist);
+    }
+    encodeTime.Setup (sc.encoderDist, sc.encoderMean, sc.encoderJitter);
+  }
 
-    m_socket->Send (p);
+  TimeDist renderTime;
+  if (sc.pipeline)
+  {
+    if (!TimeDist::IsValid (sc.renderDist))
+    {
+      NS_FATAL_ERROR ("Unknown pipeline.renderDist: " << sc.renderDist);
+    }
+    if (sc.pipelineFull != "block" && sc.pipelineFull != "drop")
+    {
+      NS_FATAL_ERROR ("Unknown pipeline.full: " << sc.pipelineFull);
+    }
+    if (sc.encoder && sc.encoderSlices > 1)
+    {
+      NS_FATAL_ERROR ("encoder.slices > 1 is not supported with pipeline.enabled");
+    }
+    renderTime.Setup (sc.renderDist, sc.renderMean, sc.renderJitter);
+  }
 
-    Simulator::Schedule (m_interval, &VrUplinkApp::SendOne, this);
+  std::vector<std::pair<double, double>> qualityCurve;
+  if (sc.quality && !QualityModel::ParseCurve (sc.qualityCurve, qualityCurve))
+  {
+    NS_FATAL_ERROR ("Bad quality.curve: " << sc.qualityCurve);
   }
 
-  Ptr<Socket> m_socket;
-  Address     m_peer;
-  Time        m_interval;
-  uint32_t    m_pktSize;
-};
+  // headset-link outages: which users, and whether the bottleneck itself is
+  // the headset link (single p2p user)
+  bool outage = (sc.outageMode != "off");
+  if (outage && sc.outageMode != "scheduled" && sc.outageMode != "poisson")
+  {
+    NS_FATAL_ERROR ("Unknown outage.mode: " << sc.outageMode);
+  }
+  if (outage && sc.outagePolicy != "buffer" && sc.outagePolicy != "drop")
+  {
+    NS_FATAL_ERROR ("Unknown outage.policy: " << sc.outagePolicy);
+  }
+  if (outage && sc.outageDist != "fixed" && sc.outageDist != "exp" && sc.outageDist != "uniform")
+  {
+    NS_FATAL_ERROR ("Unknown outage.dist: " << sc.outageDist);
+  }
+  if (outage && sc.accessMode != "p2p" && sc.accessMode != "cell")
+  {
+    NS_FATAL_ERROR ("outage.mode needs access.mode = p2p or cell, not " << sc.accessMode);
+  }
+  std::vector<bool> outageUser (users.size (), outage && sc.outageUsers == "all");
+  if (outage && sc.outageUsers != "all")
+  {
+    std::stringstream us (sc.outageUsers);
+    std::string u;
+    while (std::getline (us, u, ','))
+    {
+      if (u.empty ()) continue;
+      uint32_t k = std::stoul (u);
+      if (k >= users.size ())
+      {
+        NS_FATAL_ERROR ("outage.users: no user " << k);
+      }
+      outageUser[k] = true;
+    }
+  }
+  bool singleP2p     = (users.size () == 1 && sc.accessMode == "p2p");
+  if (sc.bgMode != "off" && sc.bgMode != "fluid" && sc.bgMode != "packet")
+  {
+    NS_FATAL_ERROR ("Unknown background.mode: " << sc.bgMode);
+  }
+  bool bgFluid = (sc.bgMode == "fluid");
+  if (bgFluid && (sc.qdisc == "edf" || sc.qdisc == "prio"))
+  {
+    NS_FATAL_ERROR ("background.mode = fluid is a FIFO bottleneck, use qdisc default or droptail");
+  }
+  if (bgFluid && (sc.gso || (singleP2p && outageUser[0]) || (sc.forkAt > 0.0 && sc.forkParam == "queue")))
+  {
+    NS_FATAL_ERROR ("background.mode = fluid does not combine with --gso, bottleneck outages or --forkParam=queue");
+  }
+  // fluid 背景时 bottleneck 下行的排队全在 FluidBgQueueDisc 里，设备队列同样只留 1p
+  bool bottleneckOwn = ownQdisc || (singleP2p && outageUser[0]) || bgFluid;
 
-class VrUplinkReceiver : public Application
-{
-public:
-  std::vector<uint32_t> m_delays;
+  OutageProcess outages;
+  outages.Setup (sc.outageDist, sc.outageDuration, sc.outageInterval, sc.outagePolicy == "drop");
 
-private:
-  virtual void StartApplication() override
+  // point-to-point bottleneck
+  // droptail/edf/outage gate: 设备队列只留 1 个包，--queue 限制的是 queue disc，
+  // 排队都发生在 disc 里，调度顺序（和 outage 时的停发）才起作用
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute ("DataRate", StringValue (sc.bottleneckRate));
+  p2p.SetChannelAttribute ("Delay",   StringValue (sc.bottleneckDelay));
+  p2p.SetQueue("ns3::DropTailQueue<Packet>",
+             "MaxSize", QueueSizeValue(QueueSize(bottleneckOwn ? "1p" : sc.queueSize)));
+
+  // several sessions per headset: one receiver app and socket per node
+  // (dlPort) and one uplink receiver on the server (ulPort) demultiplex on
+  // the session ID; session of headset i, slot k = i * sessions + k
+  uint32_t perNode = std::max<uint32_t> (sc.sessions, 1);
+  bool     demux   = perNode > 1;
+  if (demux && sc.transport == "tcp")
   {
-    Ptr<Socket> s =
-      Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
-    s->Bind(InetSocketAddress(Ipv4Address::GetAny(), 6000));
-    s->SetRecvCallback(MakeCallback(&VrUplinkReceiver::HandleRead, this));
-    m_socket = s;
+    // 一个 listen socket 上多条连接共用一个重组缓冲区，分不开
+    NS_FATAL_ERROR ("--sessions > 1 needs transport udp or quic");
   }
+  uint32_t vrHdr = demux ? VrSessionHeader ().GetSerializedSize () : VrHeader ().GetSerializedSize ();
 
-  void HandleRead(Ptr<Socket> socket)
+  // uplink i 用 ulPort + i：最后一个端口不能越界，也不能落到 downlink / background
+  // 上（[CLASS] 按端口分类）
+  uint32_t ulPorts = demux ? 1 : users.size ();
+  if ((uint32_t) sc.ulPort + ulPorts - 1 > 65535)
   {
-    Address from;
-    Ptr<Packet> p = socket->RecvFrom(from);
-    if (!p) return;
+    NS_FATAL_ERROR ("uplink.port " << sc.ulPort << " + " << users.size () << " users exceeds 65535");
+  }
+  for (uint16_t other : {sc.dlPort, sc.bgPort})
+  {
+    if (other == sc.bgPort && sc.bgMode != "packet") continue;
+    if (other >= sc.ulPort && other < (uint32_t) sc.ulPort + ulPorts)
+    {
+      NS_FATAL_ERROR ("uplink ports " << sc.ulPort << ".." << sc.ulPort + ulPorts - 1
+                      << " overlap port " << other);
+    }
+  }
 
-    UplinkHeader hdr;
-    p->RemoveHeader(hdr);
+  if ((sc.gso || sc.gro) && sc.transport == "tcp")
+  {
+    NS_FATAL_ERROR ("--gso/--gro need transport udp or quic");
+  }
+  if (sc.gso && sc.batch)
+  {
+    NS_FATAL_ERROR ("--gso and --batch are alternative send paths, pick one");
+  }
+  uint32_t gsoSegs = std::min<uint32_t> (sc.gso, 65507 / (sc.pktSize + vrHdr));
+  uint32_t gsoSegBytes = sc.pktSize + vrHdr + 8 + 20 + 2;   // + UDP + IPv4 + PPP
+  NetDeviceContainer devs = sc.gso ? InstallGsoBottleneck (sc, nodes, bottleneckOwn, gsoSegs, gsoSegBytes)
+                                   : p2p.Install (nodes);
 
-    uint32_t sendTs = hdr.GetTs();
-    uint32_t now    = Simulator::Now().GetMilliSeconds();
-    m_delays.push_back(now - sendTs);
+  // optional: emulate wireless/last-hop loss on receiver side
+  // loss fork 需要 error model 从一开始就在，分支后只改 ErrorRate
+  Ptr<RateErrorModel> em;
+  if (sc.loss > 0.0 || (sc.forkAt > 0.0 && sc.forkParam == "loss"))
+  {
+    em = CreateObject<RateErrorModel> ();
+    em->SetAttribute ("ErrorRate", DoubleValue (sc.loss));
+    devs.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
   }
 
-  Ptr<Socket> m_socket;
-};
+  InternetStackHelper stack;
+  stack.Install (nodes);
 
-//
-// 5. main: build 2-node topology and run AR/VR traffic
-//
-int
-main (int argc, char *argv[])
-{
-  std::string transport       = "udp";
-  std::string tcpType         = "cubic";   // or "bbr"
-  std::string bottleneckRate  = "100Mbps";
-  std::string bottleneckDelay = "10ms";
-  std::string queueSize       = "100p";
-  uint32_t    deadlineMs      = 50;
-  double      loss            = 0.0;
-  uint32_t    frameSize       = 90000;  
+  // queue disc on every p2p link (bottleneck both directions, then the
+  // access hops); must exist before Assign(), otherwise Ipv4AddressHelper
+  // installs the ns-3 default one. qdiscs[0] / [1] = bottleneck dl / ul.
+  // user >= 0: headset link of that user, wrapped in an outage gate if the
+  // user has outages (qdisc "default" then means a FIFO of --queue)
+  std::vector<Ptr<QueueDisc>> qdiscs;
+  auto installQdisc = [&] (Ptr<NetDevice> dev, int32_t user) {
+    Ptr<QueueDisc> q;
+    if (sc.qdisc == "edf")
+    {
+      Ptr<VrEdfQueueDisc> edf = CreateObject<VrEdfQueueDisc> ();
+      edf->Setup (sc.deadlineMs, sc.dlPort);
+      q = edf;
+    }
+    else if (sc.qdisc == "prio")
+    {
+      q = CreateObject<VrPrioQueueDisc> ();
+    }
+    else
+    {
+      q = CreateObject<FifoQueueDisc> ();
+    }
+    q->SetMaxSize (QueueSize (sc.queueSize));
+    qdiscs.push_back (q);
 
-  CommandLine cmd;
-  cmd.AddValue ("transport", "Transport protocol: udp or tcp", transport);
-  cmd.AddValue ("tcp",       "tcp type: cubic or bbr",         tcpType);
-  cmd.AddValue ("rate",      "Bottleneck data rate",           bottleneckRate);
-  cmd.AddValue ("delay",     "Bottleneck delay",               bottleneckDelay);
-  cmd.AddValue ("deadline",  "Per-frame deadline (ms)",        deadlineMs);
-  cmd.AddValue ("loss",      "Packet loss rate [0..1.0]",      loss);
-  cmd.AddValue ("frameSize", "Downlink frame size in bytes",   frameSize);
-  cmd.AddValue ("queue",     "queue buffer size",              queueSize);
-  cmd.Parse (argc, argv);
+    if (user >= 0 && outageUser[user])
+    {
+      Ptr<OutageQueueDisc> gate = CreateObject<OutageQueueDisc> ();
+      gate->SetChild (q);
+      outages.AddGate (user, gate);
+      q = gate;
+    }
+    dev->GetNode ()->GetObject<TrafficControlLayer> ()->SetRootQueueDiscOnDevice (dev, q);
+  };
+  Ptr<FluidBgQueueDisc> bg;
+  for (uint32_t i = 0; i < devs.GetN () && bottleneckOwn; ++i)
+  {
+    if (i == 0 && bgFluid)
+    {
+      // 共享 buffer 按字节：--queue 个 1500B
+      QueueSize qs (sc.queueSize);
+      uint64_t bytes = qs.GetUnit () == QueueSizeUnit::PACKETS ? qs.GetValue () * 1500ULL : qs.GetValue ();
+      bg = CreateObject<FluidBgQueueDisc> ();
+      bg->Setup (DataRate (sc.bottleneckRate), bytes, sc.bgFlows, DataRate (sc.bgRate), sc.bgOn, sc.bgOff);
+      server->GetObject<TrafficControlLayer> ()->SetRootQueueDiscOnDevice (devs.Get (0), bg);
+      qdiscs.push_back (bg);
+      Simulator::Schedule (Seconds (0), &FluidBgQueueDisc::Start, bg);
+      continue;
+    }
+    installQdisc (devs.Get (i), singleP2p ? 0 : -1);
+  }
 
-  NodeContainer nodes;
-  nodes.Create (2);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer ifs = address.Assign (devs);
 
-  // point-to-point bottleneck
-  PointToPointHelper p2p;
-  p2p.SetDeviceAttribute ("DataRate", StringValue (bottleneckRate));
-  p2p.SetChannelAttribute ("Delay",   StringValue (bottleneckDelay));
-  p2p.SetQueue("ns3::DropTailQueue<Packet>",
-             "MaxSize", QueueSizeValue(QueueSize(queueSize)));
+  NodeContainer headsets;
+  std::vector<Ipv4Address> headsetAddr (users.size ());
+  Ptr<AirNetDevice> apDev;   // access.mode = air only
+  Ptr<CellChannel>  cell;    // access.mode = cell only
+  if (users.size () == 1 && sc.accessMode == "p2p")
+  {
+    headsets.Add (nodes.Get (1));
+    headsetAddr[0] = ifs.GetAddress (1);
+  }
+  else if (sc.accessMode == "air")
+  {
+    // shared medium: 所有 headset 和 ap 共用一个 AirChannel，ap 上按 station 排队
+    AirNetDevice::Scheduler sched;
+    if (!AirNetDevice::ParseScheduler (sc.apScheduler, sched))
+    {
+      NS_FATAL_ERROR ("Unknown access.scheduler: " << sc.apScheduler);
+    }
+
+    Ptr<Node> ap = nodes.Get (1);
+    headsets.Create (users.size ());
+    stack.Install (headsets);
+
+    Ptr<AirChannel> air = CreateObject<AirChannel> ();
+    air->SetOverhead (sc.airOverhead);
+
+    apDev = CreateObject<AirNetDevice> ();
+    apDev->SetupAp (sched, sc.apQueue, sc.apQuantum, sc.deadlineMs, sc.dlPort);
+    ap->AddDevice (apDev);
+    apDev->Attach (air);
+
+    NetDeviceContainer airDevs;
+    airDevs.Add (apDev);
+    for (uint32_t i = 0; i < users.size (); ++i)
+    {
+      Ptr<AirNetDevice> sta = CreateObject<AirNetDevice> ();
+      sta->SetupStation (DataRate (users[i].accessRate), Time (users[i].accessDelay), sc.apQueue);
+      headsets.Get (i)->AddDevice (sta);
+      sta->Attach (air);
+      airDevs.Add (sta);
+    }
+
+    Ipv4AddressHelper accessAddr;
+    accessAddr.SetBase ("10.2.0.0", "255.255.0.0");
+    Ipv4InterfaceContainer a = accessAddr.Assign (airDevs);
+
+    Ipv4StaticRoutingHelper routing;
+    routing.GetStaticRouting (server->GetObject<Ipv4> ())->SetDefaultRoute (ifs.GetAddress (1), 1);
+    for (uint32_t i = 0; i < users.size (); ++i)
+    {
+      headsetAddr[i] = a.GetAddress (1 + i);
+      apDev->AddStation (headsetAddr[i], i);
+      routing.GetStaticRouting (headsets.Get (i)->GetObject<Ipv4> ())
+        ->SetDefaultRoute (a.GetAddress (0), 1);
+    }
+  }
+  else if (sc.accessMode == "wifi")
+  {
+    // 802.11ax：AP + 每个 headset 一个 station；走 ARP，路由和 air 一样
+    Ptr<Node> ap = nodes.Get (1);
+    headsets.Create (users.size ());
+    stack.Install (headsets);
+
+    NetDeviceContainer wifiDevs = InstallWifiLastHop (sc, users, ap, headsets);
+
+    Ipv4AddressHelper accessAddr;
+    accessAddr.SetBase ("10.2.0.0", "255.255.0.0");
+    Ipv4InterfaceContainer a = accessAddr.Assign (wifiDevs);
+
+    Ipv4StaticRoutingHelper routing;
+    routing.GetStaticRouting (server->GetObject<Ipv4> ())->SetDefaultRoute (ifs.GetAddress (1), 1);
+    for (uint32_t i = 0; i < users.size (); ++i)
+    {
+      headsetAddr[i] = a.GetAddress (1 + i);
+      routing.GetStaticRouting (headsets.Get (i)->GetObject<Ipv4> ())
+        ->SetDefaultRoute (a.GetAddress (0), 1);
+    }
+  }
+  else if (sc.accessMode == "cell")
+  {
+    // 抽象蜂窝：gNB 在 ap 上，每个 headset 一个 UE；不走 ARP，路由和 air 一样
+    Ptr<Node> ap = nodes.Get (1);
+    headsets.Create (users.size ());
+    stack.Install (headsets);
+
+    cell = CreateObject<CellChannel> ();
+    cell->Setup (sc.cellTti, DataRate (sc.cellDlRate), DataRate (sc.cellUlRate),
+                 sc.cellSrPeriod, sc.cellGrantDelay, sc.cellHarqRtt,
+                 sc.cellBler, sc.cellHarqMax, sc.cellConfiguredGrant, sc.apQueue);
+    outages.SetCell (cell);
+    if (!sc.cellTrace.empty () && !cell->LoadTrace (sc.cellTrace))
+    {
+      NS_FATAL_ERROR ("Cannot read cell.trace " << sc.cellTrace);
+    }
+
+    Ptr<CellNetDevice> gnb = CreateObject<CellNetDevice> ();
+    ap->AddDevice (gnb);
+    gnb->Attach (cell, true, Seconds (0));
+
+    NetDeviceContainer cellDevs;
+    cellDevs.Add (gnb);
+    for (uint32_t i = 0; i < users.size (); ++i)
+    {
+      Ptr<CellNetDevice> ue = CreateObject<CellNetDevice> ();
+      headsets.Get (i)->AddDevice (ue);
+      ue->Attach (cell, false, Time (users[i].accessDelay));
+      cellDevs.Add (ue);
+    }
+
+    Ipv4AddressHelper accessAddr;
+    accessAddr.SetBase ("10.2.0.0", "255.255.0.0");
+    Ipv4InterfaceContainer a = accessAddr.Assign (cellDevs);
 
-  NetDeviceContainer devs = p2p.Install (nodes);
+    Ipv4StaticRoutingHelper routing;
+    routing.GetStaticRouting (server->GetObject<Ipv4> ())->SetDefaultRoute (ifs.GetAddress (1), 1);
+    for (uint32_t i = 0; i < users.size (); ++i)
+    {
+      headsetAddr[i] = a.GetAddress (1 + i);
+      gnb->AddUe (headsetAddr[i], i);
+      routing.GetStaticRouting (headsets.Get (i)->GetObject<Ipv4> ())
+        ->SetDefaultRoute (a.GetAddress (0), 1);
+    }
+  }
+  else if (sc.accessMode == "p2p")
+  {
+    // star: 每个 headset 一条 /30 access 链路挂在 ap 上；
+    // 静态默认路由代替 GlobalRouting，建拓扑是 O(users)
+    Ptr<Node> ap = nodes.Get (1);
+    headsets.Create (users.size ());
+    stack.Install (headsets);
+
+    Ipv4StaticRoutingHelper routing;
+    routing.GetStaticRouting (server->GetObject<Ipv4> ())->SetDefaultRoute (ifs.GetAddress (1), 1);
+
+    PointToPointHelper hop;
+    Ipv4AddressHelper accessAddr;
+    accessAddr.SetBase ("10.2.0.0", "255.255.255.252");
+    for (uint32_t i = 0; i < users.size (); ++i)
+    {
+      bool own = ownQdisc || outageUser[i];
+      hop.SetQueue ("ns3::DropTailQueue<Packet>",
+                    "MaxSize", QueueSizeValue (QueueSize (own ? "1p" : "100p")));
+      hop.SetDeviceAttribute ("DataRate", StringValue (users[i].accessRate));
+      hop.SetChannelAttribute ("Delay",   StringValue (users[i].accessDelay));
+      NetDeviceContainer d = hop.Install (ap, headsets.Get (i));
+      for (uint32_t j = 0; j < d.GetN () && own; ++j)
+      {
+        installQdisc (d.Get (j), i);
+      }
+      Ipv4InterfaceContainer a = accessAddr.Assign (d);
+      accessAddr.NewNetwork ();
 
-  // optional: emulate wireless/last-hop loss on receiver side
-  if (loss > 0.0)
+      headsetAddr[i] = a.GetAddress (1);
+      routing.GetStaticRouting (headsets.Get (i)->GetObject<Ipv4> ())
+        ->SetDefaultRoute (a.GetAddress (0), 1);
+    }
+  }
+  else
   {
-    Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
-    em->SetAttribute ("ErrorRate", DoubleValue (loss));
-    devs.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+    NS_FATAL_ERROR ("Unknown access.mode: " << sc.accessMode);
   }
 
-  InternetStackHelper stack;
-  stack.Install (nodes);
-
-  Ipv4AddressHelper address;
-  address.SetBase ("10.1.1.0", "255.255.255.0");
-  Ipv4InterfaceContainer ifs = address.Assign (devs);
+  // emulation taps: host side .1 (emu-run.sh), simulator side .2; each node
+  // routes the other tap's subnet across the bottleneck
+  Ptr<FdNetDevice> srvTap, hsTap;
+  if (emu)
+  {
+    srvTap = OpenEmuTap (server, sc.emuServerTap);
+    hsTap  = OpenEmuTap (nodes.Get (1), sc.emuHeadsetTap);
+
+    Ipv4AddressHelper tapAddr;
+    tapAddr.SetBase ("10.10.1.0", "255.255.255.0", "0.0.0.2");
+    tapAddr.Assign (NetDeviceContainer (srvTap));
+    tapAddr.SetBase ("10.10.2.0", "255.255.255.0", "0.0.0.2");
+    tapAddr.Assign (NetDeviceContainer (hsTap));
+
+    Ipv4StaticRoutingHelper routing;
+    routing.GetStaticRouting (server->GetObject<Ipv4> ())
+      ->AddNetworkRouteTo (Ipv4Address ("10.10.2.0"), Ipv4Mask ("255.255.255.0"), ifs.GetAddress (1), 1);
+    routing.GetStaticRouting (nodes.Get (1)->GetObject<Ipv4> ())
+      ->AddNetworkRouteTo (Ipv4Address ("10.10.1.0"), Ipv4Mask ("255.255.255.0"), ifs.GetAddress (0), 1);
+  }
 
-  // downlink: VR frames from node0 -> node1
-  //Ptr<Socket> sock = Socket::CreateSocket (nodes.Get (0), UdpSocketFactory::GetTypeId ());
-  if (transport == "tcp")
+  // downlink: VR frames from server -> headset_i
+  if (sc.transport == "tcp")
   {
-      if (tcpType == "bbr")
+      if (sc.tcpType == "bbr")
       {
           Config::SetDefault("ns3::TcpL4Protocol::SocketType",
                             TypeIdValue(ns3::TcpBbr::GetTypeId()));
@@ -653,92 +6290,423 @@ main (int argc, char *argv[])
                             TypeIdValue(ns3::TcpCubic::GetTypeId()));
       }
   }
-
-  Ptr<Socket> sock;
-
-  if (transport == "tcp")
+  else if (sc.transport != "udp" && sc.transport != "quic")
   {
-      sock = Socket::CreateSocket (nodes.Get(0), TcpSocketFactory::GetTypeId());
+      NS_FATAL_ERROR ("Unknown transport: " << sc.transport);
   }
-  else if (transport == "udp" || transport == "quic")
+
+  // 是否启用 QUIC-lite pacing：只有 transport == "quic" 时才开
+  bool usePacing = (sc.transport == "quic");
+  if (sc.batch && sc.transport == "tcp")
   {
-      sock = Socket::CreateSocket (nodes.Get(0), UdpSocketFactory::GetTypeId());
+      NS_FATAL_ERROR ("--batch needs transport udp or quic");
   }
-  else
+
+  std::vector<Ptr<VrDownlinkApp>>    sends;      // per session
+  std::vector<VrSession *>           recvs;      // per session, into recvApps' tables
+  std::vector<Ptr<VrReceiverApp>>    recvApps;   // per headset
+  std::vector<Ptr<VrUplinkReceiver>> ulRecvs;
+
+  for (uint32_t i = 0; i < users.size (); ++i)
   {
-      NS_FATAL_ERROR ("Unknown transport: " << transport);
+    Ptr<Node> headset = headsets.Get (i);
+
+    // emulation: the host process is the sender
+    for (uint32_t k = 0; k < perNode && !emu; ++k)
+    {
+      Ptr<Socket> sock = Socket::CreateSocket (server,
+                                               sc.transport == "tcp" ? TcpSocketFactory::GetTypeId ()
+                                                                     : UdpSocketFactory::GetTypeId ());
+
+      if (dscpVideo) sock->SetIpTos (dscpVideo << 2);
+
+      Ptr<VrDownlinkApp> app = CreateObject<VrDownlinkApp> ();
+      app->Setup (sock, InetSocketAddress (headsetAddr[i], sc.dlPort),
+                  users[i].frameSize,   // frame size
+                  sc.frameInterval,     // frame 间隔
+                  sc.pktSize,           // payload per packet
+                  usePacing,            // 是否启用 pacing
+                  sc.pacingInterval);   // fragment 间 pacing
+      if (demux) app->SetSession (i * perNode + k);
+      if (sc.encoder) app->SetEncoder (encodeTime, sc.encoderSlices);
+      if (sc.batch) app->SetBatch (dscpVideo << 2);
+      if (sc.gso)   app->SetGso (gsoSegs);
+      if (sc.pipeline)
+      {
+        app->SetPipeline (renderTime, sc.renderQueue, sc.sendQueue, sc.pipelineFull == "drop");
+        if (sc.transport != "tcp")
+        {
+          app->SetEgress (DynamicCast<PointToPointNetDevice> (devs.Get (0)), QueueSize (sc.queueSize));
+        }
+      }
+      server->AddApplication (app);
+      app->SetStartTime (users[i].start);
+      app->SetStopTime  (sc.appStop);
+      sends.push_back (app);
+    }
+
+    // receiver: measure on-time frame ratio, one app for all sessions of the node
+    Ptr<VrReceiverApp> recv = CreateObject<VrReceiverApp> ();
+    if (demux) recv->SetSessions (perNode, i * perNode);
+    for (uint32_t k = 0; k < recv->GetSessionCount (); ++k)
+    {
+      VrSession &session = recv->GetSession (k);
+      session.SetDeadlineMs (sc.deadlineMs);
+      session.GetPlayout ().Setup (playoutMode, sc.playoutPolicy == "stall", sc.frameInterval,
+                                   sc.playoutTarget.GetMilliSeconds (), sc.playoutPercentile,
+                                   sc.playoutWindow, sc.playoutK,
+                                   sc.playoutMin.GetMilliSeconds (), sc.playoutMax.GetMilliSeconds (),
+                                   sc.playoutStep.GetMilliSeconds ());
+      if (sc.quality)
+      {
+        session.GetQuality ().Setup (qualityCurve, sc.qualityLayers, sc.pktSize, sc.frameInterval,
+                                     sc.deadlineMs, sc.qualityFreeze);
+      }
+      recvs.push_back (&session);
+    }
+    recv->SetPort (sc.dlPort);
+    recv->SetPacketSize (12 + sc.pktSize);
+    recv->SetTos (dscpAck << 2);
+    headset->AddApplication (recv);
+    recv->SetUseTcp( sc.transport == "tcp" );
+    if (sc.gro) recv->SetGro (sc.groFlush, 65507 / (sc.pktSize + vrHdr));
+    recv->SetPassive (emu);
+    recv->SetStartTime (Seconds (0.0));
+    recv->SetStopTime  (sc.appStop);
+    recvApps.push_back (recv);
+
+    if (emu) continue;   // 真实 headset 自己发上行，这里只统计下行
+
+    // uplink: periodic sensor/control packets, headset_i -> server:ulPort+i;
+    // sessions > 1: every session -> server:ulPort, tagged with its session ID
+    for (uint32_t k = 0; k < perNode; ++k)
+    {
+      uint16_t ulPort = demux ? sc.ulPort : sc.ulPort + i;
+      Ptr<Socket> upSock = Socket::CreateSocket (headset, UdpSocketFactory::GetTypeId ());
+      if (dscpImu) upSock->SetIpTos (dscpImu << 2);
+      Ptr<VrUplinkApp> up = CreateObject<VrUplinkApp> ();
+      up->Setup (upSock,
+                 InetSocketAddress (ifs.GetAddress (0), ulPort),
+                 sc.ulInterval,
+                 sc.ulPktSize);
+      if (demux) up->SetSession (i * perNode + k);
+      headset->AddApplication (up);
+      up->SetStartTime (sc.appStart);
+      up->SetStopTime  (sc.appStop);
+
+      if (demux && !ulRecvs.empty ()) continue;
+      Ptr<VrUplinkReceiver> ulRecv = CreateObject<VrUplinkReceiver>();
+      ulRecv->SetPort (ulPort);
+      if (demux) ulRecv->SetSessions (users.size () * perNode);
+      server->AddApplication(ulRecv);
+      ulRecv->SetStartTime(Seconds(0.0));
+      ulRecv->SetStopTime(sc.appStop);
+      ulRecvs.push_back (ulRecv);
+    }
   }
 
-  Address peer;
-  if (transport == "tcp")
+  // packet-level background: the same on/off process as the fluid one,
+  // `flows` UDP OnOff apps from the server across the bottleneck only
+  Ptr<PacketSink> bgSink;
+  if (sc.bgMode == "packet")
   {
-      peer = InetSocketAddress(ifs.GetAddress(1), 5000);
+    double duty = sc.bgOff.IsZero () ? 1.0 : sc.bgOn.GetSeconds () / (sc.bgOn + sc.bgOff).GetSeconds ();
+    uint64_t peak = sc.bgFlows ? DataRate (sc.bgRate).GetBitRate () / (sc.bgFlows * duty) : 0;
+
+    OnOffHelper onoff ("ns3::UdpSocketFactory", InetSocketAddress (ifs.GetAddress (1), sc.bgPort));
+    onoff.SetConstantRate (DataRate (peak), sc.bgPktSize);
+    if (!sc.bgOff.IsZero ())
+    {
+      std::ostringstream on, off;
+      on  << "ns3::ExponentialRandomVariable[Mean=" << sc.bgOn.GetSeconds () << "]";
+      off << "ns3::ExponentialRandomVariable[Mean=" << sc.bgOff.GetSeconds () << "]";
+      onoff.SetAttribute ("OnTime",  StringValue (on.str ()));
+      onoff.SetAttribute ("OffTime", StringValue (off.str ()));
+    }
+    for (uint32_t f = 0; f < sc.bgFlows; ++f)
+    {
+      ApplicationContainer a = onoff.Install (server);
+      a.Start (Seconds (0));
+      a.Stop (sc.simStop);
+    }
+
+    PacketSinkHelper sink ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), sc.bgPort));
+    ApplicationContainer s = sink.Install (nodes.Get (1));
+    s.Start (Seconds (0));
+    bgSink = DynamicCast<PacketSink> (s.Get (0));
   }
-  else
+
+  // outages are drawn up front; the frame trace tags frames against this log
+  for (uint32_t i = 0; i < users.size (); ++i)
   {
-      peer = InetSocketAddress(ifs.GetAddress(1), 5000);
+    if (!outageUser[i]) continue;
+    if (sc.outageMode == "poisson")
+    {
+      outages.AddPoisson (i, sc.appStart, sc.appStop);
+      continue;
+    }
+    std::stringstream as (sc.outageAt);
+    std::string at;
+    while (std::getline (as, at, ','))
+    {
+      at = TrimScenario (at);
+      if (!at.empty ()) outages.Add (i, Time (at));
+    }
   }
 
-  // 是否启用 QUIC-lite pacing：只有 transport == "quic" 时才开
-  bool usePacing = (transport == "quic");
-
-  // 帧间隔：你之前就是 33ms，这里先保持一致
-  Time frameInterval = MilliSeconds (33);
-
-  Ptr<VrDownlinkApp> app = CreateObject<VrDownlinkApp> ();
-  app->Setup (sock, peer,
-              frameSize,        // frame size
-              frameInterval,    // frame 间隔
-              1200,             // payload per packet
-              usePacing,        // 是否启用 pacing
-              MicroSeconds (200)); // fragment 间 pacing，可以之后自己调
-  nodes.Get (0)->AddApplication (app);
-  app->SetStartTime (Seconds (1.0));
-  app->SetStopTime  (Seconds (10.0));
-
-
-  // receiver: measure on-time frame ratio
-  Ptr<VrReceiverApp> recv = CreateObject<VrReceiverApp> ();
-  recv->SetDeadlineMs (deadlineMs);
-  nodes.Get (1)->AddApplication (recv);
-  recv->SetUseTcp( transport == "tcp" );
-  recv->SetStartTime (Seconds (0.0));
-  recv->SetStopTime  (Seconds (10.0));
-
-
-  // uplink: periodic sensor/control packets, node1 -> node0
-  uint16_t ulPort = 6000;
-  Ptr<Socket> upSock = Socket::CreateSocket (nodes.Get (1), UdpSocketFactory::GetTypeId ());
-  Ptr<VrUplinkApp> up = CreateObject<VrUplinkApp> ();
-  up->Setup (upSock,
-             InetSocketAddress (ifs.GetAddress (0), ulPort),
-             MilliSeconds (10),  // 100 Hz
-             100);               // 100 B
-  nodes.Get (1)->AddApplication (up);
-  up->SetStartTime (Seconds (1.0));
-  up->SetStopTime  (Seconds (10.0));
-
-  // sink for uplink packets on node0
-  /*PacketSinkHelper ulSink ("ns3::UdpSocketFactory",
-                           InetSocketAddress (Ipv4Address::GetAny (), ulPort));
-  ApplicationContainer ulSinkApp = ulSink.Install (nodes.Get (0));
-  ulSinkApp.Start (Seconds (0.0));
-  ulSinkApp.Stop  (Seconds (10.0));
-  */
-
-  Ptr<VrUplinkReceiver> ulRecv = CreateObject<VrUplinkReceiver>();
-  nodes.Get(0)->AddApplication(ulRecv);
-  ulRecv->SetStartTime(Seconds(0.0));
-  ulRecv->SetStopTime(Seconds(10.0));
-
   // collect flow-level stats
   FlowMonitorHelper flowmon;
   Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
 
-  Simulator::Stop (Seconds (20.0));
+  // batched video 不经过 Ipv4L3Protocol，FlowMonitor 看不到；GSO 只记每个
+  // super-packet 的第一个 segment。两种情况 [CLASS] 都自己统计
+  BatchDelayProbe batchProbe;
+  bool videoProbe = sc.batch || sc.gso;
+  if (videoProbe)
+  {
+    for (uint32_t i = 0; i < headsets.GetN (); ++i) batchProbe.Attach (headsets.Get (i));
+  }
+  if (sc.batch)
+  {
+    std::cerr << "[BATCH] video bypasses Ipv4L3Protocol: it is missing from the FlowMonitor XML, "
+              << "[CLASS] video uses send-time tags" << std::endl;
+  }
+  if (sc.gso)
+  {
+    std::cerr << "[GSO] FlowMonitor sees the first segment of each super-packet: the XML video flow "
+              << "under-counts rx, [CLASS] video uses send-time tags" << std::endl;
+  }
+
+  LiveReporter live (recvs, ulRecvs, devs);
+  if (sc.liveInterval > 0.0)
+  {
+    if (sc.forkAt > 0.0)
+    {
+      // 子进程继承同一个 sink fd 和未发出的行：重复输出、t= 相同、socket 上还会交错
+      NS_FATAL_ERROR ("--liveInterval does not combine with --forkAt");
+    }
+    if (!live.Open (sc.liveOut, sc.liveBuffer))
+    {
+      NS_FATAL_ERROR ("Cannot open live sink " << sc.liveOut << ": " << std::strerror (errno));
+    }
+    live.Start (Seconds (sc.liveInterval));
+  }
+
+  EmuMonitor emuMon;
+  if (emu)
+  {
+    emuMon.Setup (recvApps[0], sc.dlPort, sc.appStop, sc.emuProbe, sc.emuMaxLag);
+    srvTap->TraceConnectWithoutContext ("MacRx", MakeCallback (&EmuMonitor::OnIngress, &emuMon));
+    hsTap->TraceConnectWithoutContext ("MacTx", MakeCallback (&EmuMonitor::OnEgress, &emuMon));
+    Simulator::Schedule (Seconds (0), &EmuMonitor::Start, &emuMon);
+    // emu-run.sh 等这一行：tap 已打开，可以挪进 namespace、启动主机进程
+    std::cout << "[EMU] ready serverTap=" << sc.emuServerTap
+              << " headsetTap=" << sc.emuHeadsetTap
+              << " server=10.10.1.1 headset=10.10.2.1:" << sc.dlPort
+              << std::endl;
+  }
+
+  // header-only pcap on both bottleneck ends; ring 只在丢帧附近落盘
+  PcapRing pcap;
+  uint32_t pcapSnaplen = sc.pcapSnaplen ? sc.pcapSnaplen
+                                        : (sc.transport == "tcp" ? 2 + 20 + 60 : 2 + 20 + 8 + vrHdr);
+  if (sc.pcapMode != "off")
+  {
+    if (sc.pcapMode != "all" && sc.pcapMode != "ring")
+    {
+      NS_FATAL_ERROR ("Unknown pcap.mode: " << sc.pcapMode);
+    }
+    if (sc.pcapMode == "ring" && (sc.transport == "tcp" || emu || demux))
+    {
+      // 触发靠 VrHeader 的 sendTsMs：tcp 分片不对齐，emulation 里是主机时钟；
+      // 多 session 时 (dst, frameId) 不再唯一
+      NS_FATAL_ERROR ("pcap.mode = ring needs simulated udp/quic senders (not tcp, not --emu, one session per headset)");
+    }
+    if (sc.forkAt > 0.0)
+    {
+      NS_FATAL_ERROR ("--pcap does not combine with --forkAt");
+    }
+    pcap.Setup (sc.pcapMode == "ring",
+                sc.pcapPrefix.empty () ? sc.outDir + "/arvr-pcap" : sc.pcapPrefix,
+                pcapSnaplen, sc.pcapPre, sc.pcapPost, sc.pcapFiles, sc.deadlineMs, sc.dlPort);
+    devs.Get (0)->TraceConnectWithoutContext ("PromiscSniffer", MakeCallback (&PcapRing::OnServer, &pcap));
+    devs.Get (1)->TraceConnectWithoutContext ("PromiscSniffer", MakeCallback (&PcapRing::OnHeadset, &pcap));
+  }
+
+  auto wallSetup = std::chrono::steady_clock::now ();
+  std::cout << "[SETUP] users=" << users.size ()
+            << " parseMs=" << std::chrono::duration<double, std::milli> (wallParsed - wallStart).count ()
+            << " setupMs=" << std::chrono::duration<double, std::milli> (wallSetup - wallParsed).count ()
+            << std::endl;
+
+  //
+  // fork-from-warm-state: simulate [0, forkAt) once, then fork() one worker
+  // per swept value. Each child (copy-on-write copy of the warm simulator)
+  // changes only --forkParam and continues on the normal path below; the
+  // parent just waits. XML names differ per value and manifest.csv appends
+  // are locked, so the workers can write side by side.
+  //
+  std::string forkTag;
+  if (sc.forkAt > 0.0)
+  {
+    if (sc.forkParam != "loss" && sc.forkParam != "deadline" && sc.forkParam != "queue")
+    {
+      NS_FATAL_ERROR ("Unknown forkParam: " << sc.forkParam);
+    }
+    if (sc.forkParam == "deadline" && sc.quality)
+    {
+      // 分支时已排好的 Score 事件还用 warm-up 的 deadline，结果和从头跑不一致
+      NS_FATAL_ERROR ("--forkParam=deadline does not combine with --qoe");
+    }
+
+    std::vector<std::string> values;
+    std::stringstream vs (sc.forkValues);
+    std::string v;
+    while (std::getline (vs, v, ','))
+    {
+      if (!v.empty ()) values.push_back (v);
+    }
+    if (values.empty ())
+    {
+      NS_FATAL_ERROR ("--forkAt needs --forkValues");
+    }
+    if (sc.forkJobs == 0)
+    {
+      sc.forkJobs = std::max<long> (1, sysconf (_SC_NPROCESSORS_ONLN));
+    }
+
+    Simulator::Stop (Seconds (sc.forkAt));
+    Simulator::Run ();
+
+    // 不 flush 的话，缓冲区里的输出会被每个子进程重复打印
+    std::cout.flush ();
+    std::cerr.flush ();
+
+    uint32_t running = 0;
+    uint32_t failed  = 0;
+    bool     isChild = false;
+    auto reap = [&] () {
+      int status = 0;
+      if (wait (&status) > 0)
+      {
+        running -= 1;
+        if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) failed += 1;
+      }
+    };
+
+    for (const std::string &value : values)
+    {
+      while (running >= sc.forkJobs) reap ();
+
+      pid_t pid = fork ();
+      if (pid < 0)
+      {
+        NS_FATAL_ERROR ("fork failed: " << std::strerror (errno));
+      }
+      if (pid == 0)
+      {
+        if (sc.forkParam == "loss")
+        {
+          sc.loss = std::stod (value);
+          em->SetAttribute ("ErrorRate", DoubleValue (sc.loss));
+        }
+        else if (sc.forkParam == "deadline")
+        {
+          sc.deadlineMs = std::stoul (value);
+          for (VrSession *recv : recvs)
+          {
+            recv->SetDeadlineMs (sc.deadlineMs);
+          }
+          for (const Ptr<QueueDisc> &q : qdiscs)
+          {
+            Ptr<VrEdfQueueDisc> edf = DynamicCast<VrEdfQueueDisc> (q);
+            if (edf) edf->SetDeadlineMs (sc.deadlineMs);
+          }
+          if (apDev) apDev->SetDeadlineMs (sc.deadlineMs);
+        }
+        else
+        {
+          sc.queueSize = value;
+          for (const Ptr<QueueDisc> &q : qdiscs)
+          {
+            q->SetMaxSize (QueueSize (sc.queueSize));
+          }
+          for (uint32_t i = 0; i < devs.GetN () && !bottleneckOwn; ++i)
+          {
+            DynamicCast<PointToPointNetDevice> (devs.Get (i))->GetQueue ()
+              ->SetMaxSize (QueueSize (sc.queueSize));
+          }
+        }
+        forkTag = " fork=" + sc.forkParam + ":" + value;
+        if (!sc.frameTrace.empty ())
+        {
+          sc.frameTrace += "." + sc.forkParam + "-" + value;   // 每个 worker 一个文件
+        }
+        isChild = true;
+        break;
+      }
+      running += 1;
+    }
+
+    if (!isChild)
+    {
+      while (running > 0) reap ();
+      std::cout << "[FORK] warmup=" << sc.forkAt << "s workers=" << values.size ()
+                << " failed=" << failed << std::endl;
+      Simulator::Destroy ();
+      return failed ? 1 : 0;
+    }
+  }
+
+  auto wallRun = std::chrono::steady_clock::now ();
+  Simulator::Stop (sc.simStop - Simulator::Now ());
   Simulator::Run ();
+  live.Close ();
+
+  // 仿真本身的墙钟耗时：比较 p2p / air / wifi / wifiFast 的速度
+  std::cout << "[RUN] phy=" << sc.accessMode
+            << " wallMs=" << std::chrono::duration<double, std::milli> (
+                               std::chrono::steady_clock::now () - wallRun).count ()
+            << " events=" << Simulator::GetEventCount ()
+            << forkTag
+            << std::endl;
 
-  auto &m_delays = ulRecv->m_delays;
+  if (emu)
+  {
+    // lag = 墙钟 - 仿真时间；misses = 落后超过 maxLag 的 probe
+    std::cout << "[EMU] probes=" << emuMon.GetProbes ()
+              << " lagP50Us=" << emuMon.GetLagUs (0.5)
+              << " lagP99Us=" << emuMon.GetLagUs (0.99)
+              << " lagMaxUs=" << emuMon.GetLagUs (1.0)
+              << " maxLagUs=" << sc.emuMaxLag.GetMicroSeconds ()
+              << " misses=" << emuMon.GetMisses ()
+              << " inPkts=" << emuMon.GetInPkts ()
+              << " inMbps=" << emuMon.GetInMbps ()
+              << " outPkts=" << emuMon.GetOutPkts ()
+              << " vrPkts=" << emuMon.GetVrPkts ()
+              << std::endl;
+  }
+
+  if (sc.pcapMode != "off")
+  {
+    // bytes = 记录头 + 截断后的包，不含每个文件 24B 的文件头
+    pcap.Stop ();
+    std::cout << "[PCAP] mode=" << sc.pcapMode
+              << " snaplen=" << pcapSnaplen
+              << " triggers=" << pcap.GetTriggers ()
+              << " captures=" << pcap.GetCaptures ()
+              << " kept=" << pcap.GetKept ()
+              << " records=" << pcap.GetRecords ()
+              << " bytes=" << pcap.GetBytes ()
+              << std::endl;
+  }
+
+  // 所有用户的上行 delay 合在一起统计
+  std::vector<uint32_t> m_delays;
+  for (const Ptr<VrUplinkReceiver> &ulRecv : ulRecvs)
+  {
+    m_delays.insert (m_delays.end (), ulRecv->m_delays.begin (), ulRecv->m_delays.end ());
+  }
 
   if (!m_delays.empty()) {
       uint64_t sum = 0;
@@ -764,25 +6732,44 @@ main (int argc, char *argv[])
 
 
 
-  std::ostringstream oss;
-  oss << "arvr_"
-        << "tx-"        << transport
-        << "_tcp-"      << tcpType
-        << "_rate-"     << bottleneckRate
-        << "_delay-"    << bottleneckDelay
-        << "_loss-"     << loss
-        << "_deadline-" << deadlineMs
-        << "_fs-"       << frameSize
-        << "_queue-"    << queueSize
-        << ".xml";
+  // print values (summed over users)
+  uint32_t total      = 0;
+  uint32_t ontime     = 0;
+  uint32_t late       = 0;
+  uint32_t incomplete = 0;
+  uint32_t worstUser  = 0;
+  double   worstRatio = 1.0;
 
-  monitor->SerializeToXmlFile (oss.str (), true, true);
+  for (uint32_t i = 0; i < recvs.size (); ++i)
+  {
+    const VrSession *recv = recvs[i];
+    uint32_t t = recv->GetTotalFrames ();
+    double   r = t ? (double) recv->GetOnTimeFrames () / t : 0.0;
+
+    total      += t;
+    ontime     += recv->GetOnTimeFrames ();
+    late       += recv->GetLateFrames ();
+    incomplete += recv->GetIncompleteFrames ();
+
+    if (r < worstRatio || i == 0)
+    {
+      worstRatio = r;
+      worstUser  = i;
+    }
 
-  // print values
-  uint32_t total      = recv->GetTotalFrames ();
-  uint32_t ontime     = recv->GetOnTimeFrames ();
-  uint32_t late       = recv->GetLateFrames ();
-  uint32_t incomplete = recv->GetIncompleteFrames ();
+    if (recvs.size () > 1)
+    {
+      std::cout << "[VR-USER] user=" << i / perNode;
+      if (demux) std::cout << " session=" << i;
+      std::cout << " total=" << t
+                << " onTime=" << recv->GetOnTimeFrames ()
+                << " late=" << recv->GetLateFrames ()
+                << " incomplete=" << recv->GetIncompleteFrames ()
+                << " ratio=" << r
+                << forkTag
+                << std::endl;
+    }
+  }
 
   double ratio = total ? (double)ontime / total : 0.0;
 
@@ -791,8 +6778,525 @@ main (int argc, char *argv[])
             << " late=" << late
             << " incomplete=" << incomplete
             << " ratio=" << ratio
+            << forkTag
             << std::endl;
 
+  if (demux)
+  {
+    // 每个节点一个 receiver app / socket；unknown = session ID 不在表里的包
+    uint64_t dlUnknown = 0;
+    for (const Ptr<VrReceiverApp> &recv : recvApps) dlUnknown += recv->GetUnknownSessionPkts ();
+    uint32_t ulMin = 0;
+    uint64_t ulUnknown = 0;
+    for (const Ptr<VrUplinkReceiver> &ulRecv : ulRecvs)
+    {
+      ulUnknown += ulRecv->GetUnknownSessionPkts ();
+      const std::vector<VrUplinkReceiver::Session> &ss = ulRecv->GetSessions ();
+      for (size_t k = 0; k < ss.size (); ++k)
+      {
+        if (k == 0 || ss[k].pkts < ulMin) ulMin = ss[k].pkts;
+      }
+    }
+    std::cout << "[SESSION] sessions=" << recvs.size ()
+              << " perNode=" << perNode
+              << " recvApps=" << recvApps.size ()
+              << " ulRecvApps=" << ulRecvs.size ()
+              << " hdrBytes=" << vrHdr
+              << " dlUnknown=" << dlUnknown
+              << " ulUnknown=" << ulUnknown
+              << " ulMinPkts=" << ulMin
+              << forkTag
+              << std::endl;
+  }
+
+  if (sc.encoder)
+  {
+    DelaySketch enc;
+    for (const Ptr<VrDownlinkApp> &app : sends) enc.Merge (app->GetEncodeTime ());
+    std::cout << "[ENCODER] dist=" << sc.encoderDist
+              << " slices=" << sc.encoderSlices
+              << " frames=" << enc.GetCount ()
+              << " encAvg=" << enc.GetMean ()
+              << " encP99=" << enc.GetQuantile (0.99)
+              << " encMax=" << enc.GetMax ()
+              << forkTag
+              << std::endl;
+  }
+
+  if (sc.pipeline)
+  {
+    VrDownlinkApp::PipelineStats ps;
+    for (const Ptr<VrDownlinkApp> &app : sends) app->AddPipelineStats (ps);
+
+    // 从下游往上找：哪一级前面在排队，瓶颈就在哪一级。send 本身的时长不算
+    // （quic 的 pacing 每帧都要几 ms），只看帧在 send 前等了多久
+    std::string neck = "none";
+    if (ps.sendWait.GetMean () >= 1.0)        neck = "network";
+    else if (ps.renderWait.GetMean () >= 1.0) neck = "encode";
+    else if (ps.skippedTicks > 0)             neck = "render";
+
+    std::cout << "[PIPELINE] frames=" << ps.frames
+              << " skippedTicks=" << ps.skippedTicks
+              << " queueDrops=" << ps.queueDrops
+              << " renderAvg=" << ps.render.GetMean ()
+              << " renderWaitAvg=" << ps.renderWait.GetMean ()
+              << " renderWaitP99=" << ps.renderWait.GetQuantile (0.99)
+              << " encodeAvg=" << ps.encode.GetMean ()
+              << " sendWaitAvg=" << ps.sendWait.GetMean ()
+              << " sendWaitP99=" << ps.sendWait.GetQuantile (0.99)
+              << " sendAvg=" << ps.send.GetMean ()
+              << " sendP99=" << ps.send.GetQuantile (0.99)
+              << " bottleneck=" << neck
+              << forkTag
+              << std::endl;
+  }
+
+  if (sc.bgMode != "off")
+  {
+    // 背景本身的收支；对 VR 的影响看 [VR-RECV]，速度看 [RUN]
+    double secs = Simulator::Now ().GetSeconds ();
+    std::cout << "[BG] mode=" << sc.bgMode
+              << " rate=" << sc.bgRate
+              << " flows=" << sc.bgFlows;
+    if (bg)
+    {
+      bg->Finish ();
+      std::cout << " offeredMbps=" << bg->GetOfferedBytes () * 8 / secs / 1e6
+                << " dropFrac=" << (bg->GetOfferedBytes () > 0 ? bg->GetDroppedBytes () / bg->GetOfferedBytes () : 0.0)
+                << " fgPkts=" << bg->GetPackets ()
+                << " fgDrops=" << bg->GetStats ().nTotalDroppedPackets
+                << " fgWaitAvg=" << bg->GetWaitAvgMs ()
+                << " fgWaitMax=" << bg->GetWaitMaxMs ();
+    }
+    if (bgSink)
+    {
+      std::cout << " rxMbps=" << bgSink->GetTotalRx () * 8 / secs / 1e6;
+    }
+    std::cout << forkTag << std::endl;
+  }
+
+  if (sc.gso || sc.gro)
+  {
+    // 速度看 [RUN] wallMs/events；排队效应看设备队列的峰值（--gso=1 = 不合并的基线）
+    DelaySketch frames;
+    for (const VrSession *recv : recvs) frames.Merge (recv->GetDelaySketch ());
+    std::cout << "[GSO] segs=" << gsoSegs
+              << " frameP50=" << frames.GetQuantile (0.5)
+              << " frameP99=" << frames.GetQuantile (0.99);
+    if (sc.gso)
+    {
+      Ptr<GsoNetDevice> gd = DynamicCast<GsoNetDevice> (devs.Get (0));
+      std::cout << " superPkts=" << gd->GetSuperPackets ()
+                << " segments=" << gd->GetSegments ()
+                << " segsPerSuper=" << (gd->GetSuperPackets () ? double (gd->GetSegments ()) / gd->GetSuperPackets () : 0.0)
+                << " devQueuePeak=" << gd->GetQueuePeak ()
+                << " devDrops=" << gd->GetQueue ()->GetTotalDroppedPackets ();
+    }
+    if (sc.gro)
+    {
+      uint64_t deliveries = 0, segments = 0;
+      for (const Ptr<VrReceiverApp> &recv : recvApps)
+      {
+        deliveries += recv->GetGroDeliveries ();
+        segments   += recv->GetGroSegments ();
+      }
+      std::cout << " groFlushUs=" << sc.groFlush.GetMicroSeconds ()
+                << " groDeliveries=" << deliveries
+                << " groSegments=" << segments
+                << " segsPerDelivery=" << (deliveries ? double (segments) / deliveries : 0.0);
+    }
+    std::cout << forkTag << std::endl;
+  }
+
+  if (playoutMode != PlayoutBuffer::OFF)
+  {
+    // 所有用户合并；stallRatio = 停顿时间 / 播放时长
+    uint32_t displayed = 0, skipped = 0, stalls = 0;
+    uint64_t stallMs = 0;
+    double   targetSum = 0;
+    DelaySketch e2e;
+    for (const VrSession *recv : recvs)
+    {
+      const PlayoutBuffer &pb = recv->GetPlayout ();
+      displayed += pb.GetDisplayed ();
+      skipped   += pb.GetSkipped ();
+      stalls    += pb.GetStalls ();
+      stallMs   += pb.GetStallMs ();
+      targetSum += pb.GetTargetSum ();
+      e2e.Merge (pb.GetE2e ());
+    }
+    double playMs = (sc.appStop - sc.appStart).GetMilliSeconds () * (double) recvs.size ();
+    std::cout << "[PLAYOUT] mode=" << sc.playoutMode
+              << " policy=" << sc.playoutPolicy
+              << " displayed=" << displayed
+              << " skipped=" << skipped
+              << " stalls=" << stalls
+              << " stallMs=" << stallMs
+              << " stallRatio=" << (playMs > 0 ? stallMs / playMs : 0.0)
+              << " targetAvg=" << (displayed ? targetSum / displayed : 0.0)
+              << " e2eAvg=" << e2e.GetMean ()
+              << " e2eP50=" << e2e.GetQuantile (0.50)
+              << " e2eP95=" << e2e.GetQuantile (0.95)
+              << " e2eP99=" << e2e.GetQuantile (0.99)
+              << forkTag
+              << std::endl;
+  }
+
+  if (sc.quality)
+  {
+    uint32_t frames = 0, frozen = 0, freezes = 0, switches = 0;
+    double   scoreSum = 0;
+    DelaySketch scores;
+    for (const VrSession *recv : recvs)
+    {
+      const QualityModel &qm = recv->GetQuality ();
+      frames   += qm.GetFrames ();
+      frozen   += qm.GetFrozenFrames ();
+      freezes  += qm.GetFreezes ();
+      switches += qm.GetSwitches ();
+      scoreSum += qm.GetScoreSum ();
+      scores.Merge (qm.GetScores ());
+    }
+    std::cout << "[QOE] frames=" << frames
+              << " score=" << (frames ? scoreSum / frames : 0.0)
+              << " scoreP5=" << scores.GetQuantile (0.05)
+              << " freezeRatio=" << (frames ? (double) frozen / frames : 0.0)
+              << " freezes=" << freezes
+              << " switches=" << switches
+              << " layers=" << sc.qualityLayers
+              << forkTag
+              << std::endl;
+  }
+
+  if (apDev)
+  {
+    std::cout << "[AP] scheduler=" << sc.apScheduler
+              << " users=" << users.size ()
+              << " drops=" << apDev->GetDrops ()
+              << forkTag
+              << std::endl;
+  }
+
+  if (cell)
+  {
+    // grant 等待 = 上行包到达空 buffer 到拿到 grant，直接加在 [UL-IMU] 的 delay 上
+    const DelaySketch &gw = cell->GetGrantWait ();
+    std::cout << "[CELL] tbs=" << cell->GetTbs ()
+              << " harqRetx=" << cell->GetHarqRetx ()
+              << " harqLost=" << cell->GetHarqLost ()
+              << " drops=" << cell->GetDrops ()
+              << " grants=" << cell->GetGrants ()
+              << " grantWaitAvg=" << gw.GetMean ()
+              << " grantWaitP99=" << gw.GetQuantile (0.99)
+              << " grantWaitMax=" << gw.GetMax ()
+              << forkTag
+              << std::endl;
+  }
+
+  if (ownQdisc)
+  {
+    // [0] = server 侧（下行），[1] = 对端（上行）
+    const char *expired = VrEdfQueueDisc::EXPIRED_DROP;
+    std::cout << "[QDISC] type=" << sc.qdisc
+              << " dlDrops=" << qdiscs[0]->GetStats ().nTotalDroppedPackets
+              << " dlExpired=" << qdiscs[0]->GetStats ().GetNDroppedPackets (expired)
+              << " ulDrops=" << qdiscs[1]->GetStats ().nTotalDroppedPackets
+              << " ulExpired=" << qdiscs[1]->GetStats ().GetNDroppedPackets (expired)
+              << forkTag
+              << std::endl;
+  }
+
+  // frame trace + per-outage impact
+  //   a frame is affected by an outage of its user if [send, send + deadline]
+  //   overlaps the outage; recovery = first on-time frame sent at or after
+  //   the outage start completes, measured from the outage end
+  if (outage || !sc.frameTrace.empty ())
+  {
+    struct OutageImpact
+    {
+      uint32_t frames = 0, onTime = 0, late = 0, incomplete = 0, missing = 0;
+      int64_t  recoveryMs = -1;   // -1 = no on-time frame afterwards
+    };
+    const std::vector<OutageProcess::Outage> &log = outages.GetOutages ();
+    std::vector<OutageImpact> impact (log.size ());
+    const char *statusName[] = {"missing", "onTime", "late", "incomplete"};
+    int64_t stopMs = sc.appStop.GetMilliSeconds ();
+
+    std::ostringstream trace;
+    // sessions > 1: one row per session and frame, session ID in the last column
+    trace << "user,frame,sendMs,status,delayMs,outage" << (demux ? ",session\n" : "\n");
+    for (uint32_t i = 0; i < sends.size (); ++i)
+    {
+      uint32_t user = i / perNode;
+      const std::vector<uint32_t> &sendMs = sends[i]->GetFrameSendMs ();
+      for (uint32_t fid = 0; fid < sendMs.size () && sendMs[fid] < stopMs; ++fid)
+      {
+        uint32_t delay = 0;
+        VrSession::FrameStatus st = recvs[i]->GetFrameStatus (fid, delay);
+        int64_t from = sendMs[fid];
+        int64_t tag  = -1;
+        for (const OutageProcess::Outage &o : log)
+        {
+          if (o.user != user) continue;
+          OutageImpact &im = impact[o.id];
+          if (from <= o.end.GetMilliSeconds () && from + sc.deadlineMs >= o.start.GetMilliSeconds ())
+          {
+            if (tag < 0) tag = o.id;
+            im.frames += 1;
+            if      (st == VrSession::FRAME_ONTIME)     im.onTime += 1;
+            else if (st == VrSession::FRAME_LATE)       im.late += 1;
+            else if (st == VrSession::FRAME_INCOMPLETE) im.incomplete += 1;
+            else                                            im.missing += 1;
+          }
+          if (st == VrSession::FRAME_ONTIME && im.recoveryMs < 0
+              && from >= o.start.GetMilliSeconds ())
+          {
+            im.recoveryMs = std::max<int64_t> (0, from + delay - o.end.GetMilliSeconds ());
+          }
+        }
+
+        trace << user << ',' << fid << ',' << from << ',' << statusName[st] << ',';
+        if (st == VrSession::FRAME_ONTIME || st == VrSession::FRAME_LATE) trace << delay;
+        trace << ',';
+        if (tag >= 0) trace << tag;
+        if (demux) trace << ',' << i;
+        trace << '\n';
+      }
+    }
+
+    if (!sc.frameTrace.empty () && !WriteFileAtomic (sc.frameTrace, trace.str ()))
+    {
+      NS_FATAL_ERROR ("Cannot write " << sc.frameTrace << ": " << std::strerror (errno));
+    }
+
+    OutageImpact sum;
+    double   durSum = 0, recSum = 0;
+    int64_t  recMax = 0;
+    uint32_t recovered = 0;
+    for (const OutageProcess::Outage &o : log)
+    {
+      const OutageImpact &im = impact[o.id];
+      std::cout << "[OUTAGE] id=" << o.id
+                << " user=" << o.user
+                << " startMs=" << o.start.GetMilliSeconds ()
+                << " durMs=" << (o.end - o.start).GetMilliSeconds ()
+                << " frames=" << im.frames
+                << " onTime=" << im.onTime
+                << " late=" << im.late
+                << " incomplete=" << im.incomplete
+                << " missing=" << im.missing
+                << " recoveryMs=" << im.recoveryMs
+                << forkTag
+                << std::endl;
+      sum.frames     += im.frames;
+      sum.onTime     += im.onTime;
+      sum.late       += im.late;
+      sum.incomplete += im.incomplete;
+      sum.missing    += im.missing;
+      durSum += (o.end - o.start).GetMilliSeconds ();
+      if (im.recoveryMs >= 0)
+      {
+        recovered += 1;
+        recSum    += im.recoveryMs;
+        recMax     = std::max (recMax, im.recoveryMs);
+      }
+    }
+    if (outage)
+    {
+      std::cout << "[OUTAGE-SUM] mode=" << sc.outageMode
+                << " policy=" << sc.outagePolicy
+                << " outages=" << log.size ()
+                << " durAvgMs=" << (log.empty () ? 0.0 : durSum / log.size ())
+                << " frames=" << sum.frames
+                << " onTime=" << sum.onTime
+                << " late=" << sum.late
+                << " incomplete=" << sum.incomplete
+                << " missing=" << sum.missing
+                << " recoveryAvgMs=" << (recovered ? recSum / recovered : 0.0)
+                << " recoveryMaxMs=" << recMax
+                << " unrecovered=" << log.size () - recovered
+                << " linkDrops=" << outages.GetGateDrops () + (cell ? cell->GetOutageDrops () : 0)
+                << forkTag
+                << std::endl;
+    }
+  }
+
+  if (recvs.size () > 1)
+  {
+    std::cout << "[VR-WORST] user=" << worstUser / perNode;
+    if (demux) std::cout << " session=" << worstUser;
+    std::cout << " ratio=" << worstRatio
+              << " users=" << users.size ()
+              << forkTag
+              << std::endl;
+  }
+
+  // 每个 --deadlines 值一行，字段顺序和 [VR-RECV] 一致，方便脚本 awk
+  std::vector<uint32_t> onTimeAt (deadlines.size (), 0);
+  for (const VrSession *recv : recvs)
+  {
+    std::vector<uint32_t> n = recv->GetOnTimeFrames (deadlines);
+    for (size_t i = 0; i < n.size (); ++i) onTimeAt[i] += n[i];
+  }
+  uint32_t completed = ontime + late;
+  for (size_t i = 0; i < deadlines.size (); ++i)
+  {
+    std::cout << "[VR-DEADLINE] deadline=" << deadlines[i]
+              << " total=" << total
+              << " onTime=" << onTimeAt[i]
+              << " late=" << completed - onTimeAt[i]
+              << " incomplete=" << incomplete
+              << " ratio=" << (total ? (double) onTimeAt[i] / total : 0.0)
+              << forkTag
+              << std::endl;
+  }
+
+  // per-class one-way packet delay from the FlowMonitor histograms (1 ms bins)
+  //   video = downlink VR data, imu = uplink IMU/control,
+  //   ack = TCP ACKs back to the server, other = anything else
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
+  const char *classNames[] = {"video", "imu", "ack", "other"};
+  uint32_t    classDscp[]  = {dscpVideo, dscpImu, dscpAck, 0};
+  std::vector<DelaySketch> classDelay (4);
+  std::vector<uint32_t>    classFlows (4, 0);
+  for (const auto &fs : monitor->GetFlowStats ())
+  {
+    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (fs.first);
+    uint32_t c = 3;
+    if (t.destinationPort == sc.dlPort && videoProbe) continue;   // video: batchProbe
+    if (t.destinationPort == sc.dlPort) c = 0;
+    else if (t.destinationPort >= sc.ulPort && t.destinationPort < sc.ulPort + users.size ()) c = 1;
+    else if (t.protocol == TcpL4Protocol::PROT_NUMBER && t.sourcePort == sc.dlPort) c = 2;
+
+    classFlows[c] += 1;
+    const Histogram &h = fs.second.delayHistogram;
+    for (uint32_t b = 0; b < h.GetNBins (); ++b)
+    {
+      classDelay[c].Add (std::lround (h.GetBinStart (b) * 1000.0), h.GetBinCount (b));
+    }
+  }
+  if (videoProbe)
+  {
+    classDelay[0] = batchProbe.GetDelays ();
+    classFlows[0] = sends.size ();
+  }
+  for (uint32_t c = 0; c < 4; ++c)
+  {
+    if (classFlows[c] == 0) continue;
+    std::cout << "[CLASS] class=" << classNames[c]
+              << " dscp=" << classDscp[c]
+              << " flows=" << classFlows[c]
+              << " pkts=" << classDelay[c].GetCount ()
+              << " p50=" << classDelay[c].GetQuantile (0.50)
+              << " p95=" << classDelay[c].GetQuantile (0.95)
+              << " p99=" << classDelay[c].GetQuantile (0.99)
+              << " max=" << classDelay[c].GetMax ()
+              << forkTag
+              << std::endl;
+  }
+
+  uint32_t rngSeed = RngSeedManager::GetSeed ();
+  uint64_t rngRun  = RngSeedManager::GetRun ();
+
+  std::ostringstream oss;
+  oss << "arvr_"
+        << "tx-"        << sc.transport
+        << "_tcp-"      << sc.tcpType
+        << "_rate-"     << sc.bottleneckRate
+        << "_delay-"    << sc.bottleneckDelay
+        << "_loss-"     << sc.loss
+        << "_deadline-" << sc.deadlineMs
+        << "_fs-"       << sc.frameSize
+        << "_queue-"    << sc.queueSize;
+  if (ownQdisc)
+  {
+    oss << "_qdisc-"    << sc.qdisc;
+  }
+  if (sc.dscp != "off")
+  {
+    std::string marks = sc.dscp;
+    std::replace (marks.begin (), marks.end (), ',', '.');   // 文件名也是 manifest.csv 的一列
+    oss << "_dscp-"     << marks;
+  }
+  if (sc.encoder)
+  {
+    oss << "_enc-"      << sc.encoderMean.GetMilliSeconds () << "ms-s" << sc.encoderSlices;
+  }
+  if (sc.pipeline)
+  {
+    oss << "_pipe-"     << sc.pipelineFull;
+  }
+  if (outage)
+  {
+    oss << "_outage-"   << sc.outageMode << "-" << sc.outagePolicy;
+  }
+  if (sc.bgMode != "off")
+  {
+    oss << "_bg-"       << sc.bgMode << "-" << sc.bgRate;
+  }
+  if (sc.batch)
+  {
+    oss << "_batch";
+  }
+  if (sc.gso)
+  {
+    oss << "_gso-"      << gsoSegs;
+  }
+  if (emu)
+  {
+    oss << "_emu";
+  }
+  if (sc.gro)
+  {
+    oss << "_gro-"      << sc.groFlush.GetMicroSeconds () << "us";
+  }
+  if (users.size () > 1)
+  {
+    oss << "_users-"    << users.size ();
+  }
+  if (demux)
+  {
+    oss << "_sessions-" << perNode;
+  }
+  if (apDev)
+  {
+    oss << "_ap-"       << sc.apScheduler;
+  }
+  if (sc.accessMode == "wifi")
+  {
+    oss << "_phy-wifi"  << (sc.wifiFast ? "fast" : "");
+  }
+  else if (sc.accessMode == "cell")
+  {
+    oss << "_phy-cell";
+  }
+  // 上面只是可读的部分；cfg = 所有 Scenario 字段的摘要，保证不同配置不会同名
+  std::string cfg = ScenarioDigest (sc);
+  oss   << "_cfg-"      << cfg
+        << "_seed-"     << rngSeed
+        << "_run-"      << rngRun
+        << ".xml";
+  std::string xmlPath = SystemPath::Append (sc.outDir, oss.str ());
+
+  std::ostringstream xml;
+  monitor->SerializeToXmlStream (xml, 0, true, true);
+  if (!WriteFileAtomic (xmlPath, xml.str ()))
+  {
+    NS_FATAL_ERROR ("Cannot write " << xmlPath << ": " << std::strerror (errno));
+  }
+
+  std::ostringstream row;
+  row << oss.str () << ',' << sc.transport << ',' << sc.tcpType << ',' << sc.bottleneckRate
+      << ',' << sc.bottleneckDelay << ',' << sc.loss << ',' << sc.deadlineMs << ',' << sc.frameSize
+      << ',' << sc.queueSize << ',' << rngSeed << ',' << rngRun
+      << ',' << total << ',' << ontime << ',' << late << ',' << incomplete << ',' << ratio
+      << ',' << cfg << ",packet";
+  std::string manifest = SystemPath::Append (sc.outDir, "manifest.csv");
+  if (!AppendManifestLine (manifest, kManifestHeader, row.str ()))
+  {
+    NS_FATAL_ERROR ("Cannot append to " << manifest << ": " << std::strerror (errno));
+  }
+
   Simulator::Destroy ();
   return 0;
 }
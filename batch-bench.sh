@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Batched send path: same frames on the wire, less stack traversal per fragment.
+# Each frame size runs with and without --batch; the receiver columns must match,
+# wallMs is the speed-up.
+OUT="results_batch.csv"
+echo "transport,frameSize,batch,wallMs,events,total,onTime,late,incomplete,ratio" > $OUT
+
+RATE="1Gbps"
+DELAY="10ms"
+
+RUN() {
+    tx=$1
+    fs=$2
+    batch=$3
+
+    cmd="./ns3 run \"scratch/arvr-sim --transport=$tx --rate=$RATE --delay=$DELAY \
+         --frameSize=$fs --queue=1000p --batch=$batch --outDir=xml\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    runline=$(echo "$LOG" | grep -F "[RUN]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+
+    wall=$(echo $runline | awk '{print $3}' | cut -d= -f2)
+    events=$(echo $runline | awk '{print $4}' | cut -d= -f2)
+    total=$(echo $vrline | awk '{print $2}' | cut -d= -f2)
+    onTime=$(echo $vrline | awk '{print $3}' | cut -d= -f2)
+    late=$(echo $vrline | awk '{print $4}' | cut -d= -f2)
+    incomplete=$(echo $vrline | awk '{print $5}' | cut -d= -f2)
+    ratio=$(echo $vrline | awk '{print $6}' | cut -d= -f2)
+
+    echo "$tx,$fs,$batch,$wall,$events,$total,$onTime,$late,$incomplete,$ratio" >> $OUT
+}
+
+# 75 / 200 / 500 fragments per frame
+FRAMESIZES=(90000 240000 600000)
+for tx in udp quic; do
+    for fs in ${FRAMESIZES[@]}; do
+        RUN $tx $fs 0
+        RUN $tx $fs 1
+    done
+done
+
+echo "Batch benchmark done. Results saved to $OUT"
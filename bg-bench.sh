@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# Background load on the bottleneck: packet-level on/off UDP flows vs. the
+# fluid aggregate of the same process. VR results should agree within
+# run-to-run noise; wallMs/events show what the packet-level background costs.
+# droptail on both: the fluid bottleneck is a FIFO, fq_codel would isolate flows.
+OUT="results_bg.csv"
+echo "bgMode,bgRate,flows,wallMs,events,total,onTime,late,incomplete,ratio,bgOfferedMbps,bgRxMbps,bgDropFrac" > $OUT
+
+RATE="120Mbps"
+DELAY="10ms"
+DEADLINE=50
+
+field() {
+    echo "$1" | grep -o "$2=[^ ]*" | cut -d= -f2
+}
+
+RUN() {
+    mode=$1
+    load=$2
+    flows=$3
+
+    cmd="./ns3 run \"scratch/arvr-sim --transport=udp --rate=$RATE --delay=$DELAY \
+         --deadline=$DEADLINE --queue=300p --qdisc=droptail --bg=$mode --bgRate=$load \
+         --set=background.flows=$flows --outDir=xml\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    runline=$(echo "$LOG" | grep -F "[RUN]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+    bgline=$(echo "$LOG" | grep -F "[BG]")
+
+    echo "$mode,$load,$flows,$(field "$runline" wallMs),$(field "$runline" events),\
+$(field "$vrline" total),$(field "$vrline" onTime),$(field "$vrline" late),$(field "$vrline" incomplete),\
+$(field "$vrline" ratio),$(field "$bgline" offeredMbps),$(field "$bgline" rxMbps),$(field "$bgline" dropFrac)" >> $OUT
+}
+
+RUN off 0Mbps 0
+LOADS=("30Mbps" "60Mbps" "90Mbps" "110Mbps")
+for load in ${LOADS[@]}; do
+    for flows in 10 100; do
+        RUN packet $load $flows
+        RUN fluid  $load $flows
+    done
+done
+
+echo "Background benchmark done. Results saved to $OUT"
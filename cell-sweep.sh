@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# Cellular last hop: how SR period and grant latency inflate the IMU uplink delay tail
+OUT="results_cell.csv"
+echo "srPeriod,grantDelay,configuredGrant,ul_avg,ul_p99,ul_max,grantWaitAvg,grantWaitP99,ratio" > $OUT
+
+SCENARIO="scratch/scenarios/cell-nr.toml"
+
+RUN() {
+    sr=$1
+    grant=$2
+    cg=$3
+
+    cmd="./ns3 run \"scratch/arvr-sim --scenario=$SCENARIO --outDir=xml \
+         --set='cell.srPeriod=$sr;cell.grantDelay=$grant;cell.configuredGrant=$cg'\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    ulline=$(echo "$LOG" | grep -F "[UL-IMU]")
+    cellline=$(echo "$LOG" | grep -F "[CELL]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+
+    ul_avg=$(echo $ulline | awk '{print $2}' | cut -d= -f2)
+    ul_p99=$(echo $ulline | awk '{print $3}' | cut -d= -f2)
+    ul_max=$(echo $ulline | awk '{print $4}' | cut -d= -f2)
+    gwAvg=$(echo $cellline | awk '{print $7}' | cut -d= -f2)
+    gwP99=$(echo $cellline | awk '{print $8}' | cut -d= -f2)
+    ratio=$(echo $vrline | awk '{print $6}' | cut -d= -f2)
+
+    echo "$sr,$grant,$cg,$ul_avg,$ul_p99,$ul_max,$gwAvg,$gwP99,$ratio" >> $OUT
+}
+
+# baseline: configured grant, the uplink never waits
+RUN 5ms 0ms true
+
+SR_PERIODS=("1ms" "5ms" "10ms" "20ms")
+GRANT_DELAYS=("1ms" "2ms" "4ms" "8ms")
+for sr in ${SR_PERIODS[@]}; do
+    for g in ${GRANT_DELAYS[@]}; do
+        RUN $sr $g false
+    done
+done
+
+echo "Cellular grant sweep done. Results saved to $OUT"
@@ -0,0 +1,110 @@
+#!/bin/bash
+
+# Realtime emulation (--emu=tap): real processes on this host send through the
+# modeled bottleneck. Run as root (taps, namespace); the simulator itself runs
+# as $SUDO_USER on persistent taps it may open without privileges.
+#
+#   host 10.10.1.1 [arvr-srv] == server node -- bottleneck -- headset node == [arvr-hs] 10.10.2.1 (netns arvr-hs)
+#
+# The headset end lives in its own network namespace, otherwise the kernel would
+# deliver 10.10.2.1 locally without crossing the taps. It is moved there after the
+# simulator has opened it ("[EMU] ready"); an open tap keeps working across netns.
+#
+# Default traffic is the load check: iperf3, 1200 B UDP datagrams at each rate in
+# LOADS. Lag and misses come from [EMU], iperfLoss from iperf3's receiver report;
+# keepsUp = no event-deadline misses at that load. To test real software instead set
+#   SERVER_CMD   run on the host, sends VrHeader-led datagrams to 10.10.2.1:5000
+#   HEADSET_CMD  run inside the namespace
+OUT="results_emu.csv"
+echo "rate,load,probes,lagP50Us,lagP99Us,lagMaxUs,misses,keepsUp,inPkts,inMbps,outPkts,vrPkts,iperfLoss,ratio" > $OUT
+
+USER_NAME=${SUDO_USER:-$USER}
+NS="arvr-hs"
+SRV="arvr-srv"
+HS="arvr-hs"
+RATE="150Mbps"
+DURATION=10
+LOADS=("60M" "120M" "200M")
+
+# key=value 取值
+field() {
+    echo "$1" | grep -o "$2=[^ ]*" | cut -d= -f2
+}
+
+setup() {
+    ip tuntap add dev $SRV mode tap user $USER_NAME
+    ip tuntap add dev $HS mode tap user $USER_NAME
+    ip addr add 10.10.1.1/24 dev $SRV
+    ip link set $SRV up
+    ip route replace 10.10.2.0/24 via 10.10.1.2 dev $SRV
+    ip netns add $NS
+}
+
+teardown() {
+    ip netns exec $NS ip link del $HS 2>/dev/null
+    ip link del $HS 2>/dev/null
+    ip link del $SRV 2>/dev/null
+    ip netns del $NS 2>/dev/null
+}
+trap teardown EXIT
+
+RUN() {
+    load=$1
+    LOG=$(mktemp)
+    IPERF=$(mktemp)
+
+    teardown
+    setup
+
+    # 仿真时长盖住流量：time.stop 之后才不再统计
+    sudo -u $USER_NAME ./ns3 run "scratch/arvr-sim --emu=tap --rate=$RATE --queue=1000p \
+         --set='time.stop=$((DURATION + 4))s;time.end=$((DURATION + 5))s' --outDir=xml" > $LOG 2>&1 &
+    sim=$!
+
+    until grep -qF "[EMU] ready" $LOG; do
+        if ! kill -0 $sim 2>/dev/null; then cat $LOG; exit 1; fi
+        sleep 0.1
+    done
+
+    ip link set $HS netns $NS
+    ip netns exec $NS ip addr add 10.10.2.1/24 dev $HS
+    ip netns exec $NS ip link set $HS up
+    ip netns exec $NS ip link set lo up
+    ip netns exec $NS ip route add default via 10.10.2.2
+
+    if [ -n "$SERVER_CMD" ]; then
+        ip netns exec $NS sudo -u $USER_NAME sh -c "$HEADSET_CMD" &
+        sleep 1
+        sudo -u $USER_NAME sh -c "$SERVER_CMD"
+    else
+        ip netns exec $NS iperf3 -s -1 > /dev/null &
+        sleep 1
+        iperf3 -c 10.10.2.1 -u -b $load -l 1200 -t $DURATION -J > $IPERF
+    fi
+
+    wait $sim
+
+    emuline=$(grep -F "[EMU] probes" $LOG)
+    vrline=$(grep -F "[VR-RECV]" $LOG)
+    misses=$(field "$emuline" misses)
+    keeps=$([ "$misses" = "0" ] && echo yes || echo no)
+    # 最后一个 lost_percent 是 end.sum（接收端汇总）
+    loss=$(grep -o '"lost_percent":[[:space:]]*[0-9.eE+-]*' $IPERF | tail -1 | awk -F: '{ print $2 + 0 }')
+
+    echo "$RATE,$load,$(field "$emuline" probes),$(field "$emuline" lagP50Us),\
+$(field "$emuline" lagP99Us),$(field "$emuline" lagMaxUs),$misses,$keeps,\
+$(field "$emuline" inPkts),$(field "$emuline" inMbps),$(field "$emuline" outPkts),\
+$(field "$emuline" vrPkts),$loss,$(field "$vrline" ratio)" >> $OUT
+    rm -f $LOG $IPERF
+}
+
+if [ -n "$SERVER_CMD" ]; then
+    RUN custom
+else
+    for load in ${LOADS[@]}; do
+        RUN $load
+    done
+fi
+
+column -s, -t < $OUT
+echo "Emulation run done. Results saved to $OUT"
@@ -23,7 +23,7 @@ RUN() {
 
     cmd="./ns3 run \"scratch/arvr-sim --transport=$transport --tcp=$tcpType \
          --rate=$rate --delay=$delay --loss=$loss \
-         --deadline=$deadline --frameSize=$fs --queue=$q\""
+         --deadline=$deadline --frameSize=$fs --queue=$q --outDir=xml\""
 
     LOG=$(eval $cmd 2>&1)
 
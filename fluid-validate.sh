@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# Analytic fast path vs. the packet-level baseline sweep.
+# Every udp/quic row of results_final.csv is re-run with --model=fluid; the
+# packet columns are copied from the CSV, the fluid ones come from [VR-RECV]
+# and [UL-IMU].
+# tcp rows are skipped: the fluid model does not cover congestion control.
+IN="results_final.csv"
+OUT="results_fluid.csv"
+echo "transport,group,rate,delay,loss,deadline,frameSize,queue,pktTotal,pktOnTime,pktLate,pktIncomplete,pktRatio,fluidTotal,fluidOnTime,fluidLate,fluidIncomplete,fluidRatio,ratioErr,pktUlAvg,pktUlP99,pktUlMax,fluidUlAvg,fluidUlP99,fluidUlMax,reason,wallMs" > $OUT
+
+field() {
+    echo "$1" | grep -o "$2=[^ ]*" | cut -d= -f2
+}
+
+tail -n +2 $IN | while IFS=, read transport tcpType group rate delay loss deadline fs q total onTime late incomplete ratio ulAvg ulP99 ulMax rest; do
+    [ "$transport" = "tcp" ] && continue
+
+    cmd="./ns3 run \"scratch/arvr-sim --model=fluid --transport=$transport \
+         --rate=$rate --delay=$delay --loss=$loss \
+         --deadline=$deadline --frameSize=$fs --queue=$q --outDir=xml\""
+
+    LOG=$(eval $cmd 2>&1 < /dev/null)
+
+    modelline=$(echo "$LOG" | grep -F "[MODEL]")
+    runline=$(echo "$LOG" | grep -F "[RUN]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+    ulline=$(echo "$LOG" | grep -F "[UL-IMU]")
+    fratio=$(field "$vrline" ratio)
+    err=$(awk -v a="$fratio" -v b="$ratio" 'BEGIN { d = a - b; if (d < 0) d = -d; print d }')
+
+    echo "$transport,$group,$rate,$delay,$loss,$deadline,$fs,$q,$total,$onTime,$late,$incomplete,$ratio,\
+$(field "$vrline" total),$(field "$vrline" onTime),$(field "$vrline" late),$(field "$vrline" incomplete),$fratio,\
+$err,$ulAvg,$ulP99,$ulMax,$(field "$ulline" avgDelay),$(field "$ulline" p99),$(field "$ulline" max),\
+$(field "$modelline" reason),$(field "$runline" wallMs)" >> $OUT
+done
+
+echo "Fluid validation done. Results saved to $OUT"
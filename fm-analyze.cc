@@ -0,0 +1,674 @@
+//
+// FlowMonitor XML analyzer for arvr-sim sweeps:
+// - Streams every *.xml in a directory with a small pull tokenizer (no DOM)
+// - Files are parsed in parallel by a fixed pool of worker threads
+// - Per flow: throughput, mean delay/jitter, loss, delay p50/p95/p99 (histogram)
+// - Sweep parameters are parsed from the arvr_tx-..._queue-... filename
+// - Joined with the frame-level results CSV into one table
+//
+// Plain C++17, no ns-3 dependency, so it can run next to the sweep scripts:
+//   g++ -O2 -std=c++17 -pthread fm-analyze.cc -o fm-analyze
+//   ./fm-analyze --dir=xml --csv=results_final.csv --out=results_joined.csv
+// or, when dropped into scratch/ together with arvr-sim.cc:
+//   ./ns3 run "scratch/fm-analyze --dir=xml --csv=results_final.csv"
+//
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+//
+// 1. Pull tokenizer: walks a byte range and reports one tag at a time
+//    - only what FlowMonitor emits: <?xml ?>, <tag a="b">, </tag>, <tag/>
+//    - attribute values are views into the file buffer (no copies)
+//
+struct XmlAttr
+{
+  std::string_view name;
+  std::string_view value;
+};
+
+class XmlPullParser
+{
+public:
+  XmlPullParser (const char *begin, const char *end)
+    : m_cur (begin),
+      m_end (end)
+  {}
+
+  // 读下一个标签；返回 false 表示文件结束
+  bool Next ()
+  {
+    m_attrs.clear ();
+    m_isEnd = false;
+    m_selfClosing = false;
+
+    while (true)
+    {
+      const char *lt = static_cast<const char *> (
+        std::memchr (m_cur, '<', m_end - m_cur));
+      if (!lt || lt + 1 >= m_end) return false;
+      m_cur = lt + 1;
+
+      // <?xml ... ?> / <!-- ... --> : skip
+      if (*m_cur == '?' || *m_cur == '!')
+      {
+        const char *gt = static_cast<const char *> (
+          std::memchr (m_cur, '>', m_end - m_cur));
+        if (!gt) return false;
+        m_cur = gt + 1;
+        continue;
+      }
+      break;
+    }
+
+    if (*m_cur == '/')
+    {
+      m_isEnd = true;
+      ++m_cur;
+    }
+
+    const char *nameBegin = m_cur;
+    while (m_cur < m_end && !IsSpace (*m_cur) && *m_cur != '>' && *m_cur != '/')
+      ++m_cur;
+    m_name = std::string_view (nameBegin, m_cur - nameBegin);
+
+    // attributes: name="value"
+    while (m_cur < m_end)
+    {
+      while (m_cur < m_end && IsSpace (*m_cur)) ++m_cur;
+      if (m_cur >= m_end) return false;
+
+      if (*m_cur == '>')
+      {
+        ++m_cur;
+        return true;
+      }
+      if (*m_cur == '/')
+      {
+        m_selfClosing = true;
+        ++m_cur;
+        continue;
+      }
+
+      const char *an = m_cur;
+      while (m_cur < m_end && *m_cur != '=' && !IsSpace (*m_cur)) ++m_cur;
+      std::string_view attrName (an, m_cur - an);
+
+      const char *q = static_cast<const char *> (
+        std::memchr (m_cur, '"', m_end - m_cur));
+      if (!q) return false;
+      const char *qe = static_cast<const char *> (
+        std::memchr (q + 1, '"', m_end - (q + 1)));
+      if (!qe) return false;
+
+      m_attrs.push_back ({attrName, std::string_view (q + 1, qe - q - 1)});
+      m_cur = qe + 1;
+    }
+    return false;
+  }
+
+  std::string_view Name () const { return m_name; }
+  bool IsEnd () const { return m_isEnd; }
+  bool IsSelfClosing () const { return m_selfClosing; }
+
+  std::string_view Attr (std::string_view name) const
+  {
+    for (const XmlAttr &a : m_attrs)
+      if (a.name == name) return a.value;
+    return std::string_view ();
+  }
+
+private:
+  static bool IsSpace (char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  const char *m_cur;
+  const char *m_end;
+  std::string_view m_name;
+  bool m_isEnd = false;
+  bool m_selfClosing = false;
+  std::vector<XmlAttr> m_attrs;
+};
+
+// "+1.01008e+09ns" -> seconds
+static double
+ParseNs (std::string_view v)
+{
+  if (v.empty ()) return 0.0;
+  std::string s (v);
+  return std::strtod (s.c_str (), nullptr) / 1e9;
+}
+
+static double
+ParseNum (std::string_view v)
+{
+  if (v.empty ()) return 0.0;
+  std::string s (v);
+  return std::strtod (s.c_str (), nullptr);
+}
+
+//
+// 2. Per-flow record, filled from <FlowStats> and <Ipv4FlowClassifier>
+//
+struct HistBin
+{
+  double   start;
+  double   width;
+  uint64_t count;
+};
+
+struct FlowRecord
+{
+  uint32_t flowId = 0;
+
+  double   timeFirstTx = 0;
+  double   timeFirstRx = 0;
+  double   timeLastRx  = 0;
+  double   delaySum    = 0;
+  double   jitterSum   = 0;
+  double   minDelay    = 0;
+  double   maxDelay    = 0;
+  uint64_t txBytes     = 0;
+  uint64_t rxBytes     = 0;
+  uint64_t txPackets   = 0;
+  uint64_t rxPackets   = 0;
+  uint64_t lostPackets = 0;
+
+  std::vector<HistBin> delayHist;
+  std::vector<HistBin> jitterHist;
+
+  // from Ipv4FlowClassifier
+  uint32_t protocol = 0;
+  uint32_t srcPort  = 0;
+  uint32_t dstPort  = 0;
+
+  double ThroughputMbps () const
+  {
+    double dur = timeLastRx - timeFirstRx;
+    return dur > 0 ? rxBytes * 8.0 / dur / 1e6 : 0.0;
+  }
+
+  double MeanDelayMs () const
+  {
+    return rxPackets ? delaySum / rxPackets * 1e3 : 0.0;
+  }
+
+  double MeanJitterMs () const
+  {
+    return rxPackets > 1 ? jitterSum / (rxPackets - 1) * 1e3 : 0.0;
+  }
+
+  double LossRate () const
+  {
+    return txPackets ? double (txPackets - std::min (txPackets, rxPackets)) / txPackets : 0.0;
+  }
+};
+
+// 直方图分位数：在命中的 bin 内线性插值，单位 ms
+static double
+HistPercentileMs (const std::vector<HistBin> &bins, double q)
+{
+  uint64_t total = 0;
+  for (const HistBin &b : bins) total += b.count;
+  if (total == 0) return 0.0;
+
+  double target = q * total;
+  double cum = 0;
+  for (const HistBin &b : bins)
+  {
+    if (cum + b.count >= target)
+    {
+      double frac = b.count ? (target - cum) / b.count : 0.0;
+      return (b.start + b.width * frac) * 1e3;
+    }
+    cum += b.count;
+  }
+  const HistBin &last = bins.back ();
+  return (last.start + last.width) * 1e3;
+}
+
+//
+// 3. One XML file -> flows, in a single forward pass
+//
+static bool
+ParseFlowMonitorXml (const std::string &path, std::vector<FlowRecord> &flows)
+{
+  std::ifstream in (path, std::ios::binary);
+  if (!in) return false;
+  std::string buf ((std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+
+  enum Section { NONE, FLOW_STATS, CLASSIFIER, OTHER };
+  enum Hist { H_NONE, H_DELAY, H_JITTER };
+
+  Section section = NONE;
+  Hist hist = H_NONE;
+  std::map<uint32_t, size_t> byId;   // flowId -> index in flows
+  FlowRecord *cur = nullptr;
+
+  auto lookup = [&] (uint32_t id) -> FlowRecord & {
+    auto it = byId.find (id);
+    if (it != byId.end ()) return flows[it->second];
+    byId[id] = flows.size ();
+    flows.emplace_back ();
+    flows.back ().flowId = id;
+    return flows.back ();
+  };
+
+  XmlPullParser xp (buf.data (), buf.data () + buf.size ());
+  while (xp.Next ())
+  {
+    std::string_view name = xp.Name ();
+
+    if (xp.IsEnd ())
+    {
+      if ((name == "FlowStats" && section == FLOW_STATS) || name == "Ipv4FlowClassifier") section = NONE;
+      else if (name == "delayHistogram" || name == "jitterHistogram") hist = H_NONE;
+      else if (name == "Flow") cur = nullptr;
+      continue;
+    }
+
+    if (name == "FlowStats")
+    {
+      // FlowProbes 里也有 <FlowStats .../>，只认顶层那一个
+      if (section == NONE) section = FLOW_STATS;
+      continue;
+    }
+    if (name == "Ipv4FlowClassifier") { section = CLASSIFIER; continue; }
+    if (name == "Ipv6FlowClassifier" || name == "FlowProbes") { section = OTHER; continue; }
+
+    if (name == "Flow" && section == FLOW_STATS)
+    {
+      cur = &lookup ((uint32_t) ParseNum (xp.Attr ("flowId")));
+      cur->timeFirstTx = ParseNs (xp.Attr ("timeFirstTxPacket"));
+      cur->timeFirstRx = ParseNs (xp.Attr ("timeFirstRxPacket"));
+      cur->timeLastRx  = ParseNs (xp.Attr ("timeLastRxPacket"));
+      cur->delaySum    = ParseNs (xp.Attr ("delaySum"));
+      cur->jitterSum   = ParseNs (xp.Attr ("jitterSum"));
+      cur->minDelay    = ParseNs (xp.Attr ("minDelay"));
+      cur->maxDelay    = ParseNs (xp.Attr ("maxDelay"));
+      cur->txBytes     = (uint64_t) ParseNum (xp.Attr ("txBytes"));
+      cur->rxBytes     = (uint64_t) ParseNum (xp.Attr ("rxBytes"));
+      cur->txPackets   = (uint64_t) ParseNum (xp.Attr ("txPackets"));
+      cur->rxPackets   = (uint64_t) ParseNum (xp.Attr ("rxPackets"));
+      cur->lostPackets = (uint64_t) ParseNum (xp.Attr ("lostPackets"));
+      if (xp.IsSelfClosing ()) cur = nullptr;
+    }
+    else if (name == "Flow" && section == CLASSIFIER)
+    {
+      FlowRecord &f = lookup ((uint32_t) ParseNum (xp.Attr ("flowId")));
+      f.protocol = (uint32_t) ParseNum (xp.Attr ("protocol"));
+      f.srcPort  = (uint32_t) ParseNum (xp.Attr ("sourcePort"));
+      f.dstPort  = (uint32_t) ParseNum (xp.Attr ("destinationPort"));
+    }
+    else if (cur && name == "delayHistogram")
+    {
+      hist = xp.IsSelfClosing () ? H_NONE : H_DELAY;
+    }
+    else if (cur && name == "jitterHistogram")
+    {
+      hist = xp.IsSelfClosing () ? H_NONE : H_JITTER;
+    }
+    else if (cur && name == "bin" && hist != H_NONE)
+    {
+      HistBin b {ParseNum (xp.Attr ("start")),
+                 ParseNum (xp.Attr ("width")),
+                 (uint64_t) ParseNum (xp.Attr ("count"))};
+      (hist == H_DELAY ? cur->delayHist : cur->jitterHist).push_back (b);
+    }
+  }
+  return true;
+}
+
+//
+// 4. Sweep parameters from the filename written by arvr-sim main():
+//    arvr_tx-udp_tcp-none_rate-120Mbps_delay-10ms_loss-0_deadline-80_fs-90000_queue-100p.xml
+//    newer names add feature tags (qdisc-edf, users-4, ..., cfg-<digest>)
+//    before _seed-S_run-R; those tags are kept verbatim as `variant`
+//
+struct RunParams
+{
+  std::map<std::string, std::string> kv;   // transport, tcpType, rate, ...
+};
+
+static const char *kParamCols[] = {
+  "transport", "tcpType", "rate", "delay", "loss", "deadline", "frameSize", "queue"
+};
+
+// one file = one (params, variant, seed, run); replicates never share a key
+static const char *kRunCols[] = {
+  "variant", "seed", "run"
+};
+
+// 0 / 0.00001 / 1e-05 统一成同一种写法，方便和 CSV 对齐
+static std::string
+NormalizeNumber (const std::string &v)
+{
+  char *end = nullptr;
+  double d = std::strtod (v.c_str (), &end);
+  if (end == v.c_str () || *end != '\0') return v;
+  std::ostringstream oss;
+  oss << d;
+  return oss.str ();
+}
+
+static bool
+ParseRunParams (const std::string &stem, RunParams &out)
+{
+  static const std::map<std::string, std::string> keyMap = {
+    {"tx", "transport"}, {"tcp", "tcpType"}, {"rate", "rate"}, {"delay", "delay"},
+    {"loss", "loss"}, {"deadline", "deadline"}, {"fs", "frameSize"}, {"queue", "queue"},
+    {"seed", "seed"}, {"run", "run"}   // 新版 arvr-sim 才有，可选
+  };
+
+  if (stem.compare (0, 5, "arvr_") != 0) return false;
+
+  std::stringstream ss (stem.substr (5));
+  std::string tok;
+  std::string variant;
+  while (std::getline (ss, tok, '_'))
+  {
+    size_t dash = tok.find ('-');
+    // loss-1e-05：只在第一个 '-' 处切
+    auto it = dash == std::string::npos ? keyMap.end () : keyMap.find (tok.substr (0, dash));
+    if (it == keyMap.end ())
+    {
+      variant += (variant.empty () ? "" : "_") + tok;
+      continue;
+    }
+    out.kv[it->second] = tok.substr (dash + 1);
+  }
+  out.kv["variant"] = variant;
+  if (out.kv.count ("loss")) out.kv["loss"] = NormalizeNumber (out.kv["loss"]);
+  for (const char *c : kParamCols)
+    if (!out.kv.count (c)) return false;
+  return true;
+}
+
+// sweep point only; a CSV row narrows it further by the kRunCols it has
+static std::string
+JoinKey (const std::map<std::string, std::string> &kv)
+{
+  std::string key;
+  for (const char *c : kParamCols)
+  {
+    auto it = kv.find (c);
+    key += (it != kv.end () ? it->second : std::string ());
+    key += '|';
+  }
+  return key;
+}
+
+//
+// 5. Per-file result row
+//
+struct FileResult
+{
+  std::string file;
+  bool ok = false;
+  RunParams params;
+  std::vector<FlowRecord> flows;
+};
+
+static const FlowRecord *
+FindFlow (const std::vector<FlowRecord> &flows, uint32_t dstPort)
+{
+  for (const FlowRecord &f : flows)
+    if (f.dstPort == dstPort) return &f;
+  return nullptr;
+}
+
+static const char *kFlowCols[] = {
+  "thrMbps", "lossRate", "delayMs", "jitterMs", "p50Ms", "p95Ms", "p99Ms", "maxMs"
+};
+
+static void
+WriteFlowCols (std::ostream &os, const FlowRecord *f)
+{
+  if (!f)
+  {
+    for (size_t i = 0; i < sizeof (kFlowCols) / sizeof (kFlowCols[0]); ++i) os << ',';
+    return;
+  }
+  // bin 内插值可能越过真实的 min/max，夹回去
+  auto pct = [f] (double q) {
+    return std::clamp (HistPercentileMs (f->delayHist, q), f->minDelay * 1e3, f->maxDelay * 1e3);
+  };
+  os << ',' << f->ThroughputMbps ()
+     << ',' << f->LossRate ()
+     << ',' << f->MeanDelayMs ()
+     << ',' << f->MeanJitterMs ()
+     << ',' << pct (0.50)
+     << ',' << pct (0.95)
+     << ',' << pct (0.99)
+     << ',' << f->maxDelay * 1e3;
+}
+
+static void
+WriteFlowHeader (std::ostream &os)
+{
+  for (const char *c : kRunCols) os << ',' << c;
+  os << ",nFlows";
+  for (const char *prefix : {"dl_", "ulflow_"})
+    for (const char *c : kFlowCols)
+      os << ',' << prefix << c;
+}
+
+static void
+WriteFileCols (std::ostream &os, const FileResult *r)
+{
+  if (!r)
+  {
+    for (size_t i = 0; i < sizeof (kRunCols) / sizeof (kRunCols[0]); ++i) os << ',';
+    os << ',';
+    WriteFlowCols (os, nullptr);
+    WriteFlowCols (os, nullptr);
+    return;
+  }
+  for (const char *c : kRunCols)
+  {
+    auto it = r->params.kv.find (c);
+    os << ',' << (it != r->params.kv.end () ? it->second : std::string ());
+  }
+  // downlink VR -> port 5000, uplink IMU -> port 6000 (arvr-sim 固定端口)
+  os << ',' << r->flows.size ();
+  WriteFlowCols (os, FindFlow (r->flows, 5000));
+  WriteFlowCols (os, FindFlow (r->flows, 6000));
+}
+
+static std::vector<std::string>
+SplitCsv (const std::string &line)
+{
+  std::vector<std::string> out;
+  std::stringstream ss (line);
+  std::string cell;
+  while (std::getline (ss, cell, ',')) out.push_back (cell);
+  if (!line.empty () && line.back () == ',') out.emplace_back ();
+  return out;
+}
+
+//
+// 6. main: scan dir, parse in parallel, join with CSV
+//
+int
+main (int argc, char *argv[])
+{
+  std::string dir     = "xml";
+  std::string csvPath = "results_final.csv";
+  std::string outPath = "results_joined.csv";
+  uint32_t    threads = std::max (1u, std::thread::hardware_concurrency ());
+
+  // 和 ns-3 CommandLine 一样的 --key=value 写法
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string a = argv[i];
+    size_t eq = a.find ('=');
+    std::string k = a.substr (0, eq);
+    std::string v = eq == std::string::npos ? std::string () : a.substr (eq + 1);
+
+    if (k == "--dir") dir = v;
+    else if (k == "--csv") csvPath = v;
+    else if (k == "--out") outPath = v;
+    else if (k == "--threads") threads = std::max (1, std::atoi (v.c_str ()));
+    else
+    {
+      std::cerr << "Usage: fm-analyze [--dir=xml] [--csv=results_final.csv]"
+                << " [--out=results_joined.csv] [--threads=N]\n"
+                << "  --csv=     (empty) skips the join and emits one row per XML file"
+                << std::endl;
+      return (k == "--help" || k == "-h") ? 0 : 1;
+    }
+  }
+
+  std::vector<FileResult> results;
+  std::error_code ec;
+  for (const fs::directory_entry &e : fs::directory_iterator (dir, ec))
+  {
+    if (e.is_regular_file () && e.path ().extension () == ".xml")
+    {
+      results.emplace_back ();
+      results.back ().file = e.path ().string ();
+    }
+  }
+  if (ec)
+  {
+    std::cerr << "cannot read directory " << dir << ": " << ec.message () << std::endl;
+    return 1;
+  }
+  std::sort (results.begin (), results.end (),
+             [] (const FileResult &a, const FileResult &b) { return a.file < b.file; });
+
+  // work stealing over a shared index: each worker grabs the next unparsed file
+  std::atomic<size_t> next {0};
+  auto worker = [&] () {
+    for (size_t i = next++; i < results.size (); i = next++)
+    {
+      FileResult &r = results[i];
+      std::string stem = fs::path (r.file).stem ().string ();
+      r.ok = ParseRunParams (stem, r.params) && ParseFlowMonitorXml (r.file, r.flows);
+    }
+  };
+  std::vector<std::thread> pool;
+  threads = std::min<uint32_t> (threads, std::max<size_t> (1, results.size ()));
+  for (uint32_t t = 0; t < threads; ++t) pool.emplace_back (worker);
+  for (std::thread &t : pool) t.join ();
+
+  std::multimap<std::string, const FileResult *> byKey;
+  uint32_t skipped = 0;
+  for (const FileResult &r : results)
+  {
+    if (!r.ok)
+    {
+      std::cerr << "skip " << r.file << std::endl;
+      ++skipped;
+      continue;
+    }
+    byKey.emplace (JoinKey (r.params.kv), &r);
+  }
+
+  std::ofstream out (outPath);
+  if (!out)
+  {
+    std::cerr << "cannot write " << outPath << std::endl;
+    return 1;
+  }
+
+  std::ifstream csv;
+  if (!csvPath.empty ()) csv.open (csvPath);
+
+  std::map<const FileResult *, bool> joined;
+  std::vector<std::string> header;
+  std::string line;
+
+  if (csv && std::getline (csv, line))
+  {
+    // 1) CSV 里的每一行原样保留（含 group），后面拼上 FlowMonitor 指标
+    header = SplitCsv (line);
+    out << line;
+    WriteFlowHeader (out);
+    out << '\n';
+
+    while (std::getline (csv, line))
+    {
+      if (line.empty ()) continue;
+      std::vector<std::string> cells = SplitCsv (line);
+      std::map<std::string, std::string> kv;
+      for (size_t c = 0; c < header.size () && c < cells.size (); ++c)
+        kv[header[c]] = cells[c];
+      if (kv.count ("loss")) kv["loss"] = NormalizeNumber (kv["loss"]);
+
+      // 同一个参数点的每个 replicate / 变体各输出一行；CSV 里有
+      // variant/seed/run 列时只留对得上的文件
+      std::vector<const FileResult *> matches;
+      auto range = byKey.equal_range (JoinKey (kv));
+      for (auto it = range.first; it != range.second; ++it)
+      {
+        const std::map<std::string, std::string> &fkv = it->second->params.kv;
+        bool ok = true;
+        for (const char *c : kRunCols)
+        {
+          auto cell = kv.find (c);
+          auto file = fkv.find (c);
+          if (cell != kv.end () && !cell->second.empty ()
+              && (file == fkv.end () || file->second != cell->second))
+          {
+            ok = false;
+          }
+        }
+        if (ok) matches.push_back (it->second);
+      }
+      if (matches.empty ()) matches.push_back (nullptr);
+
+      for (const FileResult *r : matches)
+      {
+        if (r) joined[r] = true;
+        out << line;
+        WriteFileCols (out, r);
+        out << '\n';
+      }
+    }
+  }
+  else
+  {
+    for (const char *c : kParamCols) header.push_back (c);
+    for (size_t c = 0; c < header.size (); ++c) out << (c ? "," : "") << header[c];
+    WriteFlowHeader (out);
+    out << '\n';
+  }
+
+  // 2) 没出现在 CSV 里的 XML：参数列从文件名补齐，其余列留空
+  for (const FileResult &r : results)
+  {
+    if (!r.ok || joined.count (&r)) continue;
+    for (size_t c = 0; c < header.size (); ++c)
+    {
+      auto it = r.params.kv.find (header[c]);
+      out << (c ? "," : "") << (it != r.params.kv.end () ? it->second : std::string ());
+    }
+    WriteFileCols (out, &r);
+    out << '\n';
+  }
+
+  std::cout << "[FM-ANALYZE] files=" << results.size ()
+            << " skipped=" << skipped
+            << " joined=" << joined.size ()
+            << " threads=" << threads
+            << " out=" << outPath << std::endl;
+  return 0;
+}
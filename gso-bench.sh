@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# UDP GSO/GRO emulation: simulator cost vs. burst effect on the bottleneck.
+# --gso=1 is the baseline (one fragment per datagram through the same device);
+# wallMs/events come from [RUN], queue peak and frame delay from [GSO].
+OUT="results_gso.csv"
+echo "users,frameSize,gso,gro,wallMs,events,superPkts,segsPerSuper,devQueuePeak,devDrops,segsPerDelivery,frameP50,frameP99,ratio" > $OUT
+
+RATE="1Gbps"
+DELAY="10ms"
+
+# key=value 取值，[GSO] 行的字段随 gso/gro 开关变化
+field() {
+    echo "$1" | grep -o "$2=[^ ]*" | cut -d= -f2
+}
+
+RUN() {
+    users=$1
+    fs=$2
+    gso=$3
+    gro=$4
+
+    cmd="./ns3 run \"scratch/arvr-sim --transport=udp --rate=$RATE --delay=$DELAY \
+         --users=$users --frameSize=$fs --queue=1000p --gso=$gso --gro=$gro --outDir=xml\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    runline=$(echo "$LOG" | grep -F "[RUN]")
+    gsoline=$(echo "$LOG" | grep -F "[GSO]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+
+    echo "$users,$fs,$gso,$gro,$(field "$runline" wallMs),$(field "$runline" events),\
+$(field "$gsoline" superPkts),$(field "$gsoline" segsPerSuper),$(field "$gsoline" devQueuePeak),\
+$(field "$gsoline" devDrops),$(field "$gsoline" segsPerDelivery),\
+$(field "$gsoline" frameP50),$(field "$gsoline" frameP99),$(field "$vrline" ratio)" >> $OUT
+}
+
+# 75 / 500 fragments per frame; 54 = 64 KB datagram limit at 1200 B payload
+FRAMESIZES=(90000 600000)
+for users in 1 4; do
+    for fs in ${FRAMESIZES[@]}; do
+        for gso in 1 8 54; do
+            RUN $users $fs $gso 0
+            RUN $users $fs $gso 1
+        done
+    done
+done
+
+echo "GSO benchmark done. Results saved to $OUT"
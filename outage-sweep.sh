@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Handover outages: how each transport recovers when the headset link goes away for a while
+OUT="results_outage.csv"
+echo "transport,policy,durationMs,frames,onTime,late,incomplete,missing,recoveryAvgMs,recoveryMaxMs,ratio" > $OUT
+
+SCENARIO="scratch/scenarios/handover.toml"
+
+RUN() {
+    tx=$1
+    policy=$2
+    dur=$3
+
+    cmd="./ns3 run \"scratch/arvr-sim --scenario=$SCENARIO --outDir=xml \
+         --transport=$tx --outagePolicy=$policy --set='outage.duration=${dur}ms;metrics.frameTrace='\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    sumline=$(echo "$LOG" | grep -F "[OUTAGE-SUM]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+
+    frames=$(echo $sumline | awk '{print $6}' | cut -d= -f2)
+    ontime=$(echo $sumline | awk '{print $7}' | cut -d= -f2)
+    late=$(echo $sumline | awk '{print $8}' | cut -d= -f2)
+    incomplete=$(echo $sumline | awk '{print $9}' | cut -d= -f2)
+    missing=$(echo $sumline | awk '{print $10}' | cut -d= -f2)
+    recAvg=$(echo $sumline | awk '{print $11}' | cut -d= -f2)
+    recMax=$(echo $sumline | awk '{print $12}' | cut -d= -f2)
+    ratio=$(echo $vrline | awk '{print $6}' | cut -d= -f2)
+
+    echo "$tx,$policy,$dur,$frames,$ontime,$late,$incomplete,$missing,$recAvg,$recMax,$ratio" >> $OUT
+}
+
+TRANSPORTS=("udp" "tcp" "quic")
+POLICIES=("buffer" "drop")
+DURATIONS=(50 100 200 500 1000)
+for tx in ${TRANSPORTS[@]}; do
+    for p in ${POLICIES[@]}; do
+        for d in ${DURATIONS[@]}; do
+            RUN $tx $p $d
+        done
+    done
+done
+
+echo "Outage sweep done. Results saved to $OUT"
@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Simulation cost of the last hop: scenarios/wifi-ax.toml with the same traffic
+# over p2p, full Wi-Fi and fast Wi-Fi, for a few station counts. Only wallMs and
+# events from [RUN] are the point here; the receiver ratio is kept to show how
+# much the cheaper PHY changes results.
+OUT="results_phy.csv"
+echo "phy,wifiFast,users,rep,wallMs,events,ratio" > $OUT
+
+SCENARIO="scratch/scenarios/wifi-ax.toml"
+USERS=(1 4 8)
+REPS=3
+
+# key=value 取值
+field() {
+    echo "$1" | grep -o "$2=[^ ]*" | cut -d= -f2
+}
+
+RUN() {
+    phy=$1
+    fast=$2
+    users=$3
+    rep=$4
+
+    cmd="./ns3 run \"scratch/arvr-sim --scenario=$SCENARIO --phy=$phy --wifiFast=$fast \
+         --users=$users --outDir=xml\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    runline=$(echo "$LOG" | grep -F "[RUN]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+
+    echo "$phy,$fast,$users,$rep,$(field "$runline" wallMs),$(field "$runline" events),\
+$(field "$vrline" ratio)" >> $OUT
+}
+
+for users in ${USERS[@]}; do
+    for rep in $(seq 1 $REPS); do
+        RUN p2p 0 $users $rep
+        RUN wifi 0 $users $rep
+        RUN wifi 1 $users $rep
+    done
+done
+
+echo "PHY cost benchmark done. Results saved to $OUT"
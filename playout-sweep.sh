@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# Playout buffer: end-to-end latency vs. smoothness for each transport and target adaptation
+OUT="results_playout.csv"
+echo "transport,mode,policy,displayed,skipped,stalls,stallRatio,targetAvg,e2e_avg,e2e_p95,e2e_p99,ratio" > $OUT
+
+RATE="120Mbps"
+DELAY="20ms"
+
+RUN() {
+    tx=$1
+    mode=$2
+    policy=$3
+
+    cmd="./ns3 run \"scratch/arvr-sim --transport=$tx --rate=$RATE --delay=$DELAY --outDir=xml \
+         --playout=$mode --set='playout.policy=$policy'\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    pline=$(echo "$LOG" | grep -F "[PLAYOUT]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+
+    displayed=$(echo $pline | awk '{print $4}' | cut -d= -f2)
+    skipped=$(echo $pline | awk '{print $5}' | cut -d= -f2)
+    stalls=$(echo $pline | awk '{print $6}' | cut -d= -f2)
+    stallRatio=$(echo $pline | awk '{print $8}' | cut -d= -f2)
+    target=$(echo $pline | awk '{print $9}' | cut -d= -f2)
+    e2eAvg=$(echo $pline | awk '{print $10}' | cut -d= -f2)
+    e2eP95=$(echo $pline | awk '{print $12}' | cut -d= -f2)
+    e2eP99=$(echo $pline | awk '{print $13}' | cut -d= -f2)
+    ratio=$(echo $vrline | awk '{print $6}' | cut -d= -f2)
+
+    echo "$tx,$mode,$policy,$displayed,$skipped,$stalls,$stallRatio,$target,$e2eAvg,$e2eP95,$e2eP99,$ratio" >> $OUT
+}
+
+TRANSPORTS=("udp" "tcp" "quic")
+MODES=("fixed" "percentile" "kalman")
+POLICIES=("skip" "stall")
+for tx in ${TRANSPORTS[@]}; do
+    for m in ${MODES[@]}; do
+        for p in ${POLICIES[@]}; do
+            RUN $tx $m $p
+        done
+    done
+done
+
+echo "Playout sweep done. Results saved to $OUT"
@@ -0,0 +1,71 @@
+#!/bin/bash
+
+# Bottleneck queue discipline: DropTail vs. EDF on the rate and frameSize sweeps
+# (same base point as final-sweep.sh; EDF needs a VrHeader per packet -> udp/quic only)
+OUT="results_qdisc.csv"
+echo "qdisc,transport,group,rate,frameSize,total,onTime,late,incomplete,ratio,dlDrops,dlExpired,ul_avg,ul_p99,ul_max" > $OUT
+
+DEADLINE=80
+DELAY_BASE=10ms
+RATE_BASE=120Mbps
+FRAMESIZE_BASE=90000
+QUEUE_BASE="100p"
+
+RUN() {
+    qdisc=$1
+    transport=$2
+    group=$3
+    rate=$4
+    fs=$5
+
+    cmd="./ns3 run \"scratch/arvr-sim --transport=$transport --qdisc=$qdisc \
+         --rate=$rate --delay=$DELAY_BASE --deadline=$DEADLINE \
+         --frameSize=$fs --queue=$QUEUE_BASE --outDir=xml\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+    ulline=$(echo "$LOG" | grep -F "[UL-IMU]")
+    qline=$(echo "$LOG" | grep -F "[QDISC]")
+
+    total=$(echo $vrline | awk '{print $2}' | cut -d= -f2)
+    onTime=$(echo $vrline | awk '{print $3}' | cut -d= -f2)
+    late=$(echo $vrline | awk '{print $4}' | cut -d= -f2)
+    incomplete=$(echo $vrline | awk '{print $5}' | cut -d= -f2)
+    ratio=$(echo $vrline | awk '{print $6}' | cut -d= -f2)
+
+    dlDrops=$(echo $qline | awk '{print $3}' | cut -d= -f2)
+    dlExpired=$(echo $qline | awk '{print $4}' | cut -d= -f2)
+
+    ul_avg=$(echo $ulline | awk '{print $2}' | cut -d= -f2)
+    ul_p99=$(echo $ulline | awk '{print $3}' | cut -d= -f2)
+    ul_max=$(echo $ulline | awk '{print $4}' | cut -d= -f2)
+
+    echo "$qdisc,$transport,$group,$rate,$fs,$total,$onTime,$late,$incomplete,$ratio,$dlDrops,$dlExpired,$ul_avg,$ul_p99,$ul_max" >> $OUT
+}
+
+########################################
+# 1. RATE SWEEP
+########################################
+RATES=("30Mbps" "40Mbps" "50Mbps" "60Mbps" "70Mbps" "80Mbps" "100Mbps" "120Mbps")
+for r in ${RATES[@]}; do
+    for transport in "udp" "quic"; do
+        for q in "droptail" "edf"; do
+            RUN $q $transport rsweep $r $FRAMESIZE_BASE
+        done
+    done
+done
+
+########################################
+# 2. FRAMESIZE SWEEP
+########################################
+FRAMES=("90000" "120000" "150000" "180000" "220000" "250000")
+for fs in ${FRAMES[@]}; do
+    for transport in "udp" "quic"; do
+        for q in "droptail" "edf"; do
+            RUN $q $transport fsweep $RATE_BASE $fs
+        done
+    done
+done
+
+echo "Queue discipline sweep done. Results saved to $OUT"
@@ -0,0 +1,95 @@
+#!/bin/bash
+
+# Event scheduler benchmark: the same run under every --scheduler, per canonical
+# scenario and scenario size (users). Scheduling never changes results, only
+# wallMs; events must match across a row group. The fastest scheduler of each
+# (scenario, users) and what --scheduler=auto picks without a table go to
+# $BEST. $TABLE maps pendingEst to the fastest scheduler; pass it back with
+# --set="scheduler.table=$TABLE" so auto uses measured choices.
+OUT="results_scheduler.csv"
+BEST="results_scheduler_best.csv"
+TABLE="results_scheduler_auto.csv"
+echo "scenario,users,scheduler,rep,pendingEst,wallMs,events,ratio" > $OUT
+
+SCHEDULERS=("map" "heap" "list" "ns3-calendar" "calendar")
+REPS=3
+
+# key=value 取值
+field() {
+    echo "$1" | grep -o "$2=[^ ]*" | cut -d= -f2
+}
+
+RUN() {
+    scn=$1
+    users=$2
+    sched=$3
+    rep=$4
+
+    cmd="./ns3 run \"scratch/arvr-sim --scenario=scenarios/$scn.toml --users=$users \
+         --scheduler=$sched --outDir=xml\""
+
+    LOG=$(eval $cmd 2>&1)
+
+    schedline=$(echo "$LOG" | grep -F "[SCHED]")
+    runline=$(echo "$LOG" | grep -F "[RUN]")
+    vrline=$(echo "$LOG" | grep -F "[VR-RECV]")
+
+    echo "$scn,$users,$sched,$rep,$(field "$schedline" pendingEst),\
+$(field "$runline" wallMs),$(field "$runline" events),$(field "$vrline" ratio)" >> $OUT
+}
+
+for f in scenarios/*.toml; do
+    scn=$(basename $f .toml)
+    for users in 1 8 32; do
+        for sched in ${SCHEDULERS[@]}; do
+            for rep in $(seq 1 $REPS); do
+                RUN $scn $users $sched $rep
+            done
+        done
+    done
+done
+
+# 每组取各调度器 wallMs 的中位数，最小者为 fastest；auto 的选择按同样的 pendingEst 阈值
+echo "scenario,users,pendingEst,fastest,fastestMs,mapMs,autoPick,autoMs" > $BEST
+tail -n +2 $OUT | sort -t, -k1,1 -k2,2n -k3,3 -k6,6n | awk -F, -v reps=$REPS '
+{
+    key = $1 "," $2
+    n[key "," $3]++
+    if (n[key "," $3] == int((reps + 1) / 2)) med[key "," $3] = $6
+    est[key] = $5
+    if (!(key in seen)) { seen[key] = 1; order[++groups] = key }
+}
+END {
+    split("map heap list ns3-calendar calendar", s, " ")
+    for (g = 1; g <= groups; g++) {
+        key = order[g]
+        best = ""
+        for (i = 1; i <= 5; i++) {
+            m = med[key "," s[i]]
+            if (m != "" && (best == "" || m + 0 < med[key "," best] + 0)) best = s[i]
+        }
+        pick = (est[key] < 64) ? "heap" : "calendar"
+        print key "," est[key] "," best "," med[key "," best] "," med[key ",map"] "," pick "," med[key "," pick]
+    }
+}' >> $BEST
+
+# auto 表：同一个 pendingEst 有多行时取多数票的 fastest，按 pendingEst 升序
+echo "pendingEst,scheduler" > $TABLE
+tail -n +2 $BEST | awk -F, '
+{
+    votes[$3 "," $4]++
+    if (!($3 in seen)) { seen[$3] = 1; est[++n] = $3 }
+}
+END {
+    for (i = 1; i <= n; i++) {
+        best = ""; top = 0
+        for (k in votes) {
+            split(k, kv, ",")
+            if (kv[1] == est[i] && votes[k] > top) { top = votes[k]; best = kv[2] }
+        }
+        print est[i] "," best
+    }
+}' | sort -t, -k1,1n >> $TABLE
+
+cat $BEST
+echo "Scheduler benchmark done. Results saved to $OUT, $BEST and $TABLE"